@@ -0,0 +1,80 @@
+#include "batchcheck.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstdio>
+
+BatchCheck::BatchCheck(QList<RepoSettings> repos, int jobs, bool quick, QObject* parent)
+    : QObject{parent}
+    , m_repos{std::move(repos)}
+    , m_quick{quick}
+{
+    m_pool.setMaxThreadCount(std::max(jobs, 1));
+    connect(&m_watcher, &QFutureWatcher<Repo::check_result_t>::resultReadyAt, this, &BatchCheck::on_resultReadyAt);
+    connect(&m_watcher, &QFutureWatcher<Repo::check_result_t>::finished, this, &BatchCheck::on_finished);
+}
+
+void BatchCheck::start()
+{
+    qDebug() << "BatchCheck: checking" << m_repos.size() << "repositories using" << m_pool.maxThreadCount() << "threads";
+    // NOTE: m_repos must not be modified while the checks are running
+    RepoCheckContext context;
+    context.quick = m_quick;
+    m_watcher.setFuture(QtConcurrent::mapped(&m_pool, m_repos, [context](RepoSettings const& settings) {
+        return Repo::check(settings, context);
+    }));
+}
+
+void BatchCheck::on_resultReadyAt(int index)
+{
+    Repo::check_result_t const result = m_watcher.resultAt(index);
+    auto const& stats = result.statistics;
+    auto const& errors = result.errors;
+    RepoStatus const status = Repo::statusOf(result);
+
+    if (status == RepoStatus::Error)
+        m_exitCode = std::max<int>(m_exitCode, SomeErrors);
+    else if (status != RepoStatus::Ok)
+        m_exitCode = std::max<int>(m_exitCode, SomeDirty);
+
+    QJsonObject obj = stats.toJsonObject();
+    obj["path"] = m_repos.at(index).path;
+    obj["status"] = repoStatusName(status);
+    if (!errors.isEmpty())
+        obj["errors"] = QJsonArray::fromStringList(errors);
+
+    QByteArray line = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    line += '\n';
+    // flush after every line so that consumers see results as they come in
+    std::fwrite(line.constData(), 1, line.size(), stdout);
+    std::fflush(stdout);
+}
+
+void BatchCheck::on_finished()
+{
+    qDebug() << "BatchCheck: finished with exit code" << m_exitCode;
+    emit finished(m_exitCode);
+}
+
+std::optional<QList<RepoSettings>> BatchCheck::readRepoFile(QString const& fileName)
+{
+    QFile file(fileName);
+    bool const ok = (fileName == "-")
+        ? file.open(stdin, QIODevice::ReadOnly | QIODevice::Text)
+        : file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!ok)
+        return std::nullopt;
+
+    QList<RepoSettings> repos;
+    while (!file.atEnd()) {
+        QString const line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        RepoSettings rs;
+        rs.path = line;
+        repos.push_back(std::move(rs));
+    }
+    return repos;
+}
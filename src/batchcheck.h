@@ -0,0 +1,49 @@
+#ifndef BATCHCHECK_H
+#define BATCHCHECK_H
+
+#include "repo.h"
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+
+/// Headless mode (--check-all): checks a list of repositories with bounded parallelism
+/// and writes one JSON object per repository to stdout as soon as its check completes.
+class BatchCheck : public QObject
+{
+    Q_OBJECT
+public:
+    /// exit codes, ordered by severity
+    enum ExitCode : int {
+        AllOk = 0,
+        SomeDirty = 1,
+        SomeErrors = 2,
+    };
+
+    /// @param quick only determine whether there are uncommitted changes instead of counting them (see RepoCheckContext::quick)
+    explicit BatchCheck(QList<RepoSettings> repos, int jobs, bool quick = false, QObject* parent = nullptr);
+
+    void start();
+
+    int exitCode() const { return m_exitCode; }
+
+    /// Read repository paths from a file, one per line.
+    /// Empty lines and lines starting with '#' are ignored. The file name "-" denotes stdin.
+    static std::optional<QList<RepoSettings>> readRepoFile(QString const& fileName);
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void on_resultReadyAt(int index);
+    void on_finished();
+
+private:
+    QList<RepoSettings> m_repos;
+    bool m_quick = false;
+    QThreadPool m_pool;
+    QFutureWatcher<Repo::check_result_t> m_watcher;
+    int m_exitCode = AllOk;
+};
+
+#endif // BATCHCHECK_H
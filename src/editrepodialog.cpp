@@ -2,12 +2,16 @@
 #include "ui_editrepodialog.h"
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QPushButton>
+#include <QtConcurrent>
 
 EditRepoDialog::EditRepoDialog(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::EditRepoDialog)
 {
     ui->setupUi(this);
+    setValidating(false);
+    connect(&m_validationWatcher, &QFutureWatcher<QList<QString>>::finished, this, &EditRepoDialog::on_validationFinished);
 }
 
 EditRepoDialog::~EditRepoDialog()
@@ -17,6 +21,9 @@ EditRepoDialog::~EditRepoDialog()
 
 void EditRepoDialog::prepare(RepoSettings* repo)
 {
+    ui->validationLabel->clear();
+    m_adding = !repo;
+    m_prefetchedCheck = QFuture<Repo::check_result_t>();
     if (!repo) {
         // Adding a new repository
         this->setWindowTitle(tr("Add Repository"));
@@ -34,9 +41,14 @@ void EditRepoDialog::setValues(RepoSettings& repo)
 {
     ui->pathEdit->setText(repo.path);
     ui->warnOnUncommittedCheckBox->setChecked(repo.warnOnUncommittedChanges);
+    ui->nativeStatusCheckBox->setChecked(repo.statusEngine == git::status_engine::native);
+    ui->refreshIndexCheckBox->setChecked(repo.refreshIndexWhenIdle);
     ui->warnOnUnpushedCheckBox->setChecked(repo.warnOnUnpushedCommits);
     ui->warnOnUnmergedCheckBox->setChecked(repo.warnOnUnmergedCommits);
     ui->warnOnUnfetchedCheckBox->setChecked(repo.warnOnUnfetchedCommits);
+    ui->includeBranchesEdit->setText(repo.includeBranches.join(' '));
+    ui->excludeBranchesEdit->setText(repo.excludeBranches.join(' '));
+    ui->inactiveBranchDaysSpinBox->setValue(repo.inactiveBranchDays);
 }
 
 RepoSettings EditRepoDialog::values() const
@@ -44,9 +56,14 @@ RepoSettings EditRepoDialog::values() const
     RepoSettings rs;
     rs.path = ui->pathEdit->text();
     rs.warnOnUncommittedChanges = ui->warnOnUncommittedCheckBox->isChecked();
+    rs.statusEngine = ui->nativeStatusCheckBox->isChecked() ? git::status_engine::native : git::status_engine::libgit2;
+    rs.refreshIndexWhenIdle = ui->refreshIndexCheckBox->isChecked();
     rs.warnOnUnpushedCommits = ui->warnOnUnpushedCheckBox->isChecked();
     rs.warnOnUnmergedCommits = ui->warnOnUnmergedCheckBox->isChecked();
     rs.warnOnUnfetchedCommits = ui->warnOnUnfetchedCheckBox->isChecked();
+    rs.includeBranches = ui->includeBranchesEdit->text().split(' ', Qt::SkipEmptyParts);
+    rs.excludeBranches = ui->excludeBranchesEdit->text().split(' ', Qt::SkipEmptyParts);
+    rs.inactiveBranchDays = ui->inactiveBranchDaysSpinBox->value();
     return rs;
 }
 
@@ -58,19 +75,72 @@ void EditRepoDialog::on_pathBrowseButton_clicked()
     ui->pathEdit->setText(dir);
 }
 
+QFuture<Repo::check_result_t> EditRepoDialog::takePrefetchedCheck()
+{
+    return std::exchange(m_prefetchedCheck, QFuture<Repo::check_result_t>());
+}
+
+void EditRepoDialog::setValidating(bool validating)
+{
+    m_validating = validating;
+    ui->validationProgressBar->setVisible(validating);
+    ui->pathEdit->setEnabled(!validating);
+    ui->pathBrowseButton->setEnabled(!validating);
+    ui->warningsGroupBox->setEnabled(!validating);
+    ui->branchesGroupBox->setEnabled(!validating);
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(!validating);
+    if (validating)
+        ui->validationLabel->setText(tr("Validating repository..."));
+}
+
 void EditRepoDialog::accept()
 {
-    RepoSettings rs = values();
-    auto errors = rs.validate();
+    if (m_validating)
+        return;
+
+    // opening the repository may take a long time (e.g., on network file systems),
+    // so we must not do it on the GUI thread
+    setValidating(true);
+    m_validationWatcher.setFuture(QtConcurrent::run([rs = values()]() {
+        return rs.validate();
+    }));
+}
+
+void EditRepoDialog::reject()
+{
+    if (!m_validating) {
+        QDialog::reject();
+        return;
+    }
 
-    if (errors.isEmpty())
+    // we cannot abort the validation itself, but we stop watching it and ignore its result
+    m_validationWatcher.setFuture(QFuture<QList<QString>>());
+    setValidating(false);
+    ui->validationLabel->setText(tr("Validation cancelled."));
+}
+
+void EditRepoDialog::on_validationFinished()
+{
+    if (!m_validating)
+        return;
+    setValidating(false);
+    ui->validationLabel->clear();
+
+    QList<QString> const errors = m_validationWatcher.result();
+    if (errors.isEmpty()) {
+        // a new repository is valid, so start its first check right away
+        if (m_adding)
+            m_prefetchedCheck = QtConcurrent::run([rs = values()]() {
+                return Repo::check(rs);
+            });
         QDialog::accept();
-    else {
-        QString text = tr("Unable to validate repository settings.\n\nError:");
-        for (QString const& error : errors) {
-            text += "\n- ";
-            text += error;
-        }
-        QMessageBox::critical(this, tr("Error"), text);
+        return;
+    }
+
+    QString text = tr("Unable to validate repository settings.\n\nError:");
+    for (QString const& error : errors) {
+        text += "\n- ";
+        text += error;
     }
+    QMessageBox::critical(this, tr("Error"), text);
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <QDialog>
+#include <QFuture>
+#include <QFutureWatcher>
+#include "repo.h"
 #include "reposettings.h"
 
 namespace Ui {
@@ -22,12 +25,27 @@ public:
     void setValues(RepoSettings& repo);
     RepoSettings values() const;
 
+    /// Check of the repository that was started in the background after successful validation.
+    /// Pass it to RepoManager::addNewRepo() so the first check does not have to be repeated.
+    QFuture<Repo::check_result_t> takePrefetchedCheck();
+
 public slots:
+    /// validates the settings in the background, and closes the dialog if they are valid
     void accept() override;
+    /// cancels a running validation, otherwise closes the dialog
+    void reject() override;
 
 private slots:
     void on_pathBrowseButton_clicked();
+    void on_validationFinished();
+
+private:
+    void setValidating(bool validating);
 
 private:
     Ui::EditRepoDialog *ui;
+    bool m_adding = false;
+    bool m_validating = false;
+    QFutureWatcher<QList<QString>> m_validationWatcher;
+    QFuture<Repo::check_result_t> m_prefetchedCheck;
 };
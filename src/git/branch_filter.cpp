@@ -0,0 +1,17 @@
+#include "branch_filter.h"
+#include <fnmatch.h>
+
+using namespace git;
+
+bool branch_filter::matches(char const* branch_name) const
+{
+    auto const matches_any = [branch_name](std::vector<std::string> const& patterns) {
+        for (std::string const& pattern : patterns)
+            if (fnmatch(pattern.c_str(), branch_name, 0) == 0)
+                return true;
+        return false;
+    };
+    if (!include.empty() && !matches_any(include))
+        return false;
+    return !matches_any(exclude);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace git {
+
+    /// Selects the local branches that are monitored.
+    struct branch_filter {
+        /// Glob patterns (see fnmatch(3)) matched against the branch name without "refs/heads/" (e.g., "feature/*").
+        /// '*' also matches '/'. If empty, all branches are included.
+        std::vector<std::string> include;
+        /// branches matching any of these patterns are excluded, even if they are included
+        std::vector<std::string> exclude;
+
+        /// If set, branches whose reflog and tip commit are both older than this (Unix time) are inactive.
+        std::optional<int64_t> active_since;
+        /// Whether inactive branches are skipped. Otherwise they are included, but still counted as inactive
+        /// (e.g., for a periodic full sweep).
+        bool skip_inactive = true;
+
+        bool has_patterns() const { return !include.empty() || !exclude.empty(); }
+
+        /// whether the branch with the given name (without "refs/heads/") passes the patterns
+        bool matches(char const* branch_name) const;
+    };
+
+    /// effect of a branch_filter
+    struct branch_counts {
+        /// number of local branches
+        size_t total = 0;
+        /// number of local branches that passed the patterns
+        size_t monitored = 0;
+        /// number of monitored branches that are inactive (see branch_filter::active_since)
+        size_t inactive = 0;
+    };
+
+}
@@ -0,0 +1,51 @@
+#include "cache_tree.h"
+#include "index_reader.h"
+#include <algorithm>
+#include <charconv>
+
+using namespace git;
+
+namespace {
+
+    /// ASCII decimal number terminated by the given character (which is consumed)
+    int64_t read_number(index_reader& r, char terminator)
+    {
+        std::string digits;
+        for (char c = r.bytes(1)[0]; c != terminator; c = r.bytes(1)[0])
+            digits += c;
+        int64_t value = 0;
+        auto const [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (digits.empty() || ec != std::errc() || end != digits.data() + digits.size())
+            throw_malformed_index("invalid number in cache tree");
+        return value;
+    }
+
+    void read_tree(index_reader& r, cache_tree& tree, int depth)
+    {
+        // git limits the depth of paths as well; this keeps malformed data from exhausting the stack
+        if (depth > 4096)
+            throw_malformed_index("cache tree too deep");
+        tree.name = r.c_str();
+        tree.entry_count = read_number(r, ' ');
+        int64_t const subtree_count = read_number(r, '\n');
+        // each subtree takes at least a few bytes, which bounds the allocation for malformed data
+        if (subtree_count < 0 || static_cast<uint64_t>(subtree_count) > r.remaining())
+            throw_malformed_index("invalid subtree count in cache tree");
+        if (tree.is_valid()) {
+            std::string_view const oid = r.bytes(tree.oid.size());
+            std::copy(oid.begin(), oid.end(), tree.oid.begin());
+        }
+        tree.subtrees.resize(static_cast<size_t>(subtree_count));
+        for (cache_tree& subtree : tree.subtrees)
+            read_tree(r, subtree, depth + 1);
+    }
+
+}
+
+cache_tree cache_tree::parse(std::string_view data)
+{
+    index_reader r(data);
+    cache_tree root;
+    read_tree(r, root, 0);
+    return root;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace git {
+
+    /// The cache tree extension of the index ("TREE", see index-format.txt in git's documentation):
+    /// the tree object id of each directory whose index entries did not change since the tree was last written,
+    /// e.g., by `git commit`. Staged changes only have to be looked for in directories whose tree is invalid or differs from HEAD.
+    struct cache_tree {
+        using object_id = std::array<unsigned char, 20>;
+
+        /// the last path component, empty for the working directory
+        std::string name;
+        /// number of index entries below the directory; -1 if the tree is invalid
+        int64_t entry_count = -1;
+        /// only meaningful if the tree is valid
+        object_id oid{};
+        /// subdirectories, in the order of the index
+        std::vector<cache_tree> subtrees;
+
+        bool is_valid() const { return entry_count >= 0; }
+
+        /// Throws if the data is malformed.
+        static cache_tree parse(std::string_view data);
+    };
+
+}
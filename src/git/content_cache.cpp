@@ -0,0 +1,170 @@
+#include "content_cache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace git;
+
+namespace {
+
+    constexpr char k_magic[4] = {'G', 'M', 'C', 'C'};
+    /// increment when the format changes; old caches are discarded
+    constexpr uint32_t k_format_version = 1;
+
+    struct file_closer {
+        void operator()(FILE* f) const { std::fclose(f); }
+    };
+    using file_ptr = std::unique_ptr<FILE, file_closer>;
+
+    // the file is local to this machine, so values are stored in native byte order
+    template <typename T>
+    bool read_value(FILE* f, T& value)
+    {
+        return std::fread(&value, sizeof(T), 1, f) == 1;
+    }
+
+    template <typename T>
+    void write_value(std::vector<char>& out, T const& value)
+    {
+        char const* p = reinterpret_cast<char const*>(&value);
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+
+    bool read_time(FILE* f, file_time& t)
+    {
+        return read_value(f, t.sec) && read_value(f, t.nsec);
+    }
+
+    void write_time(std::vector<char>& out, file_time const& t)
+    {
+        write_value(out, t.sec);
+        write_value(out, t.nsec);
+    }
+
+}
+
+content_cache::stat_key content_cache::stat_key::from(struct stat const& st)
+{
+    stat_key key;
+    key.mtime = file_time::mtime_of(st);
+    key.ctime = file_time::ctime_of(st);
+    key.ino = st.st_ino;
+    key.size = st.st_size;
+    return key;
+}
+
+content_cache content_cache::load(std::string file_name)
+{
+    content_cache cache;
+    cache.m_file_name = std::move(file_name);
+
+    file_ptr f(std::fopen(cache.m_file_name.c_str(), "rbe"));
+    if (!f)
+        return cache;
+
+    char magic[4] = {};
+    uint32_t version = 0, count = 0;
+    if (std::fread(magic, 1, sizeof(magic), f.get()) != sizeof(magic) || std::memcmp(magic, k_magic, sizeof(magic)) != 0
+        || !read_value(f.get(), version) || version != k_format_version || !read_value(f.get(), count))
+        return cache;
+
+    std::string path;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t length = 0;
+        record r;
+        if (!read_value(f.get(), length))
+            break;
+        path.resize(length);
+        if (std::fread(path.data(), 1, length, f.get()) != length
+            || !read_time(f.get(), r.key.mtime) || !read_time(f.get(), r.key.ctime)
+            || !read_value(f.get(), r.key.ino) || !read_value(f.get(), r.key.size)
+            || std::fread(r.oid.data(), 1, r.oid.size(), f.get()) != r.oid.size()) {
+            fmt::println(stderr, "content cache {} is truncated, ignoring it", cache.m_file_name);
+            cache.m_records.clear();
+            return cache;
+        }
+        cache.m_records.emplace(path, r);
+    }
+    return cache;
+}
+
+bool content_cache::matches(std::string const& path, stat_key const& key, object_id const& oid)
+{
+    auto it = m_records.find(path);
+    if (it == m_records.end())
+        return false;
+    if (it->second.key != key || it->second.oid != oid) {
+        // the file or its index entry changed, the record is of no use anymore
+        m_records.erase(it);
+        m_modified = true;
+        return false;
+    }
+    it->second.used = true;
+    return true;
+}
+
+void content_cache::insert(std::string const& path, stat_key const& key, object_id const& oid)
+{
+    m_records.insert_or_assign(path, record{key, oid, true});
+    m_modified = true;
+}
+
+void content_cache::save(bool keep_unused)
+{
+    bool const drop_unused = !keep_unused && std::any_of(m_records.begin(), m_records.end(), [](auto const& r) { return !r.second.used; });
+    if (!m_modified && !drop_unused)
+        return;
+    if (drop_unused) {
+        for (auto it = m_records.begin(); it != m_records.end(); ) {
+            if (it->second.used)
+                ++it;
+            else
+                it = m_records.erase(it);
+        }
+    }
+
+    std::vector<char> out(k_magic, k_magic + sizeof(k_magic));
+    write_value(out, k_format_version);
+    write_value(out, static_cast<uint32_t>(m_records.size()));
+    for (auto const& [path, r] : m_records) {
+        write_value(out, static_cast<uint32_t>(path.size()));
+        out.insert(out.end(), path.begin(), path.end());
+        write_time(out, r.key.mtime);
+        write_time(out, r.key.ctime);
+        write_value(out, r.key.ino);
+        write_value(out, r.key.size);
+        out.insert(out.end(), r.oid.begin(), r.oid.end());
+    }
+
+    // write to a temporary file and rename it, so concurrent readers see either version;
+    // the name is unique, since other processes and threads may save the same cache at the same time
+    std::string temp_name = m_file_name + ".XXXXXX";
+    int const fd = ::mkostemp(temp_name.data(), O_CLOEXEC);
+    if (fd < 0) {
+        fmt::println(stderr, "unable to write content cache {}: {}", temp_name, std::strerror(errno));
+        return;
+    }
+    file_ptr f(::fdopen(fd, "wb"));
+    if (!f) {
+        fmt::println(stderr, "unable to write content cache {}: {}", temp_name, std::strerror(errno));
+        ::close(fd);
+        std::remove(temp_name.c_str());
+        return;
+    }
+    bool const written = std::fwrite(out.data(), 1, out.size(), f.get()) == out.size();
+    bool const closed = std::fclose(f.release()) == 0;
+    if (!written || !closed || std::rename(temp_name.c_str(), m_file_name.c_str()) != 0) {
+        fmt::println(stderr, "unable to write content cache {}: {}", m_file_name, std::strerror(errno));
+        std::remove(temp_name.c_str());
+        return;
+    }
+    m_modified = false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "index_file.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+struct stat;
+
+namespace git {
+
+    /// Persistent record of working directory files whose content was found to match their index entry.
+    ///
+    /// Files whose stat data in the index is stale (touched but unchanged, or smudged by filters) would
+    /// otherwise be hashed on every status, since git-monitor never writes the index to refresh it.
+    /// A record is only valid while the inode, mtime, ctime and size of the file and the object id in
+    /// the index are the same as when the content was compared.
+    class content_cache {
+    public:
+        using object_id = std::array<unsigned char, 20>;
+
+        struct stat_key {
+            file_time mtime;
+            file_time ctime;
+            uint64_t ino = 0;
+            uint64_t size = 0;
+
+            static stat_key from(struct stat const& st);
+
+            bool operator==(stat_key const& other) const
+            {
+                return mtime == other.mtime && ctime == other.ctime && ino == other.ino && size == other.size;
+            }
+            bool operator!=(stat_key const& other) const { return !(*this == other); }
+        };
+
+        /// A missing, unreadable or outdated file gives an empty cache.
+        static content_cache load(std::string file_name);
+
+        /// Whether the content of the file was found to match the object id when it had the given stat data.
+        bool matches(std::string const& path, stat_key const& key, object_id const& oid);
+
+        void insert(std::string const& path, stat_key const& key, object_id const& oid);
+
+        /// Write the records to the file the cache was loaded from, atomically replacing it.
+        /// Records that were not used since loading are dropped unless keep_unused is set
+        /// (i.e., if not all files were looked at), so the cache does not grow with files that became clean.
+        /// Errors are only logged, since the cache is an optimization.
+        void save(bool keep_unused);
+
+    private:
+        struct record {
+            stat_key key;
+            object_id oid{};
+            bool used = false;
+        };
+
+    private:
+        std::string m_file_name;
+        std::unordered_map<std::string, record> m_records;
+        bool m_modified = false;
+    };
+
+}
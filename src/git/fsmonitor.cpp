@@ -0,0 +1,147 @@
+#include "fsmonitor.h"
+#include "index_reader.h"
+#include <cerrno>
+#include <cstdio>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <system_error>
+
+using namespace git;
+
+namespace {
+
+    std::string shell_quote(std::string_view s)
+    {
+        std::string result = "'";
+        for (char c : s) {
+            if (c == '\'')
+                result += "'\\''";
+            else
+                result += c;
+        }
+        result += '\'';
+        return result;
+    }
+
+    std::string run_hook(std::string const& hook, int version, std::string const& last_update, std::string const& workdir)
+    {
+        // like git, the hook is run by the shell in the working directory
+        std::string const command = fmt::format("cd {} && {} {} {}", shell_quote(workdir), hook, version, shell_quote(last_update));
+#ifdef __linux__
+        // "e" (close on exec, glibc and musl) keeps the pipe from leaking into hooks run concurrently for other repositories
+        char const* const mode = "re";
+#else
+        char const* const mode = "r";
+#endif
+        FILE* pipe = ::popen(command.c_str(), mode);
+        if (!pipe)
+            throw std::system_error(errno, std::generic_category(), "popen");
+        std::string output;
+        char buffer[4096];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+            output.append(buffer, n);
+        int const status = ::pclose(pipe);
+        if (status != 0)
+            throw std::runtime_error(fmt::format("fsmonitor hook '{}' (version {}) failed with status {}", hook, version, status));
+        return output;
+    }
+
+}
+
+fsmonitor_extension fsmonitor_extension::parse(std::string_view data)
+{
+    // see read_fsmonitor_extension() in git's fsmonitor.c
+    index_reader r(data);
+    fsmonitor_extension ext;
+    ext.version = r.be32();
+    if (ext.version == 1)
+        ext.last_update = std::to_string(r.be64());
+    else if (ext.version == 2)
+        ext.last_update = r.c_str();
+    else
+        throw std::runtime_error(fmt::format("unsupported fsmonitor extension version {}", ext.version));
+
+    uint32_t const bitmap_size = r.be32();
+    index_reader bitmap(r.bytes(bitmap_size));
+    ext.dirty = read_ewah_bitmap(bitmap);
+    if (bitmap.remaining() != 0)
+        throw_malformed_index("fsmonitor bitmap size mismatch");
+    return ext;
+}
+
+std::optional<fsmonitor_changes> fsmonitor_changes::query(std::string const& hook, int version, std::string const& last_update, std::string const& workdir)
+{
+    std::string output;
+    if (version == 0) {
+        // the protocol git tries first when core.fsmonitorHookVersion is not set
+        try {
+            output = run_hook(hook, 2, last_update, workdir);
+            version = 2;
+        }
+        catch (std::runtime_error const&) {
+            output = run_hook(hook, 1, last_update, workdir);
+            version = 1;
+        }
+    }
+    else if (version == 1 || version == 2)
+        output = run_hook(hook, version, last_update, workdir);
+    else
+        throw std::runtime_error(fmt::format("unsupported fsmonitor hook version {}", version));
+
+    std::string_view paths = output;
+    if (version == 2) {
+        // the first entry is the token for the next query, which we do not store since we never write the index
+        size_t const end = paths.find('\0');
+        if (end == std::string_view::npos)
+            throw std::runtime_error(fmt::format("fsmonitor hook '{}' did not return a token", hook));
+        paths.remove_prefix(end + 1);
+    }
+
+    fsmonitor_changes changes;
+    while (!paths.empty()) {
+        size_t const end = paths.find('\0');
+        std::string_view const path = paths.substr(0, end);
+        paths.remove_prefix(end == std::string_view::npos ? paths.size() : end + 1);
+        // "/" means the hook cannot tell (e.g., after a restart of the watcher)
+        if (path == "/")
+            return std::nullopt;
+        changes.add(path);
+    }
+    return changes;
+}
+
+void fsmonitor_changes::add(std::string_view path)
+{
+    while (!path.empty() && path.back() == '/')
+        path.remove_suffix(1);
+    if (path.empty())
+        return;
+    m_paths.emplace(path);
+    m_trees.insert(std::string(path) + '/');
+    size_t const slash = path.rfind('/');
+    m_dirs.emplace(slash == std::string_view::npos ? std::string_view{} : path.substr(0, slash + 1));
+}
+
+bool fsmonitor_changes::is_below_changed_tree(std::string_view path) const
+{
+    if (m_trees.empty())
+        return false;
+    std::string prefix;
+    for (size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1)) {
+        prefix.assign(path, 0, slash + 1);
+        if (m_trees.count(prefix))
+            return true;
+    }
+    return false;
+}
+
+bool fsmonitor_changes::is_path_changed(std::string_view path) const
+{
+    return m_paths.count(std::string(path)) > 0 || is_below_changed_tree(path);
+}
+
+bool fsmonitor_changes::is_dir_changed(std::string_view dir) const
+{
+    return m_dirs.count(std::string(dir)) > 0 || is_below_changed_tree(dir);
+}
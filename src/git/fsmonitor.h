@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace git {
+
+    /// The fsmonitor extension of the index ("FSMN", see core.fsmonitor in git-config(1)):
+    /// when git last queried the hook, and which index entries it did not know to be unchanged at that time.
+    struct fsmonitor_extension {
+        /// 1: last_update is a timestamp in nanoseconds, 2: last_update is a token returned by the hook
+        uint32_t version = 0;
+        std::string last_update;
+        /// positions of the index entries that must be checked regardless of what the hook reports
+        std::vector<size_t> dirty;
+
+        /// Throws if the data is malformed or of an unknown version.
+        static fsmonitor_extension parse(std::string_view data);
+    };
+
+    /// Paths that a core.fsmonitor hook reports as changed since the last update.
+    class fsmonitor_changes {
+    public:
+        /// Run the hook in the working directory, the same way git does (see fsmonitor-watchman in githooks(5)).
+        /// @param version the hook protocol (core.fsmonitorHookVersion); 0 tries version 2, then version 1
+        /// @returns std::nullopt if the hook reports that anything may have changed
+        /// Throws if the hook cannot be run or fails.
+        static std::optional<fsmonitor_changes> query(std::string const& hook, int version, std::string const& last_update, std::string const& workdir);
+
+        /// Whether the file (or anything below the directory) may have changed.
+        /// @param path relative to the working directory, without trailing slash
+        bool is_path_changed(std::string_view path) const;
+
+        /// Whether entries may have been added to or removed from the directory.
+        /// @param dir relative to the working directory, empty or ending with a slash
+        bool is_dir_changed(std::string_view dir) const;
+
+    private:
+        void add(std::string_view path);
+        bool is_below_changed_tree(std::string_view path) const;
+
+    private:
+        /// reported paths
+        std::unordered_set<std::string> m_paths;
+        /// directories containing reported paths, ending with a slash
+        std::unordered_set<std::string> m_dirs;
+        /// reported paths with a trailing slash; a reported path may be a directory, and then anything below it may have changed
+        std::unordered_set<std::string> m_trees;
+    };
+
+}
@@ -0,0 +1,246 @@
+#include "ignore.h"
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+using namespace git;
+
+namespace {
+
+    enum wildmatch_result {
+        wm_match,
+        wm_no_match,
+        wm_abort_all,
+        wm_abort_to_starstar,
+    };
+
+    bool matches_class(std::string_view name, unsigned char c)
+    {
+        if (name == "alnum")  return std::isalnum(c);
+        if (name == "alpha")  return std::isalpha(c);
+        if (name == "blank")  return c == ' ' || c == '\t';
+        if (name == "cntrl")  return std::iscntrl(c);
+        if (name == "digit")  return std::isdigit(c);
+        if (name == "graph")  return std::isgraph(c);
+        if (name == "lower")  return std::islower(c);
+        if (name == "print")  return std::isprint(c);
+        if (name == "punct")  return std::ispunct(c);
+        if (name == "space")  return std::isspace(c);
+        if (name == "upper")  return std::isupper(c);
+        if (name == "xdigit") return std::isxdigit(c);
+        return false;
+    }
+
+    bool is_class_name(std::string_view name)
+    {
+        for (char const* known : {"alnum", "alpha", "blank", "cntrl", "digit", "graph", "lower", "print", "punct", "space", "upper", "xdigit"})
+            if (name == known)
+                return true;
+        return false;
+    }
+
+    /// port of dowild() from git's wildmatch.c, always with WM_PATHNAME
+    wildmatch_result dowild(std::string_view pattern, size_t pi, std::string_view text, size_t ti)
+    {
+        auto const pat = [pattern](size_t i) -> unsigned char { return i < pattern.size() ? pattern[i] : 0; };
+        auto const txt = [text](size_t i) -> unsigned char { return i < text.size() ? text[i] : 0; };
+
+        for (; pi < pattern.size(); ++pi, ++ti) {
+            unsigned char p_ch = pattern[pi];
+            unsigned char const t_ch = txt(ti);
+            if (t_ch == 0 && p_ch != '*')
+                return wm_abort_all;
+
+            switch (p_ch) {
+                case '\\':
+                    // literal match with the following character
+                    p_ch = pat(++pi);
+                    [[fallthrough]];
+                default:
+                    if (t_ch != p_ch)
+                        return wm_no_match;
+                    continue;
+
+                case '?':
+                    if (t_ch == '/')
+                        return wm_no_match;
+                    continue;
+
+                case '*': {
+                    bool match_slash = false;
+                    if (pat(++pi) == '*') {
+                        size_t const first_star = pi - 1;
+                        while (pat(++pi) == '*') { }
+                        // "**" only matches across slashes as a whole path component
+                        if ((first_star == 0 || pattern[first_star - 1] == '/')
+                            && (pat(pi) == 0 || pat(pi) == '/' || (pat(pi) == '\\' && pat(pi + 1) == '/'))) {
+                            if (pat(pi) == '/' && dowild(pattern, pi + 1, text, ti) == wm_match)
+                                return wm_match;
+                            match_slash = true;
+                        }
+                    }
+                    if (pi >= pattern.size()) {
+                        // trailing "**" matches everything, trailing '*' only within the last component
+                        if (!match_slash && text.find('/', ti) != std::string_view::npos)
+                            return wm_no_match;
+                        return wm_match;
+                    }
+                    if (!match_slash && pattern[pi] == '/') {
+                        // a single '*' followed by a slash matches up to the next slash
+                        size_t const slash = text.find('/', ti);
+                        if (slash == std::string_view::npos)
+                            return wm_no_match;
+                        ti = slash;
+                        continue;  // the slashes are consumed by the loop
+                    }
+                    for (; ti < text.size(); ++ti) {
+                        wildmatch_result const matched = dowild(pattern, pi, text, ti);
+                        if (matched != wm_no_match) {
+                            if (!match_slash || matched != wm_abort_to_starstar)
+                                return matched;
+                        }
+                        else if (!match_slash && text[ti] == '/')
+                            return wm_abort_to_starstar;
+                    }
+                    return wm_abort_all;
+                }
+
+                case '[': {
+                    p_ch = pat(++pi);
+                    if (p_ch == '^')
+                        p_ch = '!';
+                    bool const negated = (p_ch == '!');
+                    if (negated)
+                        p_ch = pat(++pi);
+                    unsigned char prev_ch = 0;
+                    bool matched = false;
+                    do {
+                        if (!p_ch)
+                            return wm_abort_all;
+                        if (p_ch == '\\') {
+                            p_ch = pat(++pi);
+                            if (!p_ch)
+                                return wm_abort_all;
+                            if (t_ch == p_ch)
+                                matched = true;
+                        }
+                        else if (p_ch == '-' && prev_ch && pat(pi + 1) && pat(pi + 1) != ']') {
+                            p_ch = pat(++pi);
+                            if (p_ch == '\\') {
+                                p_ch = pat(++pi);
+                                if (!p_ch)
+                                    return wm_abort_all;
+                            }
+                            if (t_ch <= p_ch && t_ch >= prev_ch)
+                                matched = true;
+                            p_ch = 0;  // a range cannot start a new range
+                        }
+                        else if (p_ch == '[' && pat(pi + 1) == ':') {
+                            size_t const start = pi + 2;
+                            size_t end = start;
+                            while (pat(end) && pat(end) != ']')
+                                ++end;
+                            if (!pat(end))
+                                return wm_abort_all;
+                            if (end == start || pat(end - 1) != ':') {
+                                // not a character class, so '[' is a normal member of the set
+                                if (t_ch == '[')
+                                    matched = true;
+                            }
+                            else {
+                                std::string_view const name = pattern.substr(start, end - 1 - start);
+                                if (!is_class_name(name))
+                                    return wm_abort_all;
+                                if (matches_class(name, t_ch))
+                                    matched = true;
+                                pi = end;
+                                p_ch = 0;
+                            }
+                        }
+                        else if (t_ch == p_ch)
+                            matched = true;
+                        prev_ch = p_ch;
+                        p_ch = pat(++pi);
+                    } while (p_ch != ']');
+                    if (matched == negated || t_ch == '/')
+                        return wm_no_match;
+                    continue;
+                }
+            }
+        }
+        return ti < text.size() ? wm_no_match : wm_match;
+    }
+
+}
+
+bool git::wildmatch(std::string_view pattern, std::string_view text)
+{
+    return dowild(pattern, 0, text, 0) == wm_match;
+}
+
+ignore_list ignore_list::parse(std::string_view content, std::string base)
+{
+    ignore_list list;
+    list.m_base = std::move(base);
+
+    while (!content.empty()) {
+        size_t const eol = content.find('\n');
+        std::string_view line = content.substr(0, eol);
+        content.remove_prefix(eol == std::string_view::npos ? content.size() : eol + 1);
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        // trailing spaces are ignored unless escaped with a backslash
+        while (!line.empty() && line.back() == ' ' && !(line.size() >= 2 && line[line.size() - 2] == '\\'))
+            line.remove_suffix(1);
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        pattern p;
+        if (line.front() == '!') {
+            p.negated = true;
+            line.remove_prefix(1);
+        }
+        if (!line.empty() && line.back() == '/') {
+            p.dir_only = true;
+            line.remove_suffix(1);
+        }
+        if (line.empty())
+            continue;
+        p.basename_only = (line.find('/') == std::string_view::npos);
+        if (line.front() == '/')
+            line.remove_prefix(1);
+        p.text = line;
+        list.m_patterns.push_back(std::move(p));
+    }
+
+    return list;
+}
+
+ignore_list ignore_list::read(std::string const& path, std::string base)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return ignore_list{};
+    std::string const content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    return parse(content, std::move(base));
+}
+
+std::optional<bool> ignore_list::match(std::string_view path, bool is_dir) const
+{
+    if (path.substr(0, m_base.size()) != m_base)
+        return std::nullopt;
+    std::string_view const relative = path.substr(m_base.size());
+    size_t const slash = relative.rfind('/');
+    std::string_view const basename = (slash == std::string_view::npos) ? relative : relative.substr(slash + 1);
+
+    // the last matching pattern decides
+    for (auto it = m_patterns.rbegin(); it != m_patterns.rend(); ++it) {
+        pattern const& p = *it;
+        if (p.dir_only && !is_dir)
+            continue;
+        if (wildmatch(p.text, p.basename_only ? basename : relative))
+            return !p.negated;
+    }
+    return std::nullopt;
+}
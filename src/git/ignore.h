@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace git {
+
+    /// Match a path against a pattern like git's wildmatch with WM_PATHNAME:
+    /// '*', '?' and bracket expressions do not match '/', while "**" between slashes matches any number of directories.
+    bool wildmatch(std::string_view pattern, std::string_view text);
+
+    /// Patterns of one ignore file (a .gitignore, info/exclude, or core.excludesFile), see gitignore(5).
+    class ignore_list {
+    public:
+        /// @param base directory of the ignore file relative to the working directory, empty or ending with a slash.
+        ///             Patterns containing a slash only match below it.
+        static ignore_list parse(std::string_view content, std::string base = {});
+
+        /// Read and parse the file; a missing or unreadable file gives an empty list.
+        static ignore_list read(std::string const& path, std::string base = {});
+
+        bool empty() const { return m_patterns.empty(); }
+
+        /// @param path relative to the working directory, without trailing slash
+        /// @returns std::nullopt if no pattern matches, otherwise whether the last matching pattern excludes the path
+        std::optional<bool> match(std::string_view path, bool is_dir) const;
+
+    private:
+        struct pattern {
+            std::string text;
+            bool negated = false;
+            bool dir_only = false;
+            /// the pattern has no slash and matches the last path component at any depth
+            bool basename_only = false;
+        };
+
+        std::string m_base;
+        std::vector<pattern> m_patterns;
+    };
+
+}
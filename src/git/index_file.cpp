@@ -0,0 +1,270 @@
+#include "index_file.h"
+#include "index_reader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+using namespace git;
+
+mapped_file::~mapped_file() noexcept
+{
+    if (m_data)
+        ::munmap(m_data, m_size);
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_mtime(other.m_mtime)
+{ }
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+    if (this != &other) {
+        if (m_data)
+            ::munmap(m_data, m_size);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_mtime = other.m_mtime;
+    }
+    return *this;
+}
+
+mapped_file mapped_file::open(std::string const& path)
+{
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), path);
+
+    mapped_file result;
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        int const error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), path);
+    }
+    result.m_mtime = file_time::mtime_of(st);
+
+    // mmap fails for empty files, which are handled as empty data
+    if (st.st_size > 0) {
+        void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int const error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        result.m_data = data;
+        result.m_size = st.st_size;
+    }
+    ::close(fd);
+    return result;
+}
+
+namespace {
+
+    constexpr size_t k_hash_size = 20;
+    // ctime, mtime, dev, ino, mode, uid, gid, size (4 bytes each), object id, flags (2 bytes)
+    constexpr size_t k_entry_fixed_size = 40 + k_hash_size + 2;
+    constexpr uint16_t k_flag_extended = 0x4000;
+
+    bool entry_less(index_entry const& a, std::string_view path, int stage)
+    {
+        int const cmp = std::string_view(a.path).compare(path);
+        return cmp < 0 || (cmp == 0 && a.stage() < stage);
+    }
+
+}
+
+index_file index_file::read(std::string const& path)
+{
+    index_file result;
+    try {
+        result.m_file = mapped_file::open(path);
+    }
+    catch (std::system_error const& e) {
+        // like git, treat a missing index as empty
+        if (e.code() == std::errc::no_such_file_or_directory)
+            return result;
+        throw;
+    }
+
+    std::optional<link_extension> link;
+    result.parse(result.m_file.data(), &link);
+    result.m_split = link.has_value();
+
+    if (link && std::any_of(link->base_oid.begin(), link->base_oid.end(), [](unsigned char c) { return c != 0; })) {
+        std::string shared_path = path.substr(0, path.rfind('/') + 1) + "sharedindex.";
+        for (unsigned char c : link->base_oid)
+            shared_path += fmt::format("{:02x}", c);
+        index_file shared;
+        shared.m_file = mapped_file::open(shared_path);
+        shared.parse(shared.m_file.data(), nullptr);
+        result.merge_shared_index(std::move(shared), *link);
+    }
+
+    return result;
+}
+
+void index_file::parse(std::string_view data, std::optional<link_extension>* link)
+{
+    if (data.size() < 12 + k_hash_size)
+        throw_malformed_index("file too short");
+    // the trailing checksum is not verified (git does not either with index.skipHash)
+    index_reader r(data.substr(0, data.size() - k_hash_size));
+
+    if (r.bytes(4) != "DIRC")
+        throw_malformed_index("bad signature");
+    m_version = r.be32();
+    if (m_version < 2 || m_version > 4)
+        throw std::runtime_error(fmt::format("unsupported index version {}", m_version));
+    uint32_t const entry_count = r.be32();
+
+    m_entries.clear();
+    m_entries.reserve(entry_count);
+    std::string previous_path;
+    for (uint32_t i = 0; i < entry_count; ++i) {
+        size_t const entry_start = r.pos();
+        index_entry& e = m_entries.emplace_back();
+        e.ctime.sec = r.be32();
+        e.ctime.nsec = r.be32();
+        e.mtime.sec = r.be32();
+        e.mtime.nsec = r.be32();
+        e.dev = r.be32();
+        e.ino = r.be32();
+        e.mode = r.be32();
+        e.uid = r.be32();
+        e.gid = r.be32();
+        e.size = r.be32();
+        std::string_view const oid = r.bytes(k_hash_size);
+        std::copy(oid.begin(), oid.end(), e.oid.begin());
+        e.flags = r.be16();
+        if (e.flags & k_flag_extended) {
+            if (m_version < 3)
+                throw_malformed_index("extended flags in index version 2");
+            e.extended_flags = r.be16();
+        }
+
+        if (m_version == 4) {
+            uint64_t const strip = r.varint();
+            if (strip > previous_path.size())
+                throw_malformed_index("path prefix longer than previous path");
+            e.path.reserve(previous_path.size() - strip + 16);
+            e.path.assign(previous_path, 0, previous_path.size() - strip);
+            e.path += r.c_str();
+            previous_path = e.path;
+        }
+        else {
+            e.path = r.c_str();
+            // entries are padded with 1 to 8 NUL bytes to a multiple of 8 bytes
+            size_t const fixed_size = k_entry_fixed_size + ((e.flags & k_flag_extended) ? 2 : 0);
+            size_t const entry_size = (fixed_size + e.path.size() + 8) & ~size_t(7);
+            size_t const consumed = r.pos() - entry_start;
+            if (consumed > entry_size)
+                throw_malformed_index("entry padding");
+            r.skip(entry_size - consumed);
+        }
+    }
+
+    m_extensions.clear();
+    while (r.remaining() > 0) {
+        std::string_view const signature = r.bytes(4);
+        uint32_t const size = r.be32();
+        std::string_view const ext_data = r.bytes(size);
+        if (signature == "link") {
+            if (!link)
+                throw_malformed_index("shared index contains a link extension");
+            index_reader lr(ext_data);
+            link_extension& l = link->emplace();
+            std::string_view const base = lr.bytes(k_hash_size);
+            std::copy(base.begin(), base.end(), l.base_oid.begin());
+            if (lr.remaining() > 0) {
+                l.delete_positions = read_ewah_bitmap(lr);
+                l.replace_positions = read_ewah_bitmap(lr);
+            }
+        }
+        else if (signature[0] >= 'A' && signature[0] <= 'Z') {
+            // optional extension
+            m_extensions.emplace(std::string(signature), ext_data);
+        }
+        else {
+            // e.g., "sdir" of sparse indexes; git refuses to read the index, and so do we
+            throw std::runtime_error(fmt::format("unsupported index extension '{}'", signature));
+        }
+    }
+}
+
+void index_file::merge_shared_index(index_file shared, link_extension const& link)
+{
+    // see merge_base_index() in git's split-index.c
+    std::vector<index_entry> split_entries = std::move(m_entries);
+    std::vector<index_entry> entries = std::move(shared.m_entries);
+
+    size_t replaced = 0;
+    for (size_t pos : link.replace_positions) {
+        if (pos >= entries.size() || replaced >= split_entries.size())
+            throw_malformed_index("split index replacement out of range");
+        index_entry& src = split_entries[replaced];
+        if (!src.path.empty())
+            throw_malformed_index("split index replacement has a name");
+        src.path = std::move(entries[pos].path);
+        entries[pos] = std::move(src);
+        replaced += 1;
+    }
+
+    std::vector<bool> deleted(entries.size(), false);
+    for (size_t pos : link.delete_positions) {
+        if (pos >= entries.size())
+            throw_malformed_index("split index deletion out of range");
+        deleted[pos] = true;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (deleted[i])
+            continue;
+        if (kept != i)
+            entries[kept] = std::move(entries[i]);
+        kept += 1;
+    }
+    entries.resize(kept);
+
+    // the remaining entries of the split index are added (or replace entries of the same name and stage)
+    for (size_t i = replaced; i < split_entries.size(); ++i) {
+        index_entry& e = split_entries[i];
+        if (e.path.empty())
+            throw_malformed_index("split index entry without name");
+        int const stage = e.stage();
+        auto it = std::lower_bound(entries.begin(), entries.end(), e, [stage](index_entry const& a, index_entry const& b) {
+            return entry_less(a, b.path, stage);
+        });
+        if (it != entries.end() && it->path == e.path && it->stage() == stage) {
+            *it = std::move(e);
+            continue;
+        }
+        if (stage == 0) {
+            // a merged entry replaces all unmerged entries of the same path
+            auto end = it;
+            while (end != entries.end() && end->path == e.path)
+                ++end;
+            it = entries.erase(it, end);
+        }
+        entries.insert(it, std::move(e));
+    }
+
+    m_entries = std::move(entries);
+}
+
+std::optional<std::string_view> index_file::extension(std::string_view signature) const
+{
+    auto it = m_extensions.find(signature);
+    if (it == m_extensions.end())
+        return std::nullopt;
+    return it->second;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+
+namespace git {
+
+    struct file_time {
+        int64_t sec = 0;
+        uint32_t nsec = 0;
+
+        /// modification and status change time of a stat result; the fields are named differently on macOS
+#ifdef __APPLE__
+        static file_time mtime_of(struct stat const& st) { return {st.st_mtimespec.tv_sec, static_cast<uint32_t>(st.st_mtimespec.tv_nsec)}; }
+        static file_time ctime_of(struct stat const& st) { return {st.st_ctimespec.tv_sec, static_cast<uint32_t>(st.st_ctimespec.tv_nsec)}; }
+#else
+        static file_time mtime_of(struct stat const& st) { return {st.st_mtim.tv_sec, static_cast<uint32_t>(st.st_mtim.tv_nsec)}; }
+        static file_time ctime_of(struct stat const& st) { return {st.st_ctim.tv_sec, static_cast<uint32_t>(st.st_ctim.tv_nsec)}; }
+#endif
+
+        bool operator==(file_time const& other) const { return sec == other.sec && nsec == other.nsec; }
+        bool operator!=(file_time const& other) const { return !(*this == other); }
+        bool operator<(file_time const& other) const { return sec < other.sec || (sec == other.sec && nsec < other.nsec); }
+        bool operator>=(file_time const& other) const { return !(*this < other); }
+    };
+
+    /// Read-only memory mapping of a file.
+    class mapped_file {
+        void* m_data = nullptr;
+        size_t m_size = 0;
+        file_time m_mtime;
+
+    public:
+        mapped_file() = default;
+        ~mapped_file() noexcept;
+        mapped_file(mapped_file const&) = delete;
+        mapped_file& operator=(mapped_file const&) = delete;
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+
+        /// throws std::system_error if the file cannot be opened or mapped
+        static mapped_file open(std::string const& path);
+
+        std::string_view data() const { return {static_cast<char const*>(m_data), m_size}; }
+
+        /// modification time of the file when it was mapped
+        file_time mtime() const { return m_mtime; }
+    };
+
+    /// An entry of the git index, see gitformat-index(5).
+    struct index_entry {
+        std::string path;
+        file_time ctime;
+        file_time mtime;
+        uint32_t dev = 0;
+        uint32_t ino = 0;
+        uint32_t mode = 0;
+        uint32_t uid = 0;
+        uint32_t gid = 0;
+        /// truncated to 32 bits
+        uint32_t size = 0;
+        std::array<unsigned char, 20> oid{};
+        uint16_t flags = 0;
+        uint16_t extended_flags = 0;
+
+        int stage() const { return (flags >> 12) & 0x3; }
+        bool is_assume_valid() const { return (flags & 0x8000) != 0; }
+        bool is_skip_worktree() const { return (extended_flags & 0x4000) != 0; }
+        bool is_intent_to_add() const { return (extended_flags & 0x2000) != 0; }
+        bool is_gitlink() const { return (mode & 0170000) == 0160000; }
+        bool is_symlink() const { return (mode & 0170000) == 0120000; }
+    };
+
+    /// Native reader of the git index file (versions 2 to 4, including split indexes).
+    /// Only repositories using SHA-1 object ids are supported.
+    class index_file {
+    public:
+        /// Read the index at the given path. If it is a split index, the shared index is read as well
+        /// and the entries are merged. A missing file is read as an empty index.
+        /// Throws if the file cannot be read, is malformed, or uses unsupported features.
+        static index_file read(std::string const& path);
+
+        uint32_t version() const { return m_version; }
+
+        /// entries sorted by path and stage
+        std::vector<index_entry> const& entries() const { return m_entries; }
+
+        /// modification time of the index file; entries modified at or after this time are racily clean
+        file_time mtime() const { return m_file.mtime(); }
+
+        /// Raw data of the extension with the given signature (e.g., "UNTR"), if present.
+        /// The data is valid as long as this object exists.
+        std::optional<std::string_view> extension(std::string_view signature) const;
+
+        /// whether this is a split index (see git-update-index(1) on --split-index)
+        bool is_split() const { return m_split; }
+
+    private:
+        struct link_extension {
+            std::array<unsigned char, 20> base_oid{};
+            std::vector<size_t> delete_positions;
+            std::vector<size_t> replace_positions;
+        };
+
+        void parse(std::string_view data, std::optional<link_extension>* link);
+        void merge_shared_index(index_file shared, link_extension const& link);
+
+    private:
+        mapped_file m_file;
+        uint32_t m_version = 0;
+        bool m_split = false;
+        std::vector<index_entry> m_entries;
+        std::map<std::string, std::string_view, std::less<>> m_extensions;
+    };
+
+}
@@ -0,0 +1,70 @@
+#include "index_reader.h"
+#include <fmt/format.h>
+#include <stdexcept>
+
+using namespace git;
+
+void git::throw_malformed_index(std::string_view what)
+{
+    throw std::runtime_error(fmt::format("malformed index: {}", what));
+}
+
+uint64_t index_reader::varint()
+{
+    auto next = [this]() { return static_cast<unsigned char>(bytes(1)[0]); };
+    unsigned char c = next();
+    uint64_t value = c & 127;
+    while (c & 128) {
+        value += 1;
+        if (value == 0 || (value >> 57) != 0)
+            throw_malformed_index("varint overflow");
+        c = next();
+        value = (value << 7) + (c & 127);
+    }
+    return value;
+}
+
+std::string_view index_reader::c_str()
+{
+    size_t const end = m_data.find('\0', m_pos);
+    if (end == std::string_view::npos)
+        throw_malformed_index("unterminated string");
+    std::string_view result = m_data.substr(m_pos, end - m_pos);
+    m_pos = end + 1;
+    return result;
+}
+
+std::vector<size_t> git::read_ewah_bitmap(index_reader& r)
+{
+    r.be32();  // number of bits
+    uint32_t const word_count = r.be32();
+    r.require(size_t(word_count) * 8);
+
+    std::vector<size_t> positions;
+    size_t pos = 0;
+    uint32_t i = 0;
+    while (i < word_count) {
+        // run length word: run bit, 32 bits running length, 31 bits number of literal words
+        uint64_t const rlw = r.be64();
+        i += 1;
+        bool const run_bit = (rlw & 1) != 0;
+        size_t const running_length = size_t((rlw >> 1) & 0xffffffffu) * 64;
+        size_t const literal_words = size_t(rlw >> 33);
+        if (run_bit)
+            for (size_t k = 0; k < running_length; ++k)
+                positions.push_back(pos + k);
+        pos += running_length;
+        for (size_t k = 0; k < literal_words; ++k) {
+            if (i >= word_count)
+                throw_malformed_index("EWAH bitmap literal words exceed buffer");
+            uint64_t const word = r.be64();
+            i += 1;
+            for (unsigned bit = 0; bit < 64; ++bit)
+                if (word & (uint64_t(1) << bit))
+                    positions.push_back(pos + bit);
+            pos += 64;
+        }
+    }
+    r.be32();  // position of the last run length word
+    return positions;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace git {
+
+    /// Throws std::runtime_error with the message "malformed index: <what>".
+    [[noreturn]] void throw_malformed_index(std::string_view what);
+
+    /// Bounds-checked big-endian reader for the index file and its extensions.
+    class index_reader {
+        std::string_view m_data;
+        size_t m_pos = 0;
+
+    public:
+        explicit index_reader(std::string_view data) : m_data(data) { }
+
+        size_t pos() const { return m_pos; }
+        size_t remaining() const { return m_data.size() - m_pos; }
+
+        void require(size_t n) const
+        {
+            if (remaining() < n)
+                throw_malformed_index("unexpected end of data");
+        }
+
+        std::string_view bytes(size_t n)
+        {
+            require(n);
+            std::string_view result = m_data.substr(m_pos, n);
+            m_pos += n;
+            return result;
+        }
+
+        void skip(size_t n) { bytes(n); }
+
+        template <typename T>
+        T be()
+        {
+            std::string_view b = bytes(sizeof(T));
+            T value = 0;
+            for (char c : b)
+                value = static_cast<T>((value << 8) | static_cast<unsigned char>(c));
+            return value;
+        }
+
+        uint16_t be16() { return be<uint16_t>(); }
+        uint32_t be32() { return be<uint32_t>(); }
+        uint64_t be64() { return be<uint64_t>(); }
+
+        /// the variable-length integer encoding of index v4 (offset encoding, see git's varint.c)
+        uint64_t varint();
+
+        /// NUL-terminated string (the terminator is consumed)
+        std::string_view c_str();
+    };
+
+    /// Positions of the set bits in an EWAH-compressed bitmap (see git's ewah/ewah_io.c).
+    std::vector<size_t> read_ewah_bitmap(index_reader& r);
+
+}
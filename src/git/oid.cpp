@@ -13,6 +13,16 @@ oid::oid(git_oid const& the_oid)
     : m_oid{the_oid}
 { }
 
+std::optional<oid> oid::from_hex(std::string_view hex)
+{
+    if (hex.size() != GIT_OID_MAX_HEXSIZE)
+        return std::nullopt;
+    git_oid id;
+    if (git_oid_fromstrn(&id, hex.data(), hex.size()) != 0)
+        return std::nullopt;
+    return oid{id};
+}
+
 bool oid::is_zero() const
 {
     return git_oid_is_zero(get());
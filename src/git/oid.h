@@ -3,7 +3,9 @@
 #include <git2/oid.h>
 #include <fmt/core.h>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
 struct git_oid;
 
@@ -18,6 +20,9 @@ namespace git {
         oid();
         oid(git_oid const& the_oid);
 
+        /// parse a full hexadecimal object id; std::nullopt if it is malformed
+        static std::optional<oid> from_hex(std::string_view hex);
+
         git_oid const* get() const { return &m_oid; }
 
         bool is_zero() const;
@@ -0,0 +1,315 @@
+#include "ref_snapshot.h"
+#include "reference.h"
+#include "repository.h"
+#include "util.h"
+#include <algorithm>
+#include <cctype>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/format.h>
+#include <git2.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+using namespace git;
+
+namespace {
+
+    constexpr std::string_view k_heads_prefix = "refs/heads/";
+    constexpr std::string_view k_remotes_prefix = "refs/remotes/";
+    constexpr std::string_view k_symref_prefix = "ref: ";
+    constexpr std::string_view k_packed_refs_header = "# pack-refs with:";
+    /// same limit as git
+    constexpr int k_max_symref_depth = 5;
+    /// loose refs are an object id or "ref: <target>"; longer files are not refs
+    constexpr size_t k_max_loose_ref_size = 1024;
+
+    bool starts_with(std::string_view s, std::string_view prefix)
+    {
+        return s.substr(0, prefix.size()) == prefix;
+    }
+
+    struct refspec_deleter {
+        void operator()(git_refspec* spec) const { git_refspec_free(spec); }
+    };
+    using refspec_ptr = std::unique_ptr<git_refspec, refspec_deleter>;
+
+    struct upstream_config {
+        std::string remote;
+        std::string merge;
+    };
+
+    struct config_t {
+        /// by branch name without "refs/heads/"
+        std::map<std::string, upstream_config, std::less<>> branches;
+        /// by remote name
+        std::map<std::string, std::vector<refspec_ptr>, std::less<>> fetch_refspecs;
+        /// extensions.refStorage, empty for the default (files)
+        std::string ref_storage;
+    };
+
+    config_t read_config(git_repository* repo)
+    {
+        git_config* config_raw = nullptr;
+        int error = git_repository_config_snapshot(&config_raw, repo);
+        throw_on_git2_error(error);
+        std::unique_ptr<git_config, decltype(&git_config_free)> config(config_raw, &git_config_free);
+
+        // variable names are normalized to lowercase, except for the subsection (i.e., the branch or remote name)
+        git_config_iterator* iter_raw = nullptr;
+        error = git_config_iterator_glob_new(&iter_raw, config.get(), "^(branch\\..+\\.(remote|merge)|remote\\..+\\.fetch|extensions\\.refstorage)$");
+        throw_on_git2_error(error);
+        std::unique_ptr<git_config_iterator, decltype(&git_config_iterator_free)> iter(iter_raw, &git_config_iterator_free);
+
+        config_t result;
+        git_config_entry* entry = nullptr;
+        while ((error = git_config_next(&entry, iter.get())) == 0) {
+            if (!entry->value)
+                continue;
+            std::string_view const name = entry->name;
+            size_t const key_pos = name.rfind('.');
+            std::string_view const key = name.substr(key_pos + 1);
+            if (starts_with(name, "branch.")) {
+                upstream_config& branch = result.branches[std::string(name.substr(7, key_pos - 7))];
+                (key == "remote" ? branch.remote : branch.merge) = entry->value;
+            }
+            else if (starts_with(name, "remote.")) {
+                std::vector<refspec_ptr>& refspecs = result.fetch_refspecs[std::string(name.substr(7, key_pos - 7))];
+                git_refspec* spec = nullptr;
+                // negative refspecs ("^refs/...") only exclude refs, they do not map any
+                if (entry->value[0] == '^' || git_refspec_parse(&spec, entry->value, 1) < 0) {
+                    git_error_clear();
+                    continue;
+                }
+                refspecs.emplace_back(spec);
+            }
+            else {
+                result.ref_storage = entry->value;
+            }
+        }
+        if (error != GIT_ITEROVER)
+            throw_on_git2_error(error);
+        return result;
+    }
+
+    /// the remote-tracking branch that git_branch_upstream() would look up, see git-config(1) on branch.<name>.merge
+    std::optional<std::string> upstream_name(config_t const& config, upstream_config const& branch)
+    {
+        if (branch.remote.empty() || branch.merge.empty())
+            return std::nullopt;
+        if (branch.remote == ".")
+            return branch.merge;  // the upstream is a local branch
+        auto const refspecs = config.fetch_refspecs.find(branch.remote);
+        if (refspecs == config.fetch_refspecs.end())
+            return std::nullopt;
+        for (refspec_ptr const& spec : refspecs->second) {
+            if (!git_refspec_src_matches(spec.get(), branch.merge.c_str()))
+                continue;
+            git_buf buf = GIT_BUF_INIT;
+            int error = git_refspec_transform(&buf, spec.get(), branch.merge.c_str());
+            throw_on_git2_error(error);
+            std::string name{buf.ptr, buf.size};
+            git_buf_dispose(&buf);
+            return name;
+        }
+        return std::nullopt;
+    }
+
+    /// content of a loose ref without trailing whitespace; std::nullopt if there is no such file
+    std::optional<std::string> read_loose_ref(std::string const& path)
+    {
+        int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return std::nullopt;
+        char buffer[k_max_loose_ref_size];
+        ssize_t const n = ::read(fd, buffer, sizeof(buffer));
+        ::close(fd);
+        if (n <= 0)
+            return std::nullopt;  // e.g., a directory of refs
+        std::string_view value(buffer, static_cast<size_t>(n));
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+            value.remove_suffix(1);
+        return std::string(value);
+    }
+
+}
+
+ref_snapshot::ref_snapshot(repository& repo)
+    : m_commondir(repo.commondir())  // ends with a slash
+{
+    config_t const config = read_config(repo.repo());
+
+    std::error_code ec;
+    bool const native = (config.ref_storage.empty() || config.ref_storage == "files")
+        && !std::filesystem::exists(m_commondir + "reftable", ec);
+    if (native) {
+        // pack-refs writes packed-refs before it deletes the loose refs it packed,
+        // so reading the loose refs first does not miss refs that are packed in between
+        std::vector<std::pair<std::string_view, std::string>> loose;
+        read_loose_branches(loose);
+        read_packed_refs();
+
+        // loose refs take precedence over packed refs
+        std::map<std::string_view, std::optional<oid>> branches;
+        for (auto const& [name, value] : loose) {
+            std::optional<oid> id = starts_with(value, k_symref_prefix) ? resolve(std::string_view(value).substr(k_symref_prefix.size()))
+                                                                        : oid::from_hex(value);
+            branches.emplace(name, id);
+        }
+        auto it = std::lower_bound(m_packed_refs.begin(), m_packed_refs.end(), k_heads_prefix,
+                                   [](packed_ref const& ref, std::string_view name) { return ref.name < name; });
+        for (; it != m_packed_refs.end() && starts_with(it->name, k_heads_prefix); ++it) {
+            if (!branches.count(it->name))
+                branches.emplace(it->name, oid::from_hex(it->hex));
+        }
+        for (auto const& [name, id] : branches) {
+            if (id)
+                m_branches.push_back(branch{name, *id, {}});
+        }
+    }
+    else {
+        m_repo = repo.repo();
+        read_branches_libgit2();
+    }
+
+    for (branch& b : m_branches) {
+        auto const it = config.branches.find(b.name.substr(k_heads_prefix.size()));
+        if (it == config.branches.end())
+            continue;
+        if (std::optional<std::string> upstream = upstream_name(config, it->second))
+            b.upstream = m_strings.emplace_back(std::move(*upstream));
+    }
+}
+
+void ref_snapshot::read_loose_branches(std::vector<std::pair<std::string_view, std::string>>& loose)
+{
+    std::string const heads_dir = m_commondir + std::string(k_heads_prefix);
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(heads_dir, ec);
+    if (ec)
+        return;  // e.g., a fresh repository whose refs are all packed
+    for (std::filesystem::recursive_directory_iterator const end; it != end; it.increment(ec)) {
+        if (ec)
+            throw std::system_error(ec, heads_dir);
+        if (!it->is_regular_file(ec))
+            continue;
+        std::string path = it->path().string();
+        if (path.size() > 5 && path.compare(path.size() - 5, 5, ".lock") == 0)
+            continue;  // a ref that is being updated, the old value is still in the ref itself
+        std::optional<std::string> value = read_loose_ref(path);
+        if (!value)
+            continue;  // deleted concurrently
+        std::string_view const name = m_strings.emplace_back(path.substr(m_commondir.size()));
+        loose.emplace_back(name, std::move(*value));
+    }
+}
+
+void ref_snapshot::read_packed_refs()
+{
+    try {
+        m_packed_refs_file = mapped_file::open(m_commondir + "packed-refs");
+    }
+    catch (std::system_error const& e) {
+        if (e.code() == std::errc::no_such_file_or_directory)
+            return;
+        throw;
+    }
+
+    // "<oid> <name>" per ref, each followed by "^<oid>" with the peeled object id if the ref is an annotated tag.
+    // Only branches and remote-tracking branches are indexed; the names point into the mapping.
+    std::string_view data = m_packed_refs_file.data();
+    bool sorted = false;
+    while (!data.empty()) {
+        size_t const end = data.find('\n');
+        std::string_view const line = data.substr(0, end);
+        data.remove_prefix(end == std::string_view::npos ? data.size() : end + 1);
+        if (line.empty() || line[0] == '^')
+            continue;
+        if (line[0] == '#') {
+            if (starts_with(line, k_packed_refs_header)) {
+                std::string const traits = std::string(line.substr(k_packed_refs_header.size())) + ' ';
+                sorted = traits.find(" sorted ") != std::string::npos;
+            }
+            continue;
+        }
+        size_t const space = line.find(' ');
+        if (space == std::string_view::npos)
+            throw std::runtime_error(fmt::format("malformed line in {}packed-refs", m_commondir));
+        std::string_view const name = line.substr(space + 1);
+        if (starts_with(name, k_heads_prefix) || starts_with(name, k_remotes_prefix))
+            m_packed_refs.push_back(packed_ref{name, line.substr(0, space)});
+    }
+
+    // git has written sorted packed-refs for a long time, older files are sorted here
+    if (!sorted)
+        std::sort(m_packed_refs.begin(), m_packed_refs.end(), [](packed_ref const& a, packed_ref const& b) { return a.name < b.name; });
+}
+
+void ref_snapshot::read_branches_libgit2()
+{
+    git_reference_iterator* iter_raw = nullptr;
+    int error = git_reference_iterator_glob_new(&iter_raw, m_repo, "refs/heads/*");
+    throw_on_git2_error(error);
+    std::unique_ptr<git_reference_iterator, decltype(&git_reference_iterator_free)> iter(iter_raw, &git_reference_iterator_free);
+
+    git_reference* ref_raw = nullptr;
+    while ((error = git_reference_next(&ref_raw, iter.get())) == 0) {
+        reference ref{ref_raw};
+        std::optional<oid> id;
+        try {
+            id = ref.resolve().target();
+        }
+        catch (std::exception const&) {
+            // a dangling symbolic ref
+        }
+        if (id)
+            m_branches.push_back(branch{m_strings.emplace_back(ref.name()), *id, {}});
+    }
+    if (error != GIT_ITEROVER)
+        throw_on_git2_error(error);
+
+    std::sort(m_branches.begin(), m_branches.end(), [](branch const& a, branch const& b) { return a.name < b.name; });
+}
+
+std::string_view ref_snapshot::packed_value(std::string_view name) const
+{
+    auto const it = std::lower_bound(m_packed_refs.begin(), m_packed_refs.end(), name,
+                                     [](packed_ref const& ref, std::string_view name) { return ref.name < name; });
+    if (it == m_packed_refs.end() || it->name != name)
+        return {};
+    return it->hex;
+}
+
+std::optional<oid> ref_snapshot::resolve(std::string_view name) const
+{
+    if (m_repo) {
+        git_oid id;
+        int error = git_reference_name_to_id(&id, m_repo, std::string(name).c_str());
+        if (error == GIT_ENOTFOUND) {
+            git_error_clear();
+            return std::nullopt;
+        }
+        throw_on_git2_error(error);
+        return oid{id};
+    }
+
+    std::string target;
+    for (int depth = 0; depth < k_max_symref_depth; ++depth) {
+        // ref names cannot contain "..", so this stays within the refs
+        if (name.find("..") != std::string_view::npos)
+            return std::nullopt;
+        std::optional<std::string> const loose = read_loose_ref(m_commondir + std::string(name));
+        std::string_view const value = loose ? std::string_view(*loose) : packed_value(name);
+        if (value.empty())
+            return std::nullopt;
+        if (!starts_with(value, k_symref_prefix))
+            return oid::from_hex(value);
+        target = value.substr(k_symref_prefix.size());
+        name = target;
+    }
+    fmt::println(stderr, "too many levels of symbolic refs at {}", name);
+    return std::nullopt;
+}
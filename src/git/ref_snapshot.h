@@ -0,0 +1,76 @@
+#pragma once
+
+#include "index_file.h"
+#include "oid.h"
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct git_repository;
+
+namespace git {
+
+    class repository;
+
+    /// Read-only view of the local branches, their upstreams and the remote-tracking branches of a repository,
+    /// read without allocating a git_reference per branch.
+    ///
+    /// With the files ref backend, packed-refs is memory-mapped and the loose refs in refs/heads/ are overlaid on it;
+    /// remote-tracking branches are only read when they are resolved. The upstreams are derived from a single pass
+    /// over the config (branch.<name>.remote, branch.<name>.merge and the fetch refspecs of the remotes),
+    /// instead of reading the config again for each branch like git_branch_upstream() does.
+    /// Other ref backends (i.e., reftable) are read through libgit2.
+    ///
+    /// The names are valid as long as the snapshot exists.
+    class ref_snapshot {
+    public:
+        struct branch {
+            /// full name, e.g., "refs/heads/main"
+            std::string_view name;
+            oid id;
+            /// full name of the configured upstream (e.g., "refs/remotes/origin/main"), empty if there is none.
+            /// The upstream may not exist.
+            std::string_view upstream;
+        };
+
+        explicit ref_snapshot(repository& repo);
+
+        /// local branches sorted by name; symbolic refs are resolved, and ones that cannot be resolved are left out
+        std::vector<branch> const& local_branches() const { return m_branches; }
+
+        /// Resolve a local or remote-tracking branch (following symbolic refs); std::nullopt if it does not exist.
+        /// Loose refs are read when this is called, packed refs when the snapshot was taken.
+        std::optional<oid> resolve(std::string_view name) const;
+
+        /// whether the refs are read natively, i.e., not through libgit2
+        bool is_native() const { return !m_repo; }
+
+    private:
+        struct packed_ref {
+            std::string_view name;
+            std::string_view hex;
+        };
+
+        /// names and values (an object id in hex, or "ref: <target>") of the loose refs in refs/heads/
+        void read_loose_branches(std::vector<std::pair<std::string_view, std::string>>& loose);
+        void read_packed_refs();
+        void read_branches_libgit2();
+        /// the object id (in hex) of the ref in packed-refs, or empty
+        std::string_view packed_value(std::string_view name) const;
+
+    private:
+        std::string m_commondir;
+        /// only set if the refs are read through libgit2
+        git_repository* m_repo = nullptr;
+        mapped_file m_packed_refs_file;
+        /// branches and remote-tracking branches of packed-refs, sorted by name
+        std::vector<packed_ref> m_packed_refs;
+        /// names that are not part of packed-refs; a deque keeps them in place
+        std::deque<std::string> m_strings;
+        std::vector<branch> m_branches;
+    };
+
+}
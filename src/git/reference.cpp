@@ -104,11 +104,11 @@ std::optional<std::string> reference::remote_name() const
     int error = git_branch_remote_name(&buf, repo, name);
     // TODO: decide what to do with GIT_ENOTFOUND and GIT_EAMBIGUOUS
     if (error == GIT_ENOTFOUND) {
-        fmt::println("no remote found for remote-tracking branch {}", name);
+        fmt::println(stderr, "no remote found for remote-tracking branch {}", name);
         return std::nullopt;
     }
     if (error == GIT_EAMBIGUOUS) {
-        fmt::println("multiple remotes found for remote-tracking branch {}", name);
+        fmt::println(stderr, "multiple remotes found for remote-tracking branch {}", name);
         return std::nullopt;
     }
     throw_on_git2_error(error);
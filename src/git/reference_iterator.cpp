@@ -0,0 +1,31 @@
+#include "reference_iterator.h"
+#include "util.h"
+#include <git2.h>
+#include <stdexcept>
+
+using namespace git;
+
+reference_iterator::reference_iterator(git_reference_iterator* iter)
+    : m_iter(iter)
+{
+    if (!m_iter)
+        throw std::invalid_argument("git_reference_iterator* is null");
+}
+
+void reference_iterator::git_reference_iterator_deleter::operator()(git_reference_iterator* ptr) const
+{
+    git_reference_iterator_free(ptr);
+}
+
+reference_iterator::~reference_iterator() noexcept
+{ }
+
+std::optional<char const*> reference_iterator::next_name()
+{
+    char const* name = nullptr;
+    int error = git_reference_next_name(&name, m_iter.get());
+    if (error == GIT_ITEROVER)
+        return std::nullopt;
+    throw_on_git2_error(error);
+    return name;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+
+struct git_reference_iterator;
+
+namespace git {
+
+    /// Iterates over reference names without looking up the references.
+    class reference_iterator {
+
+        struct git_reference_iterator_deleter {
+            void operator()(git_reference_iterator* ptr) const;
+        };
+
+        std::unique_ptr<git_reference_iterator, git_reference_iterator_deleter> m_iter;
+
+    public:
+        /// takes ownership of the given git_reference_iterator.
+        explicit reference_iterator(git_reference_iterator* iter);
+        ~reference_iterator() noexcept;
+        reference_iterator(reference_iterator const&) = delete;
+        reference_iterator& operator=(reference_iterator const&) = delete;
+        reference_iterator(reference_iterator&&) = default;
+        reference_iterator& operator=(reference_iterator&&) = default;
+
+        /// Full name of the next reference (e.g., "refs/heads/main").
+        /// The returned string is only valid until the next call.
+        std::optional<char const*> next_name();
+    };
+
+}
@@ -0,0 +1,114 @@
+#include "reflog_tail.h"
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fmt/format.h>
+#include <memory>
+#include <string_view>
+#include <sys/stat.h>
+#include <system_error>
+
+using namespace git;
+
+namespace {
+
+    /// "<old-oid> <new-oid> <committer> <timestamp> <tz>\t<message>", see git-reflog(1)
+    constexpr size_t k_hex_size = GIT_OID_MAX_HEXSIZE;
+
+    struct file_closer {
+        void operator()(FILE* f) const { std::fclose(f); }
+    };
+
+}
+
+reflog_tail::reflog_tail(std::vector<std::string> prefixes)
+    : m_prefixes(std::move(prefixes))
+{ }
+
+std::optional<reflog_tail::changes_t> reflog_tail::update(std::string const& logs_dir)
+{
+    bool const baseline = (logs_dir == m_logs_dir);
+    if (!baseline) {
+        m_logs_dir = logs_dir;
+        m_files.clear();
+    }
+
+    changes_t changes;
+    std::unordered_map<std::string, file_state> files;
+    for (std::string const& prefix : m_prefixes) {
+        std::error_code ec;
+        std::filesystem::recursive_directory_iterator it(logs_dir + prefix, ec);
+        if (ec)
+            continue;  // e.g., no remotes
+        for (std::filesystem::recursive_directory_iterator const end; it != end; it.increment(ec)) {
+            if (ec)
+                throw std::system_error(ec, logs_dir + prefix);
+            if (!it->is_regular_file(ec))
+                continue;
+            std::string const path = it->path().string();
+            std::string ref = path.substr(logs_dir.size());
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0)
+                continue;  // removed concurrently
+
+            file_state state{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino), 0};
+            auto const previous = m_files.find(ref);
+            bool const appended_only = previous != m_files.end()
+                && previous->second.dev == state.dev && previous->second.ino == state.ino
+                && previous->second.offset <= static_cast<uint64_t>(st.st_size);
+            if (!appended_only) {
+                // a new or rewritten reflog; its entries do not tell where the ref is now
+                state.offset = static_cast<uint64_t>(st.st_size);
+                if (baseline)
+                    changes.emplace(ref, std::nullopt);
+            }
+            else if (previous->second.offset == static_cast<uint64_t>(st.st_size)) {
+                state.offset = previous->second.offset;
+            }
+            else {
+                std::optional<oid> last_id;
+                state.offset = read_appended(path, previous->second.offset, last_id);
+                if (state.offset != previous->second.offset)
+                    changes.emplace(ref, last_id);
+            }
+            files.emplace(std::move(ref), state);
+        }
+    }
+
+    // removed reflogs belong to deleted (or renamed) refs
+    for (auto const& [ref, state] : m_files) {
+        if (!files.count(ref))
+            changes.emplace(ref, std::nullopt);
+    }
+    m_files = std::move(files);
+
+    if (!baseline)
+        return std::nullopt;
+    return changes;
+}
+
+uint64_t reflog_tail::read_appended(std::string const& path, uint64_t offset, std::optional<oid>& last_id)
+{
+    std::unique_ptr<FILE, file_closer> f(std::fopen(path.c_str(), "rbe"));
+    if (!f || ::fseeko(f.get(), static_cast<off_t>(offset), SEEK_SET) != 0)
+        return offset;
+
+    std::string data;
+    char buffer[16 * 1024];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), f.get())) > 0)
+        data.append(buffer, n);
+
+    // an incomplete last line is being written concurrently, it is read again in the next update
+    size_t const end = data.rfind('\n');
+    if (end == std::string::npos)
+        return offset;
+    std::string_view entries(data.data(), end);
+    size_t const line_start = entries.rfind('\n') + 1;  // npos + 1 == 0
+    std::string_view const last = entries.substr(line_start);
+    if (last.size() > 2 * k_hex_size + 1 && last[k_hex_size] == ' ')
+        last_id = oid::from_hex(last.substr(k_hex_size + 1, k_hex_size));
+    else
+        fmt::println(stderr, "malformed reflog entry in {}", path);
+    return offset + end + 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "oid.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace git {
+
+    /// Follows the reflogs of a repository to find out which refs moved since the previous update,
+    /// without resolving any refs.
+    ///
+    /// The size of each reflog is remembered, so an update only stats the files and reads the entries appended since then.
+    /// Every ref update by git appends to the ref's reflog (if it exists, see core.logAllRefUpdates),
+    /// so refs whose reflog did not grow are known not to have moved.
+    class reflog_tail {
+    public:
+        /// moved refs by full name; the value is the new object id of the last appended entry,
+        /// or std::nullopt if the reflog was created, rewritten (e.g., by `git reflog expire`) or removed
+        using changes_t = std::map<std::string, std::optional<oid>>;
+
+        /// @param prefixes the refs to follow, e.g., "refs/heads/"
+        explicit reflog_tail(std::vector<std::string> prefixes = {"refs/heads/", "refs/remotes/"});
+
+        /// Read the reflogs in logs_dir (e.g., "<commondir>/logs/").
+        /// Returns std::nullopt on the first update of a directory, since there is nothing to compare with yet.
+        std::optional<changes_t> update(std::string const& logs_dir);
+
+        /// Whether the ref had a reflog at the last update, i.e., whether its moves show up in the next update.
+        bool tracks(std::string const& ref) const { return m_files.count(ref) > 0; }
+
+    private:
+        struct file_state {
+            uint64_t dev = 0;
+            uint64_t ino = 0;
+            /// end of the last complete entry that was read
+            uint64_t offset = 0;
+        };
+
+        /// Read the entries after the given offset; returns the new offset, and the new object id of the last entry.
+        static uint64_t read_appended(std::string const& path, uint64_t offset, std::optional<oid>& last_id);
+
+    private:
+        std::vector<std::string> m_prefixes;
+        std::string m_logs_dir;
+        std::unordered_map<std::string, file_state> m_files;
+    };
+
+}
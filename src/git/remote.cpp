@@ -20,6 +20,15 @@ struct remote::callbacks_t {
     static int credential_acquire_cb(git_credential** out, char const* url, char const* username_from_url, unsigned int allowed_types, void* payload);
 };
 
+std::string_view git::normalized_url(std::string_view url)
+{
+    while (!url.empty() && url.back() == '/')
+        url.remove_suffix(1);
+    if (url.size() > 4 && url.substr(url.size() - 4) == ".git")
+        url.remove_suffix(4);
+    return url;
+}
+
 remote::remote(git_remote* remote)
     : m_remote{remote}, m_callbacks{std::make_unique<callbacks_t>()}
 {
@@ -41,6 +50,11 @@ char const* remote::name() const
     return git_remote_name(m_remote.get());
 }
 
+char const* remote::url() const
+{
+    return git_remote_url(m_remote.get());
+}
+
 bool remote::is_connected() const
 {
     return git_remote_connected(m_remote.get());
@@ -67,7 +81,7 @@ int remote::callbacks_t::credential_acquire_cb(git_credential** out, char const*
         }
     }
     else {
-        fmt::println("no supported credential types: {}", allowed_types);
+        fmt::println(stderr, "no supported credential types: {}", allowed_types);
     }
 
     // return value:
@@ -103,12 +117,12 @@ std::vector<remote_ref> remote::ls()
     std::vector<remote_ref> rrs;
     for (size_t i = 0; i < num_remote_heads; ++i) {
         git_remote_head const* remote_head = remote_heads[i];
-        // fmt::println("remote_head #{}:", i);
-        // fmt::println("    name: {}", remote_head->name);
-        // fmt::println("    symref_target: {}", remote_head->symref_target ? remote_head->symref_target : "<null>");
-        // fmt::println("    locally available: {}", remote_head->local);
-        // fmt::println("    oid: {}", oid{remote_head->oid});
-        // fmt::println("    local oid: {}", oid{remote_head->loid});
+        // fmt::println(stderr, "remote_head #{}:", i);
+        // fmt::println(stderr, "    name: {}", remote_head->name);
+        // fmt::println(stderr, "    symref_target: {}", remote_head->symref_target ? remote_head->symref_target : "<null>");
+        // fmt::println(stderr, "    locally available: {}", remote_head->local);
+        // fmt::println(stderr, "    oid: {}", oid{remote_head->oid});
+        // fmt::println(stderr, "    local oid: {}", oid{remote_head->loid});
         remote_ref rr;
         rr.name = remote_head->name;
         rr.id = remote_head->oid;
@@ -136,6 +150,6 @@ std::optional<std::string> remote::get_remote_branch(char const* remote_tracking
         return {std::move(remote_branch)};
     }
     // TODO: should we check if multiple refspecs match?
-    fmt::println("no matching refspec");
+    fmt::println(stderr, "no matching refspec");
     return std::nullopt;
 }
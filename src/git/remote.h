@@ -6,6 +6,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct git_credential;
@@ -13,6 +14,9 @@ struct git_remote;
 
 namespace git {
 
+    /// URL without trailing slashes and ".git" suffix, since "https://host/repo.git/" and "https://host/repo" refer to the same remote repository
+    std::string_view normalized_url(std::string_view url);
+
     struct remote_ref {
         std::string name;
         oid id;
@@ -46,6 +50,9 @@ namespace git {
         /// may be NULL for anonymous/in-memory remotes
         char const* name() const;
 
+        /// the fetch URL
+        char const* url() const;
+
         bool is_connected() const;
 
         // only supports fetch direction for now
@@ -1,10 +1,25 @@
 #include "repository.h"
+#include "index_file.h"
+#include "status_scanner.h"
 #include "util.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
 #include <fmt/std.h>
 #include <git2.h>
+#include <git2/sys/repository.h>
+#include <limits>
 #include <map>
+#include <optional>
+#include <string_view>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_set>
 
 using namespace git;
 
@@ -71,6 +86,17 @@ reference repository::head()
     return reference{head};
 }
 
+std::optional<std::string> repository::head_branch_name()
+{
+    git_reference* head_raw = nullptr;
+    int error = git_reference_lookup(&head_raw, repo(), "HEAD");
+    throw_on_git2_error(error);
+    reference head{head_raw};
+    if (head.type() != reference_type::symbolic)
+        return std::nullopt;
+    return std::string(head.symbolic_target());
+}
+
 ahead_behind_t repository::graph_ahead_behind(oid const& local, oid const& upstream)
 {
     ahead_behind_t result;
@@ -89,19 +115,143 @@ std::optional<reference> repository::lookup_local_branch(char const* name)
     return {reference(branch_raw)};
 }
 
-std::vector<reference> repository::local_branches()
+reference_iterator repository::references_glob(char const* glob)
 {
-    git_branch_iterator* iter_raw;
-    int error = git_branch_iterator_new(&iter_raw, repo(), GIT_BRANCH_LOCAL);
+    git_reference_iterator* iter_raw = nullptr;
+    int error = git_reference_iterator_glob_new(&iter_raw, repo(), glob);
     throw_on_git2_error(error);
+    return reference_iterator{iter_raw};
+}
 
-    branch_iterator iter{iter_raw};
+std::vector<reference> repository::local_branches(branch_filter const& filter, branch_counts* counts, std::vector<bool>* inactive)
+{
     std::vector<reference> branches;
-    while (auto branch = iter.next())
-        branches.push_back(std::move(branch->first));
+    branch_counts c;
+
+    std::optional<std::string> head_name;
+    if (filter.has_patterns() || filter.active_since) {
+        try {
+            head_name = head_branch_name();
+        }
+        catch (std::exception const&) {
+            // without HEAD, only the filter applies
+        }
+    }
+
+    auto const add = [&](reference branch) {
+        c.monitored += 1;
+        bool const is_inactive = filter.active_since
+            && head_name != branch.name()
+            && !is_branch_active(branch, *filter.active_since);
+        if (is_inactive) {
+            c.inactive += 1;
+            if (filter.skip_inactive)
+                return;
+        }
+        if (inactive)
+            inactive->push_back(is_inactive);
+        branches.push_back(std::move(branch));
+    };
+
+    if (!filter.has_patterns()) {
+        git_branch_iterator* iter_raw;
+        int error = git_branch_iterator_new(&iter_raw, repo(), GIT_BRANCH_LOCAL);
+        throw_on_git2_error(error);
+
+        branch_iterator iter{iter_raw};
+        while (auto branch = iter.next()) {
+            c.total += 1;
+            add(std::move(branch->first));
+        }
+    }
+    else {
+        // only the names are read, so excluded branches are never looked up
+        constexpr std::string_view prefix = "refs/heads/";
+        reference_iterator iter = references_glob("refs/heads/*");
+        while (auto name = iter.next_name()) {
+            c.total += 1;
+            if (!filter.matches(*name + prefix.size()) && head_name != *name)
+                continue;
+            git_reference* ref_raw = nullptr;
+            int error = git_reference_lookup(&ref_raw, repo(), *name);
+            if (error == GIT_ENOTFOUND)
+                continue;  // deleted concurrently
+            throw_on_git2_error(error);
+            add(reference{ref_raw});
+        }
+    }
+
+    if (counts)
+        *counts = c;
+    return branches;
+}
+
+std::vector<ref_snapshot::branch> repository::local_branches(ref_snapshot const& refs, branch_filter const& filter, branch_counts* counts,
+                                                             std::vector<bool>* inactive)
+{
+    std::vector<ref_snapshot::branch> branches;
+    branch_counts c;
+
+    std::optional<std::string> head_name;
+    if (filter.has_patterns() || filter.active_since) {
+        try {
+            head_name = head_branch_name();
+        }
+        catch (std::exception const&) {
+            // without HEAD, only the filter applies
+        }
+    }
+
+    constexpr std::string_view prefix = "refs/heads/";
+    for (ref_snapshot::branch const& branch : refs.local_branches()) {
+        c.total += 1;
+        bool const is_head = head_name == branch.name;
+        if (filter.has_patterns() && !is_head && !filter.matches(std::string(branch.name.substr(prefix.size())).c_str()))
+            continue;
+        c.monitored += 1;
+        bool const is_inactive = filter.active_since && !is_head && !is_branch_active(branch.name, branch.id, *filter.active_since);
+        if (is_inactive) {
+            c.inactive += 1;
+            if (filter.skip_inactive)
+                continue;
+        }
+        if (inactive)
+            inactive->push_back(is_inactive);
+        branches.push_back(branch);
+    }
+
+    if (counts)
+        *counts = c;
     return branches;
 }
 
+bool repository::is_branch_active(reference const& branch, int64_t since)
+{
+    std::optional<oid> target = branch.resolve().target();
+    if (!target)
+        return true;
+    return is_branch_active(branch.name(), *target, since);
+}
+
+bool repository::is_branch_active(std::string_view branch_name, oid const& target, int64_t since)
+{
+    // the reflog is updated whenever the branch moves (commit, reset, pull, ...), and checking it does not require reading objects.
+    // commondir() ends with a slash.
+    std::string const reflog_path = fmt::format("{}logs/{}", commondir(), branch_name);
+    struct stat st;
+    if (::stat(reflog_path.c_str(), &st) == 0 && st.st_mtime >= since)
+        return true;
+
+    // without reflog (e.g., disabled by core.logAllRefUpdates), fall back to the committer date of the tip
+    git_commit* commit = nullptr;
+    int error = git_commit_lookup(&commit, repo(), target.get());
+    if (error < 0)
+        return true;  // let the ahead/behind computation report the problem
+    git_time_t const time = git_commit_time(commit);
+    git_commit_free(commit);
+    return time >= since;
+}
+
 std::optional<ahead_behind_t> repository::branch_ahead_behind(reference const& local)
 {
     if (!local.is_branch())
@@ -128,18 +278,111 @@ std::optional<ahead_behind_t> repository::head_ahead_behind()
     return branch_ahead_behind(head);
 }
 
-ahead_behind_t repository::total_ahead_behind()
+ahead_behind_t repository::total_ahead_behind(branch_filter const& filter, branch_counts* counts, ahead_behind_t* inactive_total,
+                                              ahead_behind_cache* cache)
 {
     ahead_behind_t total;
+    if (inactive_total)
+        *inactive_total = ahead_behind_t{};
+
+    // the branches and their upstreams are read once, instead of looking up each branch and reading the config for its upstream
+    ref_snapshot const refs(*this);
+
+    // which refs moved since the cache was updated; without reflogs to compare with, every upstream is resolved
+    std::optional<reflog_tail::changes_t> changes;
+    if (cache) {
+        changes = cache->reflogs.update(fmt::format("{}logs/", commondir()));
+        // the moves are only reported once, but branches that are skipped now may be visited later
+        if (changes && !changes->empty()) {
+            for (auto& [name, entry] : cache->branches) {
+                if (changes->count(entry.upstream))
+                    entry.upstream_moved = true;
+            }
+        }
+    }
+    // the upstream of a cached branch is resolved from its reflog if possible
+    auto const upstream_id = [&](ahead_behind_cache::branch const& cached) -> std::optional<oid> {
+        if (changes && cache->reflogs.tracks(cached.upstream)) {
+            auto const it = changes->find(cached.upstream);
+            if (it != changes->end() && it->second)
+                return it->second;
+            if (it == changes->end() && !cached.upstream_moved)
+                return cached.upstream_id;
+        }
+        return refs.resolve(cached.upstream);
+    };
+
+    auto const ahead_behind = [&](ref_snapshot::branch const& branch) -> std::optional<ahead_behind_t> {
+        if (branch.upstream.empty())
+            return std::nullopt;
+        if (!cache) {
+            std::optional<oid> const upstream = refs.resolve(branch.upstream);
+            if (!upstream)
+                return std::nullopt;
+            return graph_ahead_behind(branch.id, *upstream);
+        }
+
+        // entries whose upstream was reconfigured are computed again
+        auto const cached = cache->branches.find(branch.name);
+        bool const known = cached != cache->branches.end() && cached->second.upstream == branch.upstream;
+        std::optional<oid> const upstream = known ? upstream_id(cached->second) : refs.resolve(branch.upstream);
+        if (!upstream) {
+            if (cached != cache->branches.end())
+                cache->branches.erase(cached);
+            return std::nullopt;
+        }
+
+        if (known && cached->second.local_id == branch.id && cached->second.upstream_id == *upstream) {
+            cached->second.upstream_moved = false;
+            return cached->second.ahead_behind;
+        }
+        ahead_behind_cache::branch entry;
+        entry.upstream = branch.upstream;
+        entry.local_id = branch.id;
+        entry.upstream_id = *upstream;
+        entry.ahead_behind = graph_ahead_behind(branch.id, *upstream);
+        cache->branches.insert_or_assign(std::string(branch.name), entry);
+        return entry.ahead_behind;
+    };
 
-    for (auto const& branch : local_branches()) {
-        fmt::println("local branch: {}", branch.name());
-        auto ab = branch_ahead_behind(branch);
+    // skipped inactive branches still contribute their counts from the last time they were walked,
+    // so they are enumerated as well, and only the walk is skipped
+    branch_filter all_filter = filter;
+    all_filter.skip_inactive = false;
+    std::vector<bool> inactive;
+    std::vector<ref_snapshot::branch> const branches = local_branches(refs, all_filter, counts, &inactive);
+    for (size_t i = 0; i < branches.size(); ++i) {
+        ref_snapshot::branch const& branch = branches[i];
+        std::optional<ahead_behind_t> ab;
+        if (inactive[i] && filter.skip_inactive) {
+            if (!cache)
+                continue;
+            auto const cached = cache->branches.find(branch.name);
+            if (cached == cache->branches.end() || cached->second.upstream != branch.upstream)
+                continue;
+            ab = cached->second.ahead_behind;
+        }
+        else
+            ab = ahead_behind(branch);
         if (!ab)
             continue;
-        fmt::println("{} ahead, {} behind", ab->ahead, ab->behind);
         total.ahead += ab->ahead;
         total.behind += ab->behind;
+        if (inactive[i] && inactive_total) {
+            inactive_total->ahead += ab->ahead;
+            inactive_total->behind += ab->behind;
+        }
+    }
+
+    if (cache) {
+        // entries of deleted branches are dropped when all branches were enumerated
+        if (!filter.has_patterns()) {
+            std::unordered_set<std::string_view> names;
+            for (ref_snapshot::branch const& branch : branches)
+                names.insert(branch.name);
+            for (auto it = cache->branches.begin(); it != cache->branches.end(); )
+                it = names.count(it->first) ? std::next(it) : cache->branches.erase(it);
+        }
     }
 
     return total;
@@ -148,6 +391,7 @@ ahead_behind_t repository::total_ahead_behind()
 namespace {
     struct status_data {
         size_t uncommitted = 0;
+        size_t limit = std::numeric_limits<size_t>::max();
     };
 
     int status_cb(char const* path, unsigned int status_flags, void* payload)
@@ -169,24 +413,214 @@ namespace {
         if ((status_flags & uncommitted_change_mask) != 0) {
             data->uncommitted += 1;
         }
-        return 0;
+        // a non-zero return value stops the iteration
+        return data->uncommitted >= data->limit ? 1 : 0;
     }
 }
 
-size_t repository::uncommitted_changes()
+size_t repository::uncommitted_changes(status_engine engine, size_t limit, std::string const& content_cache_file)
 {
+    if (limit == 0)
+        return 0;
+    if (engine == status_engine::native) {
+        try {
+            return status_scanner(*this, content_cache_file).uncommitted_changes(limit);
+        }
+        catch (std::exception const& e) {
+            fmt::println(stderr, "native status failed, falling back to libgit2: {}", e.what());
+        }
+    }
+
     git_status_options opts = GIT_STATUS_OPTIONS_INIT;
     opts.flags =
         GIT_STATUS_OPT_INCLUDE_UNTRACKED |
         GIT_STATUS_OPT_INCLUDE_UNREADABLE |
         GIT_STATUS_OPT_NO_REFRESH;
     status_data data;
+    data.limit = limit;
     int error = git_status_foreach_ext(repo(), &opts, status_cb, &data);
     throw_on_git2_error(error);
     return data.uncommitted;
 }
 
 
+namespace {
+
+    /// index.lock, taken the same way git does
+    class index_lock {
+        std::string m_lock_path;
+        bool m_locked = false;
+
+    public:
+        explicit index_lock(std::string const& index_path)
+            : m_lock_path(index_path + ".lock")
+        {
+            int const fd = ::open(m_lock_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (fd < 0) {
+                if (errno == EEXIST)
+                    return;
+                throw std::system_error(errno, std::generic_category(), m_lock_path);
+            }
+            ::close(fd);
+            m_locked = true;
+        }
+
+        ~index_lock() noexcept
+        {
+            if (m_locked)
+                ::unlink(m_lock_path.c_str());
+        }
+
+        index_lock(index_lock const&) = delete;
+        index_lock& operator=(index_lock const&) = delete;
+
+        bool locked() const { return m_locked; }
+    };
+
+    /// removes the file (if it still exists) when it goes out of scope
+    class temporary_file {
+        std::string m_path;
+
+    public:
+        explicit temporary_file(std::string path)
+            : m_path(std::move(path))
+        {
+        }
+
+        ~temporary_file() noexcept { ::unlink(m_path.c_str()); }
+
+        temporary_file(temporary_file const&) = delete;
+        temporary_file& operator=(temporary_file const&) = delete;
+
+        std::string const& path() const { return m_path; }
+    };
+
+    /// identifies a version of the index; git replaces the file whenever it writes the index
+    struct index_version {
+        dev_t dev = 0;
+        ino_t ino = 0;
+        off_t size = 0;
+        file_time mtime;
+        /// the trailing checksum (all zeros with index.skipHash)
+        std::array<char, 20> checksum{};
+
+        bool operator==(index_version const& other) const
+        {
+            return dev == other.dev && ino == other.ino && size == other.size && mtime == other.mtime && checksum == other.checksum;
+        }
+        bool operator!=(index_version const& other) const { return !(*this == other); }
+    };
+
+    /// std::nullopt if there is no such file
+    std::optional<index_version> read_index_version(std::string const& path)
+    {
+        int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT)
+                return std::nullopt;
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        index_version result;
+        struct stat st;
+        bool ok = ::fstat(fd, &st) == 0;
+        if (ok) {
+            result.dev = st.st_dev;
+            result.ino = st.st_ino;
+            result.size = st.st_size;
+            result.mtime = file_time::mtime_of(st);
+            auto const checksum_size = static_cast<off_t>(result.checksum.size());
+            if (st.st_size >= checksum_size)
+                ok = ::pread(fd, result.checksum.data(), result.checksum.size(), st.st_size - checksum_size) == checksum_size;
+        }
+        int const saved_errno = errno;
+        ::close(fd);
+        if (!ok)
+            throw std::system_error(saved_errno, std::generic_category(), path);
+        return result;
+    }
+
+}
+
+bool repository::refresh_index()
+{
+    char const* workdir = git_repository_workdir(repo());
+    if (!workdir)
+        return false;
+    std::string const index_path = fmt::format("{}index", path());
+
+    // libgit2 writes the index after reading it without holding the lock, which could undo concurrent changes by git.
+    // so libgit2 refreshes a copy, which replaces the index only if git did not write the index meanwhile.
+    // index.lock is only held for that final check, so git commands are not blocked by the refresh.
+    std::optional<index_version> const original = read_index_version(index_path);
+    if (!original)
+        return false;
+    temporary_file const copy(fmt::format("{}.git-monitor-{}", index_path, ::getpid()));
+    std::filesystem::copy_file(index_path, copy.path(), std::filesystem::copy_options::overwrite_existing);
+    // libgit2 takes the mtime of the index file as the time the entries were recorded: entries modified at or after it are racily clean,
+    // so their content is compared, and they are smudged when the index is written (see racy-git.txt in git's documentation).
+    // with the mtime of the copy, these entries would look clean, and the replaced index would hide same-size changes from git.
+    struct timespec const times[2] = {
+        {static_cast<time_t>(original->mtime.sec), static_cast<long>(original->mtime.nsec)},
+        {static_cast<time_t>(original->mtime.sec), static_cast<long>(original->mtime.nsec)},
+    };
+    if (::utimensat(AT_FDCWD, copy.path().c_str(), times, 0) != 0)
+        throw std::system_error(errno, std::generic_category(), copy.path());
+    // git may have replaced the index between reading its version and copying it
+    std::optional<index_version> const copied = read_index_version(copy.path());
+    if (!copied || copied->checksum != original->checksum)
+        return false;
+
+    // libgit2 drops the extensions it does not know, which would disable git's untracked cache and fsmonitor.
+    // it does not support split indexes and sparse indexes ("sdir") at all; these are skipped quietly, like the extensions,
+    // since they do not change from one check to the next
+    try {
+        index_file const index = index_file::read(copy.path());
+        if (index.is_split() || index.extension("UNTR") || index.extension("FSMN"))
+            return false;
+    }
+    catch (std::exception const&) {
+        return false;
+    }
+
+    {
+        // a separate repository object, so the index of this one is not replaced
+        git_repository* refresh_repo_raw = nullptr;
+        int error = git_repository_open(&refresh_repo_raw, workdir);
+        throw_on_git2_error(error);
+        std::unique_ptr<git_repository, decltype(&git_repository_free)> refresh_repo(refresh_repo_raw, &git_repository_free);
+
+        git_index* index_raw = nullptr;
+        error = git_index_open(&index_raw, copy.path().c_str());
+        throw_on_git2_error(error);
+        std::unique_ptr<git_index, decltype(&git_index_free)> index(index_raw, &git_index_free);
+        error = git_repository_set_index(refresh_repo.get(), index.get());
+        throw_on_git2_error(error);
+
+        git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+        opts.show = GIT_STATUS_SHOW_WORKDIR_ONLY;
+        opts.flags = GIT_STATUS_OPT_UPDATE_INDEX;
+        git_status_list* status_raw = nullptr;
+        error = git_status_list_new(&status_raw, refresh_repo.get(), &opts);
+        throw_on_git2_error(error);
+        git_status_list_free(status_raw);
+    }
+
+    // libgit2 only writes the index if it updated an entry, replacing the file
+    std::optional<index_version> const refreshed = read_index_version(copy.path());
+    if (!refreshed)
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), copy.path());
+    if (refreshed->ino == copied->ino && refreshed->mtime == copied->mtime)
+        return true;
+
+    // a git command that holds the lock, or wrote the index meanwhile, has the more recent state; the next refresh catches up
+    index_lock const lock(index_path);
+    if (!lock.locked() || read_index_version(index_path) != original)
+        return false;
+    if (::rename(copy.path().c_str(), index_path.c_str()) != 0)
+        throw std::system_error(errno, std::generic_category(), index_path);
+    return true;
+}
+
 std::vector<std::string> repository::remotes()
 {
     git_strarray remotes_raw = {0};
@@ -211,7 +645,8 @@ std::optional<remote> repository::lookup_remote(char const* name)
     return {remote{remote_raw}};
 }
 
-remote_state_t repository::check_remote_state(remote::acquire_credentials_t credentials_callback)
+remote_state_t repository::check_remote_state(remote::acquire_credentials_t credentials_callback, branch_filter const& filter,
+                                              remote_state_t const* previous, std::vector<std::string> const& skip_urls)
 {
     remote_state_t result;
     std::vector<std::string>& errors = result.errors;
@@ -226,48 +661,42 @@ remote_state_t repository::check_remote_state(remote::acquire_credentials_t cred
     // they are up-to-date with the remote branch.
     // - relevant means: checked out as a local branch
     // - up-to-date means: the advertised commit id is the same as the remote-tracking branch's id
+    //
+    // The advertised commit ids are kept, and the states are derived from them by refresh_remote_state().
 
-    reference head = this->head();
+    // the upstreams that are not queried now keep their advertised commits
+    if (previous)
+        result.advertised = previous->advertised;
+
+    ref_snapshot const refs(*this);
 
     struct branch_info {
-        reference local;
-        reference upstream;
-        oid upstream_oid;
-        branch_state state = branch_state::unknown;
+        std::string_view local;
+        std::string_view upstream;
+        bool matched = false;
     };
 
-    size_t branches_without_upstream = 0;  // these count as up-to-date
     std::vector<branch_info> bis;
 
-    for (reference& local : local_branches()) {
-        fmt::println("local branch: {}", local.name());
-        if (local == head)
-            fmt::println("    is HEAD");
-        std::optional<reference> upstream = local.branch_upstream();
-        if (!upstream) {
-            branches_without_upstream += 1;
+    for (ref_snapshot::branch const& local : local_branches(refs, filter)) {
+        fmt::println(stderr, "local branch: {}", local.name);
+        if (local.upstream.empty())
             continue;
-        }
-        fmt::println("    upstream: {}", upstream->name());
-        std::optional<oid> upstream_oid = upstream->resolve().target();
-        if (!upstream_oid) {
+        fmt::println(stderr, "    upstream: {}", local.upstream);
+        if (!refs.resolve(local.upstream)) {
             // TODO: these should probably count as outdated, if a corresponding remote is configured.
             continue;
         }
-        fmt::println("    upstream oid: {}", *upstream_oid);
-        branch_info bi {
-            .local = std::move(local),
-            .upstream = std::move(*upstream),
-            .upstream_oid = *upstream_oid,
-        };
-        bis.push_back(std::move(bi));
+        bis.push_back(branch_info{local.name, local.upstream});
     }
 
     for (std::string const& remote_name : remotes()) {
         std::optional<remote> remote = lookup_remote(remote_name.c_str());
-        fmt::println("Querying remote {}...", remote->name());
         if (!remote)
             continue;
+        std::string const url = remote->url() ? std::string(normalized_url(remote->url())) : std::string();
+        if (!url.empty())
+            result.urls.push_back(url);
 
         remote->set_acquire_credentials_callback(credentials_callback);
 
@@ -275,16 +704,17 @@ remote_state_t repository::check_remote_state(remote::acquire_credentials_t cred
         std::map<remote_branch_name_t, std::vector<size_t>> remote_branch_to_info;
 
         for (size_t i = 0; i < bis.size(); ++i) {
-            branch_info const& bi = bis[i];
-            std::optional<std::string> remote_branch = remote->get_remote_branch(bi.upstream.name());
+            branch_info& bi = bis[i];
+            std::optional<std::string> remote_branch = remote->get_remote_branch(std::string(bi.upstream).c_str());
             if (!remote_branch)
                 continue;
-            if (bi.state != branch_state::unknown) {
-                fmt::println("    WARN: local branch {} matches multiple remotes", bi.local.name());
-                errors.push_back(fmt::format("warning: local branch '{}' matches multiple remotes", bi.local.name()));
+            if (bi.matched) {
+                fmt::println(stderr, "    WARN: local branch {} matches multiple remotes", bi.local);
+                errors.push_back(fmt::format("warning: local branch '{}' matches multiple remotes", bi.local));
                 continue;
             }
-            fmt::println("    remote-tracking branch {} is fetched from remote branch {}", bi.upstream.name(), *remote_branch);
+            bi.matched = true;
+            fmt::println(stderr, "    remote-tracking branch {} is fetched from remote branch {}", bi.upstream, *remote_branch);
             remote_branch_to_info[*remote_branch].push_back(i);
         }
 
@@ -292,6 +722,20 @@ remote_state_t repository::check_remote_state(remote::acquire_credentials_t cred
         if (remote_branch_to_info.empty())
             continue;
 
+        // e.g., the remote sends push notifications (see update_remote_state()), so it is only queried occasionally
+        if (!url.empty() && std::find(skip_urls.begin(), skip_urls.end(), url) != skip_urls.end()) {
+            bool const known = std::all_of(remote_branch_to_info.begin(), remote_branch_to_info.end(), [&](auto const& item) {
+                return std::all_of(item.second.begin(), item.second.end(), [&](size_t i) {
+                    return result.advertised.count(std::string(bis[i].upstream)) > 0;
+                });
+            });
+            if (known) {
+                fmt::println(stderr, "Skipping remote {}", remote_name);
+                continue;
+            }
+        }
+        fmt::println(stderr, "Querying remote {}...", remote_name);
+
         char const* error_msg = "";
         std::vector<remote_ref> remote_refs;
         try {
@@ -302,29 +746,28 @@ remote_state_t repository::check_remote_state(remote::acquire_credentials_t cred
         }
         catch (std::exception const& e) {
             errors.push_back(fmt::format("unable to {} remote '{}': {}", error_msg, remote_name, e.what()));
-            for (auto const& item : remote_branch_to_info)
-                for (size_t i : item.second)
-                    bis[i].state = branch_state::connection_error;
+            for (auto const& item : remote_branch_to_info) {
+                for (size_t i : item.second) {
+                    result.advertised.erase(std::string(bis[i].upstream));
+                    result.branch_states[std::string(bis[i].local)] = branch_state::connection_error;
+                }
+            }
             continue;
         }
 
+        // remote branches that are not advertised (anymore) are unknown
+        for (auto const& item : remote_branch_to_info) {
+            for (size_t i : item.second)
+                result.advertised.erase(std::string(bis[i].upstream));
+        }
         for (remote_ref const& rr : remote_refs) {
-            fmt::println("    remote_ref {} is at {}", rr.name, rr.id);
+            fmt::println(stderr, "    remote_ref {} is at {}", rr.name, rr.id);
 
             auto it = remote_branch_to_info.find(rr.name);
             if (it == remote_branch_to_info.end())
                 continue;
-            for (size_t i : it->second) {
-                branch_info& bi = bis[i];
-                if (bi.upstream_oid == rr.id) {
-                    fmt::println("    up-to-date");
-                    bi.state = branch_state::up_to_date;
-                }
-                else {
-                    fmt::println("    mismatch!");
-                    bi.state = branch_state::outdated;
-                }
-            }
+            for (size_t i : it->second)
+                result.advertised.insert_or_assign(std::string(bis[i].upstream), rr.id);
         }
 
         try {
@@ -335,17 +778,113 @@ remote_state_t repository::check_remote_state(remote::acquire_credentials_t cred
         }
     }
 
-    for (branch_info const& bi : bis) {
-        if (bi.local == head)
-            result.head_state = bi.state;
-        if (bi.state == branch_state::up_to_date)
-            result.branches_up_to_date += 1;
-        if (bi.state == branch_state::outdated)
-            result.branches_outdated += 1;
+    refresh_remote_state(result, filter);
+    return result;
+}
+
+void repository::refresh_remote_state(remote_state_t& state, branch_filter const& filter)
+{
+    ref_snapshot const refs(*this);
+
+    // inactive branches that were skipped by the last query keep the advertised commits of their last query
+    branch_filter all_filter = filter;
+    all_filter.skip_inactive = false;
+
+    std::map<std::string, branch_state> branch_states;
+    std::map<std::string, oid> advertised;
+    state.branches_without_upstream = 0;
+    for (ref_snapshot::branch const& local : local_branches(refs, all_filter)) {
+        if (local.upstream.empty()) {
+            state.branches_without_upstream += 1;  // these count as up-to-date
+            continue;
+        }
+        std::optional<oid> const upstream_oid = refs.resolve(local.upstream);
+        if (!upstream_oid)
+            continue;  // see check_remote_state()
+        std::string name(local.name);
+        auto const it = state.advertised.find(std::string(local.upstream));
+        branch_state s = branch_state::unknown;
+        if (it != state.advertised.end()) {
+            s = (*upstream_oid == it->second) ? branch_state::up_to_date : branch_state::outdated;
+            advertised.insert(*it);
+        }
+        else if (state.state_of(name) == branch_state::connection_error) {
+            s = branch_state::connection_error;
+        }
+        branch_states.emplace(std::move(name), s);
+    }
+    // the advertised commits of upstreams that are not used anymore are dropped
+    state.advertised = std::move(advertised);
+    state.branch_states = std::move(branch_states);
+
+    state.branches_up_to_date = state.branches_without_upstream;
+    state.branches_outdated = 0;
+    for (auto const& [name, s] : state.branch_states) {
+        if (s == branch_state::up_to_date)
+            state.branches_up_to_date += 1;
+        if (s == branch_state::outdated)
+            state.branches_outdated += 1;
+    }
+
+    state.head_state = branch_state::unknown;
+    try {
+        if (std::optional<std::string> head_branch = head_branch_name())
+            state.head_state = state.state_of(*head_branch);
+    }
+    catch (std::exception const&) {
+        // without HEAD, head_state stays unknown
     }
-    result.branches_up_to_date += branches_without_upstream;
+}
 
-    return result;
+bool repository::update_remote_state(remote_state_t& state, std::string_view url, std::string_view remote_branch, oid const& id, branch_filter const& filter)
+{
+    // same correspondence between local branches and remote branches as in check_remote_state()
+    std::vector<remote> matching_remotes;
+    for (std::string const& remote_name : remotes()) {
+        std::optional<remote> remote = lookup_remote(remote_name.c_str());
+        if (remote && remote->url() && normalized_url(remote->url()) == normalized_url(url))
+            matching_remotes.push_back(std::move(*remote));
+    }
+    if (matching_remotes.empty())
+        return false;
+
+    // inactive branches are included, since their states are derived as well
+    branch_filter all_filter = filter;
+    all_filter.skip_inactive = false;
+
+    bool updated = false;
+    ref_snapshot const refs(*this);
+    for (ref_snapshot::branch const& local : local_branches(refs, all_filter)) {
+        if (local.upstream.empty())
+            continue;
+        std::string upstream_name(local.upstream);
+        for (remote& remote : matching_remotes) {
+            std::optional<std::string> fetched_from = remote.get_remote_branch(upstream_name.c_str());
+            if (!fetched_from || *fetched_from != remote_branch)
+                continue;
+            fmt::println(stderr, "remote branch {} of {} moved to {}: upstream {} of local branch {}", remote_branch, url, id, upstream_name, local.name);
+            // a deleted remote branch is not advertised, which check_remote_state() reports as unknown
+            if (id.is_zero())
+                state.advertised.erase(upstream_name);
+            else
+                state.advertised.insert_or_assign(std::move(upstream_name), id);
+            updated = true;
+            break;
+        }
+    }
+    if (!updated)
+        return false;
+
+    refresh_remote_state(state, filter);
+    return true;
+}
+
+branch_state remote_state_t::state_of(std::string const& branch_name) const
+{
+    auto it = branch_states.find(branch_name);
+    if (it == branch_states.end())
+        return branch_state::unknown;
+    return it->second;
 }
 
 auto fmt::formatter<branch_state>::format(branch_state tp, format_context& ctx) const -> format_context::iterator
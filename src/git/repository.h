@@ -1,11 +1,18 @@
 #pragma once
 
+#include "branch_filter.h"
 #include "branch_iterator.h"
 #include "reference.h"
+#include "reference_iterator.h"
+#include "ref_snapshot.h"
+#include "reflog_tail.h"
 #include "remote.h"
+#include <limits>
+#include <map>
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <utility>
 
 struct git_repository;
@@ -33,11 +40,54 @@ namespace git {
         branch_state head_state = branch_state::unknown;
         size_t branches_up_to_date = 0;
         size_t branches_outdated = 0;
+        /// number of local branches without upstream; they are included in branches_up_to_date
+        size_t branches_without_upstream = 0;
+        /// State of each local branch with an upstream, by full reference name (e.g., "refs/heads/main").
+        /// Worktrees share their branches, so this allows each worktree to derive its own head_state.
+        std::map<std::string, branch_state> branch_states;
+        /// Commit advertised by the remote for the remote branch that each upstream is fetched from,
+        /// by full name of the upstream (e.g., "refs/remotes/origin/main"). Missing if unknown, e.g., if the remote branch was not advertised.
+        /// The branch states are derived from these, so they follow fetches without querying the remote again
+        /// (see repository::refresh_remote_state()).
+        std::map<std::string, oid> advertised;
+        /// fetch URLs of the remotes, normalized (see normalized_url())
+        std::vector<std::string> urls;
         std::vector<std::string> errors;
+
+        /// state of the given local branch (full reference name); unknown for branches without upstream
+        branch_state state_of(std::string const& branch_name) const;
+    };
+
+    /// Ahead/behind counts of the local branches from previous computations (see repository::total_ahead_behind()),
+    /// so that only the branches that moved, or whose upstream moved, are walked again.
+    struct ahead_behind_cache {
+        struct branch {
+            /// full name of the upstream
+            std::string upstream;
+            oid local_id;
+            oid upstream_id;
+            ahead_behind_t ahead_behind;
+            /// the reflog of the upstream grew since ahead_behind was computed (e.g., while the branch was skipped as inactive)
+            bool upstream_moved = false;
+        };
+        /// by full name of the local branch
+        std::map<std::string, branch, std::less<>> branches;
+        /// moves of the upstreams are taken from their reflogs, so they do not have to be resolved
+        reflog_tail reflogs;
+    };
+
+    enum class status_engine {
+        /// git_status_foreach_ext
+        libgit2,
+        /// status_scanner, falls back to libgit2 where it is not supported
+        native,
     };
 
     class repository {
 
+        friend class ref_snapshot;
+        friend class status_scanner;
+
         struct git_repository_deleter {
             void operator()(git_repository* ptr) const;
         };
@@ -72,23 +122,73 @@ namespace git {
         bool is_head_detached();
         reference head();
 
+        /// Full name of the branch HEAD points to (e.g., "refs/heads/main"), even if the branch does not exist yet.
+        /// Empty if HEAD is detached.
+        std::optional<std::string> head_branch_name();
+
         ahead_behind_t graph_ahead_behind(oid const& local, oid const& upstream);
 
+        /// Iterate over the names of references matching the glob (e.g., "refs/heads/*"); '*' also matches '/'.
+        reference_iterator references_glob(char const* glob);
+
         /// Look up branch by name (e.g., "main")
         std::optional<reference> lookup_local_branch(char const* name);
-        std::vector<reference> local_branches();
+        /// Local branches that pass the filter. The branch HEAD points to is always included and never inactive.
+        /// Branches that do not pass the patterns are not looked up.
+        /// If inactive is given, it receives for each returned branch whether it is inactive.
+        std::vector<reference> local_branches(branch_filter const& filter = {}, branch_counts* counts = nullptr, std::vector<bool>* inactive = nullptr);
+        /// Same as above, for the branches of a ref snapshot.
+        std::vector<ref_snapshot::branch> local_branches(ref_snapshot const& refs, branch_filter const& filter = {}, branch_counts* counts = nullptr,
+                                                         std::vector<bool>* inactive = nullptr);
         std::optional<ahead_behind_t> branch_ahead_behind(reference const& local);
 
+        /// Whether the branch was updated (according to its reflog) or committed to since the given Unix time.
+        bool is_branch_active(reference const& branch, int64_t since);
+        bool is_branch_active(std::string_view branch_name, oid const& target, int64_t since);
+
         std::optional<ahead_behind_t> head_ahead_behind();
-        ahead_behind_t total_ahead_behind();
+        /// Sum over the branches that pass the filter.
+        /// If inactive_total is given, it receives the part of the sum contributed by inactive branches.
+        /// If cache is given, branches are only walked if they or their upstream moved since the cache was updated,
+        /// and inactive branches that are skipped contribute their counts from the last time they were walked
+        /// (without cache, they do not contribute).
+        ahead_behind_t total_ahead_behind(branch_filter const& filter = {}, branch_counts* counts = nullptr, ahead_behind_t* inactive_total = nullptr,
+                                          ahead_behind_cache* cache = nullptr);
 
         // number of files with uncommitted changes (including untracked files).
-        size_t uncommitted_changes();
+        // counting stops at limit, e.g., a limit of 1 only determines whether there are any changes.
+        // the native engine remembers files whose content matches the index despite stale stat data in content_cache_file, if given.
+        size_t uncommitted_changes(status_engine engine = status_engine::libgit2, size_t limit = std::numeric_limits<size_t>::max(),
+                                   std::string const& content_cache_file = {});
+
+        // Refresh the stat data of index entries whose content did not change, like `git status` does,
+        // so later status checks (ours and the user's) do not have to compare their content.
+        // a copy of the index is refreshed, so concurrent git commands are not blocked; index.lock is only taken briefly
+        // to replace the index with the copy, which is skipped if git wrote the index meanwhile.
+        // returns false if the refresh was skipped because the index is locked or changed, is a split or sparse index,
+        // or uses extensions that libgit2 would drop.
+        bool refresh_index();
 
         std::vector<std::string> remotes();
         std::optional<remote> lookup_remote(char const* name);
 
-        remote_state_t check_remote_state(remote::acquire_credentials_t credentials_callback = nullptr);
+        /// Query the remotes and compare the advertised commits with the upstreams of the local branches that pass the filter.
+        /// The advertised commits of previous are kept for the upstreams that are not queried now
+        /// (e.g., of inactive branches that are skipped, see branch_filter::skip_inactive), so their states are still derived.
+        /// Remotes whose (normalized) fetch URL is in skip_urls are not queried if all their advertised commits are known from previous.
+        remote_state_t check_remote_state(remote::acquire_credentials_t credentials_callback = nullptr, branch_filter const& filter = {},
+                                          remote_state_t const* previous = nullptr, std::vector<std::string> const& skip_urls = {});
+
+        /// Derive the branch states (and counts) from the advertised commits and the current upstreams, without connecting to the remotes,
+        /// e.g., after the remote-tracking branches were fetched. Inactive branches are included, as far as their advertised commits are known.
+        /// Connection errors are kept until the remote is queried again.
+        void refresh_remote_state(remote_state_t& state, branch_filter const& filter = {});
+
+        /// Apply a notification that the branch remote_branch (e.g., "refs/heads/main") of the remote repository at url
+        /// now points to id (zero if it was deleted), without connecting to the remote.
+        /// The advertised commits of the upstreams that are fetched from that branch are updated, and the states derived again.
+        /// Returns false if there is no such branch.
+        bool update_remote_state(remote_state_t& state, std::string_view url, std::string_view remote_branch, oid const& id, branch_filter const& filter = {});
     };
 
 }
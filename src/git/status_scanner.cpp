@@ -0,0 +1,586 @@
+#include "status_scanner.h"
+#include "repository.h"
+#include "untracked_walker.h"
+#include "util.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <git2.h>
+#include <memory>
+#include <stdexcept>
+#include <strings.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+using namespace git;
+
+namespace {
+
+    /// number of index entries a worker takes at once
+    constexpr size_t k_batch_size = 512;
+    /// a thread of the pool only helps with at least this many batches per thread
+    constexpr size_t k_batches_per_thread = 4;
+
+    /// default of core.excludesFile
+    std::string default_excludes_file()
+    {
+        if (char const* xdg = std::getenv("XDG_CONFIG_HOME"); xdg && *xdg)
+            return fmt::format("{}/git/ignore", xdg);
+        if (char const* home = std::getenv("HOME"); home && *home)
+            return fmt::format("{}/.config/git/ignore", home);
+        return {};
+    }
+
+    /// whether the cache tree says the index entries of a directory are those of the tree with the given id
+    bool cache_tree_matches(cache_tree const* cache, git_oid const* tree_id, size_t entry_count)
+    {
+        return cache && cache->is_valid() && static_cast<uint64_t>(cache->entry_count) == entry_count
+            && std::memcmp(cache->oid.data(), tree_id->id, cache->oid.size()) == 0;
+    }
+
+}
+
+status_scanner::status_scanner(repository& repo, std::string content_cache_file)
+    : m_repo(repo.repo())
+    , m_content_cache_file(std::move(content_cache_file))
+{
+    char const* workdir = git_repository_workdir(m_repo);
+    if (!workdir)
+        throw std::runtime_error("status of a bare repository");
+    m_workdir = workdir;  // ends with a slash
+}
+
+void status_scanner::read_config()
+{
+    git_config* config_raw = nullptr;
+    int error = git_repository_config_snapshot(&config_raw, m_repo);
+    throw_on_git2_error(error);
+    std::unique_ptr<git_config, decltype(&git_config_free)> config(config_raw, &git_config_free);
+
+    auto const get_bool = [&config](char const* name, bool default_value) {
+        int value = 0;
+        int error = git_config_get_bool(&value, config.get(), name);
+        if (error == GIT_ENOTFOUND) {
+            git_error_clear();
+            return default_value;
+        }
+        throw_on_git2_error(error);
+        return value != 0;
+    };
+
+    m_config.filemode = get_bool("core.filemode", true);
+    m_config.trust_ctime = get_bool("core.trustctime", true);
+    if (!get_bool("core.symlinks", true))
+        throw std::runtime_error("native status does not support core.symlinks = false");
+    if (get_bool("core.ignorecase", false))
+        throw std::runtime_error("native status does not support core.ignorecase = true");
+
+    git_buf excludes_file = GIT_BUF_INIT;
+    error = git_config_get_path(&excludes_file, config.get(), "core.excludesfile");
+    if (error == GIT_ENOTFOUND) {
+        git_error_clear();
+        m_config.excludes_file = default_excludes_file();
+    }
+    else {
+        throw_on_git2_error(error);
+        m_config.excludes_file = excludes_file.ptr;
+        git_buf_dispose(&excludes_file);
+    }
+
+    // "keep" (or any other value that is not a boolean) uses an existing cache
+    git_config_entry* untracked_cache = nullptr;
+    error = git_config_get_entry(&untracked_cache, config.get(), "core.untrackedcache");
+    if (error == GIT_ENOTFOUND)
+        git_error_clear();
+    else {
+        throw_on_git2_error(error);
+        int value = 1;
+        if (git_config_parse_bool(&value, untracked_cache->value) < 0)
+            git_error_clear();
+        m_config.untracked_cache = value != 0;
+        git_config_entry_free(untracked_cache);
+    }
+
+    m_config.fsmonitor_hook.clear();
+    git_config_entry* fsmonitor = nullptr;
+    error = git_config_get_entry(&fsmonitor, config.get(), "core.fsmonitor");
+    if (error == GIT_ENOTFOUND)
+        git_error_clear();
+    else {
+        throw_on_git2_error(error);
+        int value = 0;
+        if (git_config_parse_bool(&value, fsmonitor->value) < 0) {
+            git_error_clear();
+            m_config.fsmonitor_hook = fsmonitor->value;
+        }
+        else if (value)
+            fmt::println(stderr, "native status: the builtin fsmonitor daemon is not supported, checking all files");
+        git_config_entry_free(fsmonitor);
+    }
+
+    int32_t hook_version = 0;
+    error = git_config_get_int32(&hook_version, config.get(), "core.fsmonitorhookversion");
+    if (error == GIT_ENOTFOUND)
+        git_error_clear();
+    else
+        throw_on_git2_error(error);
+    m_config.fsmonitor_hook_version = hook_version;
+
+    git_config_entry* format = nullptr;
+    error = git_config_get_entry(&format, config.get(), "extensions.objectformat");
+    if (error == GIT_ENOTFOUND) {
+        git_error_clear();
+        return;
+    }
+    throw_on_git2_error(error);
+    bool const is_sha1 = ::strcasecmp(format->value, "sha1") == 0;
+    git_config_entry_free(format);
+    if (!is_sha1)
+        throw std::runtime_error("native status only supports SHA-1 repositories");
+}
+
+size_t status_scanner::uncommitted_changes(size_t limit)
+{
+#ifndef __linux__
+    // statx and getdents64 are Linux-only; repository::uncommitted_changes() falls back to libgit2
+    throw std::runtime_error("native status is only supported on Linux");
+#endif
+    read_config();
+
+    std::string const index_path = fmt::format("{}index", git_repository_path(m_repo));
+    index_file const index = index_file::read(index_path);
+    std::vector<index_entry> const& entries = index.entries();
+
+    for (index_entry const& entry : entries) {
+        // libgit2 gives these flags its own meaning, which we do not replicate
+        if (entry.is_intent_to_add() || entry.is_skip_worktree() || entry.is_assume_valid())
+            throw std::runtime_error(fmt::format("native status does not support the flags of index entry '{}'", entry.path));
+    }
+
+    m_scan_start = std::time(nullptr);
+    m_content_cache.reset();
+    if (!m_content_cache_file.empty())
+        m_content_cache = content_cache::load(m_content_cache_file);
+    auto const save_content_cache = [this](bool complete) {
+        if (m_content_cache)
+            m_content_cache->save(!complete);
+    };
+
+    m_changed.clear();
+    add_staged_changes(index);
+    if (m_changed.size() >= limit)
+        return limit;
+
+    std::vector<bool> unchanged;
+    std::optional<fsmonitor_changes> const fsmonitor = query_fsmonitor(index, unchanged);
+    std::vector<entry_state> const states = stat_entries(entries, unchanged, index.mtime());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        index_entry const& entry = entries[i];
+        if (entry.stage() != 0) {
+            // conflicted
+            m_changed.insert(entry.path);
+            if (m_changed.size() >= limit) {
+                save_content_cache(false);
+                return limit;
+            }
+            continue;
+        }
+        bool changed = false;
+        switch (states[i]) {
+            case entry_state::clean:
+                break;
+            case entry_state::changed:
+                changed = true;
+                break;
+            case entry_state::check_content:
+                changed = content_differs(entry);
+                break;
+            case entry_state::submodule:
+                changed = submodule_modified(entry);
+                break;
+        }
+        if (changed) {
+            m_changed.insert(entry.path);
+            if (m_changed.size() >= limit) {
+                save_content_cache(false);
+                return limit;
+            }
+        }
+    }
+    save_content_cache(true);
+
+    std::string const info_exclude = fmt::format("{}info/exclude", git_repository_commondir(m_repo));
+    std::optional<untracked_cache> const cache = load_untracked_cache(index, info_exclude);
+    std::vector<ignore_list> global_ignores;
+    global_ignores.push_back(ignore_list::read(info_exclude));
+    global_ignores.push_back(ignore_list::read(m_config.excludes_file));
+    untracked_walker walker(m_workdir, entries, std::move(global_ignores));
+    if (cache)
+        walker.use_untracked_cache(*cache, fsmonitor ? &*fsmonitor : nullptr, index.mtime(), m_config.trust_ctime);
+    for (std::string& path : walker.find(limit - m_changed.size(), &m_changed))
+        m_changed.insert(std::move(path));
+    return std::min(m_changed.size(), limit);
+}
+
+std::optional<fsmonitor_changes> status_scanner::query_fsmonitor(index_file const& index, std::vector<bool>& unchanged) const
+{
+    unchanged.clear();
+    if (m_config.fsmonitor_hook.empty())
+        return std::nullopt;
+    // without the extension, git has not queried the hook for this index yet
+    std::optional<std::string_view> const data = index.extension("FSMN");
+    if (!data)
+        return std::nullopt;
+
+    try {
+        fsmonitor_extension const extension = fsmonitor_extension::parse(*data);
+        std::optional<fsmonitor_changes> changes = fsmonitor_changes::query(m_config.fsmonitor_hook, m_config.fsmonitor_hook_version, extension.last_update, m_workdir);
+        if (!changes)
+            return std::nullopt;
+
+        // like git, entries that were neither dirty when the index was written nor reported since are not checked
+        std::vector<index_entry> const& entries = index.entries();
+        std::vector<bool> result(entries.size(), true);
+        for (size_t pos : extension.dirty) {
+            if (pos >= entries.size())
+                throw std::runtime_error("fsmonitor bitmap out of range");
+            result[pos] = false;
+        }
+        for (size_t i = 0; i < entries.size(); ++i)
+            if (result[i] && changes->is_path_changed(entries[i].path))
+                result[i] = false;
+        unchanged = std::move(result);
+        return changes;
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "native status: not using fsmonitor: {}", e.what());
+        return std::nullopt;
+    }
+}
+
+std::optional<untracked_cache> status_scanner::load_untracked_cache(index_file const& index, std::string const& info_exclude) const
+{
+    if (!m_config.untracked_cache)
+        return std::nullopt;
+    std::optional<std::string_view> const data = index.extension("UNTR");
+    if (!data)
+        return std::nullopt;
+
+    try {
+        untracked_cache cache = untracked_cache::parse(*data);
+        cache.validate(m_workdir, info_exclude, m_config.excludes_file, index.mtime(), m_config.trust_ctime);
+        return cache;
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "native status: not using the untracked cache: {}", e.what());
+        return std::nullopt;
+    }
+}
+
+std::vector<status_scanner::entry_state> status_scanner::stat_entries(std::vector<index_entry> const& entries, std::vector<bool> const& unchanged, file_time index_mtime) const
+{
+    std::vector<entry_state> states(entries.size(), entry_state::clean);
+
+    int const workdir_fd = ::open(m_workdir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (workdir_fd < 0)
+        throw std::system_error(errno, std::generic_category(), m_workdir);
+
+    std::atomic<size_t> next_batch = 0;
+    auto const worker = [&]() {
+        while (true) {
+            size_t const begin = next_batch.fetch_add(k_batch_size, std::memory_order_relaxed);
+            if (begin >= entries.size())
+                return;
+            size_t const end = std::min(entries.size(), begin + k_batch_size);
+            for (size_t i = begin; i < end; ++i) {
+                if (entries[i].stage() != 0)
+                    continue;
+                // fsmonitor does not watch the content of submodules
+                if (!unchanged.empty() && unchanged[i] && !entries[i].is_gitlink())
+                    continue;
+                states[i] = classify(workdir_fd, entries[i], index_mtime);
+            }
+        }
+    };
+
+    // small indexes are checked by the calling thread alone
+    size_t const batches = (entries.size() + k_batch_size - 1) / k_batch_size;
+    worker_pool::shared().run(batches / k_batches_per_thread, [&](size_t) { worker(); });
+
+    ::close(workdir_fd);
+    return states;
+}
+
+status_scanner::entry_state status_scanner::classify(int workdir_fd, index_entry const& entry, file_time index_mtime) const
+{
+    // the same checks as libgit2's maybe_modified() in diff_generate.c
+    if (entry.is_gitlink())
+        return entry_state::submodule;
+
+#ifdef __linux__
+    struct statx st;
+    if (::statx(workdir_fd, entry.path.c_str(), AT_SYMLINK_NOFOLLOW, STATX_BASIC_STATS, &st) != 0) {
+        // deleted (ENOENT, ENOTDIR) or unreadable, both are changes
+        return entry_state::changed;
+    }
+
+    uint32_t const type = st.stx_mode & S_IFMT;
+    if (type != (entry.mode & S_IFMT))
+        return entry_state::changed;
+    if (m_config.filemode && type == S_IFREG && ((st.stx_mode & S_IXUSR) != 0) != ((entry.mode & S_IXUSR) != 0))
+        return entry_state::changed;
+
+    // the index stores the lower 32 bits of sizes and times
+    if (static_cast<uint32_t>(st.stx_size) != entry.size) {
+        // racily clean entries are written with size 0 by git ("smudged"), so these must be compared by content
+        return entry.size == 0 ? entry_state::check_content : entry_state::changed;
+    }
+
+    file_time const mtime{static_cast<uint32_t>(st.stx_mtime.tv_sec), st.stx_mtime.tv_nsec};
+    file_time const ctime{static_cast<uint32_t>(st.stx_ctime.tv_sec), st.stx_ctime.tv_nsec};
+    bool const stat_matches = mtime == entry.mtime
+        && (!m_config.trust_ctime || ctime == entry.ctime)
+        && static_cast<uint32_t>(st.stx_ino) == entry.ino
+        && st.stx_uid == entry.uid
+        && st.stx_gid == entry.gid;
+    // racily clean: the file may have been modified in the same instant the index was written
+    if (!stat_matches || entry.mtime >= index_mtime)
+        return entry_state::check_content;
+    return entry_state::clean;
+#else
+    (void)workdir_fd;
+    (void)index_mtime;
+    throw std::runtime_error("statx is only supported on Linux");
+#endif
+}
+
+bool status_scanner::content_differs(index_entry const& entry)
+{
+    std::string const path = m_workdir + entry.path;
+    git_oid id;
+    if (entry.is_symlink()) {
+        std::vector<char> target(entry.size + 1);
+        ssize_t const length = ::readlink(path.c_str(), target.data(), target.size());
+        if (length < 0 || static_cast<size_t>(length) >= target.size())
+            return true;
+        int error = git_odb_hash(&id, target.data(), length, GIT_OBJECT_BLOB);
+        throw_on_git2_error(error);
+        return std::memcmp(id.id, entry.oid.data(), entry.oid.size()) != 0;
+    }
+
+    struct stat before;
+    bool const cacheable = m_content_cache && ::lstat(path.c_str(), &before) == 0 && S_ISREG(before.st_mode);
+    content_cache::stat_key const key = cacheable ? content_cache::stat_key::from(before) : content_cache::stat_key{};
+    if (cacheable && m_content_cache->matches(entry.path, key, entry.oid))
+        return false;
+
+    // applies the same filters (e.g., line endings) as libgit2's status
+    int error = git_repository_hashfile(&id, m_repo, path.c_str(), GIT_OBJECT_BLOB, entry.path.c_str());
+    if (error < 0) {
+        // unreadable
+        git_error_clear();
+        return true;
+    }
+    bool const differs = std::memcmp(id.id, entry.oid.data(), entry.oid.size()) != 0;
+
+    // like racily clean index entries, a file modified in the second of the scan could change again
+    // without a different mtime; files that changed while being hashed are not remembered either
+    struct stat after;
+    if (cacheable && !differs && key.mtime.sec < m_scan_start
+        && ::lstat(path.c_str(), &after) == 0 && content_cache::stat_key::from(after) == key)
+        m_content_cache->insert(entry.path, key, entry.oid);
+    return differs;
+}
+
+bool status_scanner::submodule_modified(index_entry const& entry)
+{
+    unsigned int status = 0;
+    int error = git_submodule_status(&status, m_repo, entry.path.c_str(), GIT_SUBMODULE_IGNORE_UNSPECIFIED);
+    if (error == GIT_EEXISTS) {
+        // a directory containing a repository, but not a submodule; libgit2 ignores it as well
+        git_error_clear();
+        return false;
+    }
+    throw_on_git2_error(error);
+    return !GIT_SUBMODULE_STATUS_IS_WD_UNMODIFIED(status);
+}
+
+void status_scanner::add_staged_changes(index_file const& index)
+{
+    git_object* tree_raw = nullptr;
+    int error = git_revparse_single(&tree_raw, m_repo, "HEAD^{tree}");
+    if (error == GIT_ENOTFOUND || error == GIT_EUNBORNBRANCH)
+        git_error_clear();  // no commit yet, everything in the index is staged
+    else
+        throw_on_git2_error(error);
+    std::unique_ptr<git_object, decltype(&git_object_free)> tree(tree_raw, &git_object_free);
+
+    std::optional<cache_tree> cache;
+    if (std::optional<std::string_view> const data = index.extension("TREE")) {
+        try {
+            cache = cache_tree::parse(*data);
+        }
+        catch (std::exception const& e) {
+            fmt::println(stderr, "native status: not using the cache tree: {}", e.what());
+        }
+    }
+
+    size_t const known_changes = m_changed.size();
+    try {
+        std::vector<index_entry> const& entries = index.entries();
+        diff_tree_to_index(reinterpret_cast<git_tree const*>(tree.get()), std::string(), entries, 0, entries.size(), cache ? &*cache : nullptr);
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "native status: comparing HEAD with the index failed, falling back to libgit2: {}", e.what());
+        if (m_changed.size() != known_changes)
+            m_changed.clear();
+        add_staged_changes_libgit2();
+    }
+}
+
+void status_scanner::diff_tree_to_index(git_tree const* tree, std::string const& prefix, std::vector<index_entry> const& entries,
+                                        size_t begin, size_t end, cache_tree const* cache)
+{
+    // the tree of the directory has not changed since HEAD; this is the common case for the whole index
+    if (tree && cache_tree_matches(cache, git_tree_id(tree), end - begin))
+        return;
+
+    // both are sorted the same way: the index by path, the tree by name with a slash appended to subdirectories
+    size_t const tree_entries = tree ? git_tree_entrycount(tree) : 0;
+    size_t i = begin;
+    size_t j = 0;
+    size_t next_subtree = 0;
+    while (i < end || j < tree_entries) {
+        // the next name in the index, and the range of entries it covers
+        std::string_view index_key;
+        size_t group_end = i;
+        if (i < end) {
+            std::string_view const rest = std::string_view(entries[i].path).substr(prefix.size());
+            size_t const slash = rest.find('/');
+            index_key = rest.substr(0, slash == std::string_view::npos ? rest.size() : slash + 1);
+            group_end = i + 1;
+            while (group_end < end && std::string_view(entries[group_end].path).substr(prefix.size()).substr(0, index_key.size()) == index_key
+                   && (index_key.back() == '/' || entries[group_end].path.size() == prefix.size() + index_key.size()))
+                group_end += 1;
+        }
+
+        git_tree_entry const* tree_entry = (j < tree_entries) ? git_tree_entry_byindex(tree, j) : nullptr;
+        std::string tree_key;
+        if (tree_entry) {
+            tree_key = git_tree_entry_name(tree_entry);
+            if (git_tree_entry_type(tree_entry) == GIT_OBJECT_TREE)
+                tree_key += '/';
+        }
+
+        int const order = (i >= end) ? 1 : !tree_entry ? -1 : index_key.compare(tree_key);
+        if (order < 0) {
+            // added to the index
+            for (size_t k = i; k < group_end; ++k)
+                m_changed.insert(entries[k].path);
+            i = group_end;
+            continue;
+        }
+        if (order > 0) {
+            // removed from the index
+            std::string path = prefix + tree_key;
+            if (tree_key.back() == '/') {
+                git_tree* subtree = nullptr;
+                int const error = git_tree_lookup(&subtree, m_repo, git_tree_entry_id(tree_entry));
+                throw_on_git2_error(error);
+                std::unique_ptr<git_tree, decltype(&git_tree_free)> const subtree_guard(subtree, &git_tree_free);
+                add_tree_paths(subtree, path);
+            }
+            else
+                m_changed.insert(std::move(path));
+            j += 1;
+            continue;
+        }
+
+        if (index_key.back() == '/') {
+            // the cache tree lists the subdirectories in the same order
+            cache_tree const* child = nullptr;
+            if (cache) {
+                std::string_view const name = index_key.substr(0, index_key.size() - 1);
+                while (next_subtree < cache->subtrees.size() && cache->subtrees[next_subtree].name < name)
+                    next_subtree += 1;
+                if (next_subtree < cache->subtrees.size() && cache->subtrees[next_subtree].name == name)
+                    child = &cache->subtrees[next_subtree];
+            }
+            // checked before looking up the tree, which reads it from the object database
+            if (cache_tree_matches(child, git_tree_entry_id(tree_entry), group_end - i)) {
+                i = group_end;
+                j += 1;
+                continue;
+            }
+            git_tree* subtree = nullptr;
+            int const error = git_tree_lookup(&subtree, m_repo, git_tree_entry_id(tree_entry));
+            throw_on_git2_error(error);
+            std::unique_ptr<git_tree, decltype(&git_tree_free)> const subtree_guard(subtree, &git_tree_free);
+            diff_tree_to_index(subtree, prefix + tree_key, entries, i, group_end, child);
+        }
+        else {
+            // unmerged entries are reported as conflicts, like libgit2 does
+            index_entry const& entry = entries[i];
+            bool const changed = group_end - i > 1 || entry.stage() != 0
+                || entry.mode != static_cast<uint32_t>(git_tree_entry_filemode(tree_entry))
+                || std::memcmp(entry.oid.data(), git_tree_entry_id(tree_entry)->id, entry.oid.size()) != 0;
+            if (changed)
+                m_changed.insert(entry.path);
+        }
+        i = group_end;
+        j += 1;
+    }
+}
+
+void status_scanner::add_tree_paths(git_tree const* tree, std::string const& prefix)
+{
+    size_t const count = git_tree_entrycount(tree);
+    for (size_t j = 0; j < count; ++j) {
+        git_tree_entry const* entry = git_tree_entry_byindex(tree, j);
+        std::string path = prefix + git_tree_entry_name(entry);
+        if (git_tree_entry_type(entry) != GIT_OBJECT_TREE) {
+            m_changed.insert(std::move(path));
+            continue;
+        }
+        git_tree* subtree = nullptr;
+        int const error = git_tree_lookup(&subtree, m_repo, git_tree_entry_id(entry));
+        throw_on_git2_error(error);
+        std::unique_ptr<git_tree, decltype(&git_tree_free)> const subtree_guard(subtree, &git_tree_free);
+        add_tree_paths(subtree, path + '/');
+    }
+}
+
+void status_scanner::add_staged_changes_libgit2()
+{
+    git_object* tree_raw = nullptr;
+    int error = git_revparse_single(&tree_raw, m_repo, "HEAD^{tree}");
+    if (error == GIT_ENOTFOUND || error == GIT_EUNBORNBRANCH)
+        git_error_clear();  // no commit yet, everything in the index is staged
+    else
+        throw_on_git2_error(error);
+    std::unique_ptr<git_object, decltype(&git_object_free)> tree(tree_raw, &git_object_free);
+
+    git_index* index_raw = nullptr;
+    error = git_repository_index(&index_raw, m_repo);
+    throw_on_git2_error(error);
+    std::unique_ptr<git_index, decltype(&git_index_free)> index(index_raw, &git_index_free);
+    error = git_index_read(index.get(), false);
+    throw_on_git2_error(error);
+
+    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    git_diff* diff_raw = nullptr;
+    error = git_diff_tree_to_index(&diff_raw, m_repo, reinterpret_cast<git_tree*>(tree.get()), index.get(), &opts);
+    throw_on_git2_error(error);
+    std::unique_ptr<git_diff, decltype(&git_diff_free)> diff(diff_raw, &git_diff_free);
+
+    size_t const deltas = git_diff_num_deltas(diff.get());
+    for (size_t i = 0; i < deltas; ++i)
+        m_changed.insert(git_diff_get_delta(diff.get(), i)->new_file.path);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "cache_tree.h"
+#include "content_cache.h"
+#include "fsmonitor.h"
+#include "index_file.h"
+#include "untracked_cache.h"
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+struct git_repository;
+struct git_tree;
+
+namespace git {
+
+    class repository;
+
+    /// Counts uncommitted changes with the same result as repository::uncommitted_changes(status_engine::libgit2),
+    /// but compares the index with the working directory natively:
+    /// the index is memory-mapped and the entries are checked with parallel statx calls.
+    /// Only entries whose stat data does not match, or that are racily clean, are compared by content (using libgit2).
+    /// Staged changes are found by comparing HEAD's tree with the same entries; directories that git's cache tree
+    /// records as unchanged since HEAD are skipped.
+    /// If git maintains an untracked cache or a core.fsmonitor hook for the repository, they are used like git does,
+    /// so only directories and files that changed since git last wrote the index have to be looked at.
+    /// Files found to match the index despite stale stat data are remembered in a content_cache.
+    /// Throws on configurations that are not supported (e.g., SHA-256 repositories or intent-to-add entries),
+    /// so the caller can fall back to libgit2. The scanner uses statx and getdents64, so it always throws on platforms other than Linux.
+    class status_scanner {
+    public:
+        /// @param content_cache_file where to keep the content_cache; empty to hash files on every scan
+        explicit status_scanner(repository& repo, std::string content_cache_file = {});
+
+        /// Counting stops at limit; with a limit of 1, the scan ends at the first change that is found.
+        size_t uncommitted_changes(size_t limit = std::numeric_limits<size_t>::max());
+
+    private:
+        enum class entry_state : unsigned char {
+            clean,
+            changed,
+            check_content,
+            submodule,
+        };
+
+        struct config_t {
+            bool filemode = true;
+            bool trust_ctime = true;
+            std::string excludes_file;
+            bool untracked_cache = true;
+            /// empty if there is no hook (or only git's builtin daemon, which we cannot query)
+            std::string fsmonitor_hook;
+            /// 0 if not configured
+            int fsmonitor_hook_version = 0;
+        };
+
+        void read_config();
+        std::optional<fsmonitor_changes> query_fsmonitor(index_file const& index, std::vector<bool>& unchanged) const;
+        std::optional<untracked_cache> load_untracked_cache(index_file const& index, std::string const& info_exclude) const;
+        /// @param unchanged entries that are known to be unchanged, or empty
+        std::vector<entry_state> stat_entries(std::vector<index_entry> const& entries, std::vector<bool> const& unchanged, file_time index_mtime) const;
+        entry_state classify(int workdir_fd, index_entry const& entry, file_time index_mtime) const;
+        bool content_differs(index_entry const& entry);
+        bool submodule_modified(index_entry const& entry);
+        /// Compare HEAD's tree with the index entries that were already read, skipping the directories
+        /// whose cache tree (the TREE extension) is valid and matches HEAD. Falls back to libgit2's diff if that fails.
+        void add_staged_changes(index_file const& index);
+        void add_staged_changes_libgit2();
+        /// @param tree the tree of the directory in HEAD, or nullptr if the directory does not exist there
+        /// @param prefix the directory, empty or ending with a slash
+        /// @param begin, end the range of the index entries below the directory
+        /// @param cache the cache tree of the directory, if known
+        void diff_tree_to_index(git_tree const* tree, std::string const& prefix, std::vector<index_entry> const& entries,
+                                size_t begin, size_t end, cache_tree const* cache);
+        /// add the paths of all files below the tree
+        void add_tree_paths(git_tree const* tree, std::string const& prefix);
+
+    private:
+        git_repository* m_repo;
+        std::string m_workdir;
+        config_t m_config;
+        std::string m_content_cache_file;
+        std::optional<content_cache> m_content_cache;
+        /// when the scan started; files modified in the same second are not added to the content cache
+        int64_t m_scan_start = 0;
+        /// paths with uncommitted changes; untracked directories end with a slash
+        std::unordered_set<std::string> m_changed;
+    };
+
+}
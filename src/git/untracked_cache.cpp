@@ -0,0 +1,215 @@
+#include "untracked_cache.h"
+#include "index_reader.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+using namespace git;
+
+namespace {
+
+    /// DIR_SHOW_OTHER_DIRECTORIES | DIR_HIDE_EMPTY_DIRECTORIES of git's dir.h, the flags of "git status" with
+    /// the default status.showUntrackedFiles = normal. This is also how libgit2 reports untracked directories.
+    constexpr uint32_t k_dir_flags = 2 | 4;
+
+    stat_data read_stat_data(index_reader& r)
+    {
+        stat_data sd;
+        sd.ctime.sec = r.be32();
+        sd.ctime.nsec = r.be32();
+        sd.mtime.sec = r.be32();
+        sd.mtime.nsec = r.be32();
+        sd.dev = r.be32();
+        sd.ino = r.be32();
+        sd.uid = r.be32();
+        sd.gid = r.be32();
+        sd.size = r.be32();
+        return sd;
+    }
+
+    /// a null object id means the file does not exist
+    std::optional<untracked_cache::object_id> read_oid(index_reader& r)
+    {
+        std::string_view const bytes = r.bytes(std::tuple_size_v<untracked_cache::object_id>);
+        if (std::all_of(bytes.begin(), bytes.end(), [](char c) { return c == 0; }))
+            return std::nullopt;
+        untracked_cache::object_id oid;
+        std::copy(bytes.begin(), bytes.end(), oid.begin());
+        return oid;
+    }
+
+    /// directory blocks are stored in depth-first order; the bitmaps that follow refer to this order
+    void read_directory(index_reader& r, untracked_cache::directory& dir, std::vector<untracked_cache::directory*>& order)
+    {
+        uint64_t const untracked_count = r.varint();
+        uint64_t const dir_count = r.varint();
+        // each name takes at least one byte
+        if (untracked_count > r.remaining() || dir_count > r.remaining())
+            throw_malformed_index("untracked cache entry count exceeds data");
+        dir.name = r.c_str();
+        dir.untracked.reserve(untracked_count);
+        for (uint64_t i = 0; i < untracked_count; ++i)
+            dir.untracked.emplace_back(r.c_str());
+        order.push_back(&dir);
+        // sized before recursing so the pointers in order stay valid
+        dir.dirs.resize(dir_count);
+        for (untracked_cache::directory& child : dir.dirs)
+            read_directory(r, child, order);
+    }
+
+    void sort_directories(untracked_cache::directory& dir)
+    {
+        std::sort(dir.dirs.begin(), dir.dirs.end(), [](auto const& a, auto const& b) { return a.name < b.name; });
+        for (untracked_cache::directory& child : dir.dirs)
+            sort_directories(child);
+    }
+
+}
+
+stat_data stat_data::from(struct stat const& st)
+{
+    // truncated to 32 bits like in the index
+    stat_data sd;
+    file_time const ctime = file_time::ctime_of(st);
+    file_time const mtime = file_time::mtime_of(st);
+    sd.ctime = file_time{static_cast<uint32_t>(ctime.sec), ctime.nsec};
+    sd.mtime = file_time{static_cast<uint32_t>(mtime.sec), mtime.nsec};
+    sd.dev = static_cast<uint32_t>(st.st_dev);
+    sd.ino = static_cast<uint32_t>(st.st_ino);
+    sd.uid = st.st_uid;
+    sd.gid = st.st_gid;
+    sd.size = static_cast<uint32_t>(st.st_size);
+    return sd;
+}
+
+stat_data stat_data::from(index_entry const& entry)
+{
+    stat_data sd;
+    sd.ctime = entry.ctime;
+    sd.mtime = entry.mtime;
+    sd.dev = entry.dev;
+    sd.ino = entry.ino;
+    sd.uid = entry.uid;
+    sd.gid = entry.gid;
+    sd.size = entry.size;
+    return sd;
+}
+
+bool stat_data::matches(stat_data const& current, file_time index_mtime, bool trust_ctime) const
+{
+    if (mtime.sec >= index_mtime.sec)
+        return false;
+    return mtime == current.mtime
+        && (!trust_ctime || ctime == current.ctime)
+        && ino == current.ino
+        && uid == current.uid
+        && gid == current.gid
+        && size == current.size;
+}
+
+untracked_cache::directory const* untracked_cache::directory::find(std::string_view child) const
+{
+    auto it = std::lower_bound(dirs.begin(), dirs.end(), child, [](directory const& d, std::string_view name) { return d.name < name; });
+    if (it == dirs.end() || it->name != child)
+        return nullptr;
+    return &*it;
+}
+
+untracked_cache untracked_cache::parse(std::string_view data)
+{
+    // see read_untracked_extension() in git's dir.c
+    if (data.empty() || data.back() != '\0')
+        throw_malformed_index("untracked cache is not terminated");
+    index_reader r(data.substr(0, data.size() - 1));
+
+    untracked_cache cache;
+    uint64_t const ident_size = r.varint();
+    if (ident_size > r.remaining())
+        throw_malformed_index("untracked cache ident exceeds data");
+    index_reader idents(r.bytes(ident_size));
+    while (idents.remaining() > 0)
+        cache.m_idents.emplace_back(idents.c_str());
+
+    cache.m_info_exclude.stat = read_stat_data(r);
+    cache.m_excludes_file.stat = read_stat_data(r);
+    cache.m_dir_flags = r.be32();
+    cache.m_info_exclude.oid = read_oid(r);
+    cache.m_excludes_file.oid = read_oid(r);
+    cache.m_exclude_per_dir = r.c_str();
+    if (r.remaining() == 0)
+        return cache;  // no directories yet
+
+    uint64_t const dir_count = r.varint();
+    if (dir_count == 0)
+        return cache;
+    std::vector<directory*> order;
+    read_directory(r, cache.m_root, order);
+    if (order.size() != dir_count)
+        throw_malformed_index("untracked cache directory count mismatch");
+
+    std::vector<size_t> const valid = read_ewah_bitmap(r);
+    std::vector<size_t> const check_only = read_ewah_bitmap(r);
+    std::vector<size_t> const oid_valid = read_ewah_bitmap(r);
+    auto const at = [&order](size_t pos) -> directory& {
+        if (pos >= order.size())
+            throw_malformed_index("untracked cache bitmap out of range");
+        return *order[pos];
+    };
+    for (size_t pos : check_only)
+        at(pos).check_only = true;
+    for (size_t pos : valid) {
+        directory& dir = at(pos);
+        dir.valid = true;
+        dir.stat = read_stat_data(r);
+    }
+    for (size_t pos : oid_valid)
+        at(pos).exclude_oid = read_oid(r);
+    if (r.remaining() != 0)
+        throw_malformed_index("trailing data in untracked cache");
+
+    sort_directories(cache.m_root);
+    return cache;
+}
+
+void untracked_cache::validate(std::string const& workdir, std::string const& info_exclude, std::string const& excludes_file,
+                               file_time index_mtime, bool trust_ctime) const
+{
+    // git identifies the environment by "Location <worktree>, system <kernel name>", see get_ident_string() in dir.c
+    struct utsname uts;
+    if (::uname(&uts) != 0)
+        throw std::runtime_error("uname failed");
+    std::string location = workdir;
+    if (location.size() > 1 && location.back() == '/')
+        location.pop_back();
+    std::vector<std::string> idents{fmt::format("Location {}, system {}", location, uts.sysname)};
+    if (std::unique_ptr<char, decltype(&std::free)> real(::realpath(location.c_str(), nullptr), &std::free); real && location != real.get())
+        idents.push_back(fmt::format("Location {}, system {}", real.get(), uts.sysname));
+    if (std::none_of(idents.begin(), idents.end(), [this](std::string const& ident) {
+            return std::find(m_idents.begin(), m_idents.end(), ident) != m_idents.end();
+        }))
+        throw std::runtime_error("untracked cache was written for another location or system");
+
+    if (m_dir_flags != k_dir_flags)
+        throw std::runtime_error(fmt::format("untracked cache was written with flags {:#x}", m_dir_flags));
+    if (m_exclude_per_dir != ".gitignore")
+        throw std::runtime_error(fmt::format("untracked cache uses per-directory ignore file '{}'", m_exclude_per_dir));
+    validate_ignore_file(m_info_exclude, info_exclude, index_mtime, trust_ctime);
+    validate_ignore_file(m_excludes_file, excludes_file, index_mtime, trust_ctime);
+}
+
+void untracked_cache::validate_ignore_file(ignore_file const& cached, std::string const& path, file_time index_mtime, bool trust_ctime)
+{
+    // git hashes the file again if its stat data changed; we only trust files that did not change at all
+    struct stat st;
+    if (path.empty() || ::stat(path.c_str(), &st) != 0) {
+        if (cached.oid)
+            throw std::runtime_error(fmt::format("'{}' was removed since the untracked cache was written", path));
+        return;
+    }
+    if (!cached.oid || !cached.stat.matches(stat_data::from(st), index_mtime, trust_ctime))
+        throw std::runtime_error(fmt::format("'{}' may have changed since the untracked cache was written", path));
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "index_file.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct stat;
+
+namespace git {
+
+    /// Stat data as git stores it for directories and ignore files in the untracked cache
+    /// (the fields of an index entry from ctime to size, without the mode).
+    struct stat_data {
+        file_time ctime;
+        file_time mtime;
+        uint32_t dev = 0;
+        uint32_t ino = 0;
+        uint32_t uid = 0;
+        uint32_t gid = 0;
+        uint32_t size = 0;
+
+        static stat_data from(struct stat const& st);
+        static stat_data from(index_entry const& entry);
+
+        /// like git's match_stat_data_racy(): data recorded in the same second the index was written is never trusted
+        bool matches(stat_data const& current, file_time index_mtime, bool trust_ctime) const;
+    };
+
+    /// The untracked cache extension of the index ("UNTR", see core.untrackedCache in git-config(1)).
+    /// For each directory it records the untracked files and directories that were found
+    /// together with the stat data of the directory and the object id of its .gitignore,
+    /// so directories that did not change do not have to be read again.
+    class untracked_cache {
+    public:
+        using object_id = std::array<unsigned char, 20>;
+
+        struct directory {
+            /// the last path component, empty for the working directory
+            std::string name;
+            /// untracked entries that are not ignored; directories end with a slash
+            std::vector<std::string> untracked;
+            /// subdirectories that git looked at, sorted by name
+            std::vector<directory> dirs;
+            /// the entries are valid for the directory with the given stat data
+            bool valid = false;
+            /// only recorded whether the directory contains untracked files (for untracked directories)
+            bool check_only = false;
+            stat_data stat;
+            /// object id of the .gitignore in this directory, if there is one
+            std::optional<object_id> exclude_oid;
+
+            directory const* find(std::string_view child) const;
+        };
+
+        /// Throws if the data is malformed.
+        static untracked_cache parse(std::string_view data);
+
+        /// Throws if the cache cannot be used for a status of the working directory with the default
+        /// untracked files mode: if it was written for another location or system, with other flags,
+        /// or if info/exclude or core.excludesFile may have changed since.
+        void validate(std::string const& workdir, std::string const& info_exclude, std::string const& excludes_file,
+                      file_time index_mtime, bool trust_ctime) const;
+
+        directory const& root() const { return m_root; }
+
+    private:
+        struct ignore_file {
+            stat_data stat;
+            std::optional<object_id> oid;
+        };
+
+        static void validate_ignore_file(ignore_file const& cached, std::string const& path, file_time index_mtime, bool trust_ctime);
+
+    private:
+        std::vector<std::string> m_idents;
+        ignore_file m_info_exclude;
+        ignore_file m_excludes_file;
+        uint32_t m_dir_flags = 0;
+        std::string m_exclude_per_dir;
+        directory m_root;
+    };
+
+}
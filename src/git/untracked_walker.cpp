@@ -0,0 +1,357 @@
+#include "untracked_walker.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+using namespace git;
+
+namespace {
+
+    /// a thread of the pool only helps with at least this many tracked directories per thread
+    constexpr size_t k_dirs_per_thread = 256;
+    /// same with an untracked cache, where only changed directories are read
+    constexpr size_t k_cached_dirs_per_thread = 4096;
+
+    /// buffer for getdents64; large enough for most directories to be read in one call
+    constexpr size_t k_dirents_buffer_size = 32 * 1024;
+
+    // layout of struct linux_dirent64
+    constexpr size_t k_dirent_reclen_offset = 16;
+    constexpr size_t k_dirent_type_offset = 18;
+    constexpr size_t k_dirent_name_offset = 19;
+
+    std::string read_file_at(int dir_fd, char const* name)
+    {
+        std::string content;
+        int const fd = ::openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return content;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = ::read(fd, buffer, sizeof(buffer))) > 0)
+            content.append(buffer, n);
+        ::close(fd);
+        return content;
+    }
+
+}
+
+untracked_walker::untracked_walker(std::string workdir, std::vector<index_entry> const& entries, std::vector<ignore_list> global_ignores)
+    : m_workdir(std::move(workdir))
+    , m_global_ignores(std::move(global_ignores))
+{
+    m_workdir_fd = ::open(m_workdir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m_workdir_fd < 0)
+        throw std::system_error(errno, std::generic_category(), m_workdir);
+
+    m_tracked_files.reserve(entries.size());
+    for (index_entry const& entry : entries) {
+        std::string_view const path = entry.path;
+        m_tracked_files.emplace(path, &entry);
+        for (size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1))
+            m_tracked_dirs.insert(path.substr(0, slash + 1));
+    }
+}
+
+untracked_walker::~untracked_walker() noexcept
+{
+    ::close(m_workdir_fd);
+}
+
+void untracked_walker::use_untracked_cache(untracked_cache const& cache, fsmonitor_changes const* changes, file_time index_mtime, bool trust_ctime)
+{
+    m_cache = &cache;
+    m_fsmonitor = changes;
+    m_index_mtime = index_mtime;
+    m_trust_ctime = trust_ctime;
+}
+
+std::vector<std::string> untracked_walker::find(size_t max_results, std::unordered_set<std::string> const* known)
+{
+    m_results.clear();
+    m_error = nullptr;
+    m_new_results = 0;
+    m_max_results = max_results;
+    m_known = known;
+    m_stop = (max_results == 0);
+    if (m_stop)
+        return {};
+
+    // the number of directories to read is not known in advance; the tracked ones are a lower bound.
+    // with the untracked cache, most of them are not read, and small repositories are walked by the calling thread alone
+    worker_pool& pool = worker_pool::shared();
+    size_t const helpers = std::min(pool.size(), m_tracked_dirs.size() / (m_cache ? k_cached_dirs_per_thread : k_dirs_per_thread));
+    m_queues.clear();
+    for (size_t i = 0; i <= helpers; ++i)
+        m_queues.push_back(std::make_unique<queue>());
+
+    // tasks are only pushed to the queues of running threads, and the others steal from them
+    push(0, task{{}, nullptr, true, m_cache ? &m_cache->root() : nullptr});
+    pool.run(helpers, [this](size_t self) { work(self); });
+
+    if (m_error)
+        std::rethrow_exception(m_error);
+    return std::move(m_results);
+}
+
+void untracked_walker::work(size_t self)
+{
+    task t;
+    while (true) {
+        if (take(self, t)) {
+            try {
+                run(self, t);
+            }
+            catch (...) {
+                std::lock_guard lock(m_results_mutex);
+                if (!m_error)
+                    m_error = std::current_exception();
+                m_stop = true;
+            }
+            if (m_pending.fetch_sub(1) == 1) {
+                std::lock_guard lock(m_idle_mutex);
+                m_idle.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock lock(m_idle_mutex);
+        m_idle.wait(lock, [this]() { return m_queued.load() > 0 || m_pending.load() == 0; });
+        if (m_pending.load() == 0)
+            return;
+    }
+}
+
+bool untracked_walker::take(size_t self, task& t)
+{
+    // own queue from the back (depth first, the directory is likely still cached), others from the front
+    for (size_t k = 0; k < m_queues.size(); ++k) {
+        queue& q = *m_queues[(self + k) % m_queues.size()];
+        std::lock_guard lock(q.mutex);
+        if (q.tasks.empty())
+            continue;
+        if (k == 0) {
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        else {
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        m_queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void untracked_walker::push(size_t self, task t)
+{
+    m_pending.fetch_add(1);
+    {
+        queue& q = *m_queues[self];
+        std::lock_guard lock(q.mutex);
+        q.tasks.push_back(std::move(t));
+        m_queued.fetch_add(1);
+    }
+    {
+        // synchronize with workers that are about to wait
+        std::lock_guard lock(m_idle_mutex);
+    }
+    m_idle.notify_one();
+}
+
+void untracked_walker::run(size_t self, task const& t)
+{
+    if (m_stop)
+        return;
+    if (!t.tracked) {
+        if (contains_untracked(t.dir, t.ignores))
+            report(t.dir);
+        return;
+    }
+
+    std::vector<dir_entry> entries;
+    std::string gitignore;
+    untracked_cache::directory const* cache = t.cache;
+    bool const from_cache = cache && read_cached_dir(t.dir, cache, entries, &gitignore);
+    if (!from_cache && !read_dir(t.dir, entries, &gitignore))
+        return;
+    std::shared_ptr<ignore_chain const> ignores = t.ignores;
+    if (!gitignore.empty())
+        ignores = std::make_shared<ignore_chain const>(ignore_chain{t.ignores, ignore_list::parse(gitignore, t.dir)});
+
+    for (dir_entry const& e : entries) {
+        if (m_stop)
+            return;
+        if (e.name == ".git")
+            continue;
+        std::string path = t.dir + e.name;
+        if (m_tracked_files.count(path))
+            continue;  // also covers submodules
+        // untracked files below an ignored directory are ignored, even if the directory contains tracked files
+        if (is_ignored(ignores.get(), path, e.is_dir))
+            continue;
+        if (e.is_dir) {
+            path += '/';
+            bool const tracked = m_tracked_dirs.count(path) > 0;
+            untracked_cache::directory const* child_cache = (tracked && cache) ? cache->find(e.name) : nullptr;
+            push(self, task{std::move(path), ignores, tracked, child_cache});
+        }
+        else
+            report(std::move(path));
+    }
+}
+
+bool untracked_walker::contains_untracked(std::string const& dir, std::shared_ptr<ignore_chain const> ignores)
+{
+    std::vector<dir_entry> entries;
+    std::string gitignore;
+    if (!read_dir(dir, entries, &gitignore))
+        return false;
+    if (!gitignore.empty())
+        ignores = std::make_shared<ignore_chain const>(ignore_chain{ignores, ignore_list::parse(gitignore, dir)});
+
+    for (dir_entry const& e : entries) {
+        if (m_stop)
+            return false;
+        // nested repositories count as untracked content
+        if (e.name == ".git")
+            return true;
+        std::string path = dir + e.name;
+        if (is_ignored(ignores.get(), path, e.is_dir))
+            continue;
+        if (!e.is_dir || contains_untracked(path + '/', ignores))
+            return true;
+    }
+    return false;
+}
+
+void untracked_walker::report(std::string path)
+{
+    std::lock_guard lock(m_results_mutex);
+    if (!m_known || !m_known->count(path))
+        m_new_results += 1;
+    m_results.push_back(std::move(path));
+    if (m_new_results >= m_max_results)
+        m_stop = true;
+}
+
+bool untracked_walker::read_dir(std::string const& dir, std::vector<dir_entry>& entries, std::string* gitignore) const
+{
+    int const fd = ::openat(m_workdir_fd, dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return false;  // unreadable directories are skipped, like libgit2 does
+
+    bool has_gitignore = false;
+#ifdef __linux__
+    alignas(8) char buffer[k_dirents_buffer_size];
+    while (true) {
+        long const n = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (n <= 0)
+            break;
+        for (long pos = 0; pos < n; ) {
+            char const* record = buffer + pos;
+            unsigned short reclen;
+            std::memcpy(&reclen, record + k_dirent_reclen_offset, sizeof(reclen));
+            pos += reclen;
+
+            unsigned char const type = record[k_dirent_type_offset];
+            char const* name = record + k_dirent_name_offset;
+            if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+                continue;
+            bool is_dir = (type == DT_DIR);
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                is_dir = ::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+            }
+            if (!is_dir && std::strcmp(name, ".gitignore") == 0)
+                has_gitignore = true;
+            entries.push_back(dir_entry{name, is_dir});
+        }
+    }
+#else
+    // the native status engine is Linux-only (see status_scanner::uncommitted_changes())
+    (void)entries;
+    ::close(fd);
+    throw std::runtime_error("reading directories with getdents64 is only supported on Linux");
+#endif
+
+    if (has_gitignore && gitignore)
+        *gitignore = read_file_at(fd, ".gitignore");
+    ::close(fd);
+    return true;
+}
+
+bool untracked_walker::read_cached_dir(std::string const& dir, untracked_cache::directory const*& cache, std::vector<dir_entry>& entries, std::string* gitignore) const
+{
+    // see valid_cached_dir() in git's dir.c
+    bool const may_have_changed = !m_fsmonitor || m_fsmonitor->is_dir_changed(dir);
+    if (may_have_changed && !is_gitignore_unchanged(dir, *cache)) {
+        // entries below may have been left out of the cache because they were ignored by the old rules
+        cache = nullptr;
+        return false;
+    }
+    if (!cache->valid || cache->check_only)
+        return false;
+    if (may_have_changed) {
+        struct stat st;
+        if (::fstatat(m_workdir_fd, dir.empty() ? "." : dir.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0
+            || !cache->stat.matches(stat_data::from(st), m_index_mtime, m_trust_ctime))
+            return false;
+    }
+
+    for (std::string const& name : cache->untracked) {
+        bool const is_dir = !name.empty() && name.back() == '/';
+        entries.push_back(dir_entry{is_dir ? name.substr(0, name.size() - 1) : name, is_dir});
+    }
+    // tracked directories, and untracked ones that were empty when the cache was written
+    for (untracked_cache::directory const& child : cache->dirs)
+        entries.push_back(dir_entry{child.name, true});
+    std::sort(entries.begin(), entries.end(), [](dir_entry const& a, dir_entry const& b) { return a.name < b.name; });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](dir_entry const& a, dir_entry const& b) { return a.name == b.name; }), entries.end());
+
+    if (cache->exclude_oid && gitignore)
+        *gitignore = read_file_at(m_workdir_fd, (dir + ".gitignore").c_str());
+    return true;
+}
+
+bool untracked_walker::is_gitignore_unchanged(std::string const& dir, untracked_cache::directory const& cache) const
+{
+    std::string const path = dir + ".gitignore";
+    struct stat st;
+    if (::fstatat(m_workdir_fd, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+        return !cache.exclude_oid;
+    if (!cache.exclude_oid)
+        return false;
+
+    // the object id is only known for a tracked .gitignore without changes; we do not hash files ourselves
+    auto it = m_tracked_files.find(path);
+    if (it == m_tracked_files.end())
+        return false;
+    index_entry const& entry = *it->second;
+    return entry.stage() == 0
+        && S_ISREG(st.st_mode) && (entry.mode & S_IFMT) == S_IFREG
+        && stat_data::from(entry).matches(stat_data::from(st), m_index_mtime, m_trust_ctime)
+        && entry.oid == *cache.exclude_oid;
+}
+
+bool untracked_walker::is_ignored(ignore_chain const* chain, std::string_view path, bool is_dir) const
+{
+    // deeper .gitignore files take precedence over those of parent directories, and all of them over the global lists
+    for (; chain; chain = chain->parent.get())
+        if (std::optional<bool> ignored = chain->list.match(path, is_dir))
+            return *ignored;
+    for (ignore_list const& list : m_global_ignores)
+        if (std::optional<bool> ignored = list.match(path, is_dir))
+            return *ignored;
+    return false;
+}
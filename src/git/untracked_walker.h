@@ -0,0 +1,116 @@
+#pragma once
+
+#include "fsmonitor.h"
+#include "ignore.h"
+#include "index_file.h"
+#include "untracked_cache.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace git {
+
+    /// Finds untracked files that are not ignored, like libgit2's status without GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS:
+    /// an untracked directory is reported once (as "dir/") if it contains a file that is not ignored.
+    ///
+    /// Directories are read with getdents64 by the calling thread and threads of the shared worker_pool;
+    /// each thread works on its own queue and steals from the others when it runs out. Ignored directories are never entered.
+    /// With git's untracked cache, directories that did not change since it was written are not read at all.
+    class untracked_walker {
+    public:
+        /// @param workdir the working directory, ending with a slash
+        /// @param entries the index entries; the walker keeps references to their paths
+        /// @param global_ignores info/exclude and core.excludesFile, in decreasing precedence
+        untracked_walker(std::string workdir, std::vector<index_entry> const& entries, std::vector<ignore_list> global_ignores);
+        ~untracked_walker() noexcept;
+        untracked_walker(untracked_walker const&) = delete;
+        untracked_walker& operator=(untracked_walker const&) = delete;
+
+        /// Use git's untracked cache (which must have been validated) for tracked directories whose stat data
+        /// and .gitignore did not change. The cache must outlive the walker.
+        /// @param changes if given, directories the fsmonitor hook does not report as changed are trusted without stat
+        void use_untracked_cache(untracked_cache const& cache, fsmonitor_changes const* changes, file_time index_mtime, bool trust_ctime);
+
+        /// Untracked paths relative to the working directory, in no particular order.
+        /// The walk stops early once max_results paths that are not in known have been found.
+        std::vector<std::string> find(size_t max_results = std::numeric_limits<size_t>::max(), std::unordered_set<std::string> const* known = nullptr);
+
+    private:
+        /// the .gitignore files of a directory and its parents
+        struct ignore_chain {
+            std::shared_ptr<ignore_chain const> parent;
+            ignore_list list;
+        };
+
+        struct task {
+            /// relative to the working directory, empty or ending with a slash
+            std::string dir;
+            std::shared_ptr<ignore_chain const> ignores;
+            /// false if the directory is untracked and we only need to know whether it contains an untracked file
+            bool tracked = true;
+            /// the untracked cache of a tracked directory, if it can still be used for the directory or those below
+            untracked_cache::directory const* cache = nullptr;
+        };
+
+        struct queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        struct dir_entry {
+            std::string name;
+            bool is_dir = false;
+        };
+
+        void work(size_t self);
+        bool take(size_t self, task& t);
+        void push(size_t self, task t);
+        void run(size_t self, task const& t);
+        bool contains_untracked(std::string const& dir, std::shared_ptr<ignore_chain const> ignores);
+        void report(std::string path);
+
+        bool read_dir(std::string const& dir, std::vector<dir_entry>& entries, std::string* gitignore) const;
+        bool read_cached_dir(std::string const& dir, untracked_cache::directory const*& cache, std::vector<dir_entry>& entries, std::string* gitignore) const;
+        bool is_gitignore_unchanged(std::string const& dir, untracked_cache::directory const& cache) const;
+        bool is_ignored(ignore_chain const* chain, std::string_view path, bool is_dir) const;
+
+    private:
+        std::string m_workdir;
+        int m_workdir_fd = -1;
+        std::unordered_map<std::string_view, index_entry const*> m_tracked_files;
+        std::unordered_set<std::string_view> m_tracked_dirs;
+        std::vector<ignore_list> m_global_ignores;
+
+        untracked_cache const* m_cache = nullptr;
+        fsmonitor_changes const* m_fsmonitor = nullptr;
+        file_time m_index_mtime;
+        bool m_trust_ctime = true;
+
+        std::vector<std::unique_ptr<queue>> m_queues;
+        /// number of tasks in the queues
+        std::atomic<size_t> m_queued = 0;
+        /// number of tasks in the queues or running; the walk is complete when this reaches 0
+        std::atomic<size_t> m_pending = 0;
+        std::mutex m_idle_mutex;
+        std::condition_variable m_idle;
+        std::atomic<bool> m_stop = false;
+
+        std::mutex m_results_mutex;
+        std::vector<std::string> m_results;
+        std::exception_ptr m_error;
+        size_t m_new_results = 0;
+        size_t m_max_results = 0;
+        std::unordered_set<std::string> const* m_known = nullptr;
+    };
+
+}
@@ -0,0 +1,82 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <system_error>
+
+using namespace git;
+
+worker_pool& worker_pool::shared()
+{
+    static worker_pool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+worker_pool::worker_pool(size_t size)
+    : m_size(size)
+{ }
+
+worker_pool::~worker_pool() noexcept
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_queued.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}
+
+void worker_pool::run(size_t helpers, std::function<void(size_t)> const& job)
+{
+    helpers = std::min(helpers, m_size);
+    group g{&job};
+    if (helpers > 0) {
+        std::lock_guard lock(m_mutex);
+        for (size_t slot = 1; slot <= helpers; ++slot)
+            m_tasks.push_back(task{&g, slot});
+        // threads are started on demand, up to the size of the pool
+        while (m_threads.size() < std::min(m_size, m_tasks.size())) {
+            try {
+                m_threads.emplace_back([this]() { work(); });
+            }
+            catch (std::system_error const&) {
+                break;  // the calling thread does the work of the jobs that do not start
+            }
+        }
+    }
+    m_queued.notify_all();
+
+    // the jobs of the pool are waited for even if job(0) throws
+    struct join_helpers {
+        worker_pool& pool;
+        group& g;
+
+        ~join_helpers()
+        {
+            std::unique_lock lock(pool.m_mutex);
+            pool.m_tasks.erase(std::remove_if(pool.m_tasks.begin(), pool.m_tasks.end(), [this](task const& t) { return t.g == &g; }),
+                               pool.m_tasks.end());
+            pool.m_finished.wait(lock, [this]() { return g.running == 0; });
+        }
+    } const joiner{*this, g};
+
+    job(0);
+}
+
+void worker_pool::work()
+{
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_queued.wait(lock, [this]() { return m_shutdown || !m_tasks.empty(); });
+        if (m_shutdown)
+            return;
+        task const t = m_tasks.front();
+        m_tasks.pop_front();
+        t.g->running += 1;
+        lock.unlock();
+        (*t.g->job)(t.slot);
+        lock.lock();
+        t.g->running -= 1;
+        if (t.g->running == 0)
+            m_finished.notify_all();
+    }
+}
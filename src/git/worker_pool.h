@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace git {
+
+    /// Threads shared by all parallel work of the git layer (e.g., status_scanner and untracked_walker).
+    ///
+    /// The number of threads is bounded by the number of cores, however many repositories are checked concurrently,
+    /// and they are only started when they are first needed.
+    /// The calling thread always takes part in the work, so it completes even if all threads of the pool are busy.
+    class worker_pool {
+    public:
+        /// the pool of the process, with one thread less than there are cores (the calling thread is the other one)
+        static worker_pool& shared();
+
+        explicit worker_pool(size_t size);
+        ~worker_pool() noexcept;
+        worker_pool(worker_pool const&) = delete;
+        worker_pool& operator=(worker_pool const&) = delete;
+
+        /// number of threads of the pool
+        size_t size() const { return m_size; }
+
+        /// Run job(0) on the calling thread, and job(1) to job(helpers) on threads of the pool as they become available.
+        /// Returns when job(0) and all jobs that started have returned; jobs that did not start by then are dropped,
+        /// so job(0) must be able to do all the work alone. Exceptions must not escape the jobs of the pool.
+        void run(size_t helpers, std::function<void(size_t)> const& job);
+
+    private:
+        struct group {
+            std::function<void(size_t)> const* job = nullptr;
+            /// number of jobs of the group that are running on threads of the pool
+            size_t running = 0;
+        };
+
+        struct task {
+            group* g = nullptr;
+            size_t slot = 0;
+        };
+
+        void work();
+
+    private:
+        size_t m_size = 0;
+        std::mutex m_mutex;
+        std::condition_variable m_queued;
+        std::condition_variable m_finished;
+        std::deque<task> m_tasks;
+        std::vector<std::thread> m_threads;
+        bool m_shutdown = false;
+    };
+
+}
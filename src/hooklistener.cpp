@@ -0,0 +1,157 @@
+#include "hooklistener.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    /// a path and a hook name; longer datagrams are dropped
+    inline constexpr size_t k_maxDatagramLength = 8192;
+
+    bool makeAddress(QString const& socketPath, sockaddr_un& addr)
+    {
+        QByteArray const path = QFile::encodeName(socketPath);
+        if (size_t(path.size()) >= sizeof(addr.sun_path))
+            return false;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.constData(), path.size());
+        return true;
+    }
+
+    /// whether another process is bound to the socket path (as opposed to a leftover socket file)
+    bool isInUse(sockaddr_un const& addr)
+    {
+        int const fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+        bool const connected = ::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) == 0;
+        ::close(fd);
+        return connected;
+    }
+}
+
+HookListener::HookListener(RepoManager* repoManager, QObject* parent)
+    : QObject{parent}
+    , m_repoManager{repoManager}
+{
+    Q_ASSERT(m_repoManager);
+}
+
+HookListener::~HookListener()
+{
+    close();
+}
+
+QString HookListener::defaultSocketPath()
+{
+    QString const runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    return QDir(runtimeDir).filePath("git-monitor/hooks.sock");
+}
+
+CheckPhases HookListener::phasesOf(QByteArray const& hook)
+{
+    if (hook == "reference-transaction")
+        return CheckPhase::Head | CheckPhase::Branches;
+    if (hook == "post-checkout")
+        return CheckPhase::Status | CheckPhase::Head;
+    if (hook == "post-commit" || hook == "post-merge" || hook == "post-rewrite")
+        return CheckPhase::All;
+    return {};
+}
+
+bool HookListener::listen(QString const& socketPath)
+{
+    close();
+
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr)) {
+        m_errorString = QStringLiteral("socket path too long");
+        return false;
+    }
+    QDir().mkpath(QFileInfo(socketPath).absolutePath());
+
+    m_fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_fd < 0) {
+        m_errorString = QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+
+    int result = ::bind(m_fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr));
+    if (result != 0 && errno == EADDRINUSE && !isInUse(addr)) {
+        // the socket file may be a leftover from a process that did not exit cleanly
+        ::unlink(addr.sun_path);
+        result = ::bind(m_fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr));
+    }
+    // only the user may send notifications
+    if (result == 0)
+        result = ::chmod(addr.sun_path, 0600);
+    if (result != 0) {
+        m_errorString = errno == EADDRINUSE ? QStringLiteral("another instance is already listening")
+                                            : QString::fromLocal8Bit(std::strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_socketPath = socketPath;
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &HookListener::on_activated);
+    return true;
+}
+
+void HookListener::close()
+{
+    if (m_fd < 0)
+        return;
+    delete m_notifier;
+    m_notifier = nullptr;
+    ::close(m_fd);
+    m_fd = -1;
+    QFile::remove(m_socketPath);
+    m_socketPath.clear();
+}
+
+void HookListener::on_activated()
+{
+    // drain the socket, since a git command usually runs several hooks in a row
+    char buffer[k_maxDatagramLength];
+    while (true) {
+        ssize_t const n = ::recv(m_fd, buffer, sizeof(buffer), MSG_TRUNC);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                qDebug() << "HookListener: recv failed:" << std::strerror(errno);
+            return;
+        }
+        if (size_t(n) > sizeof(buffer)) {
+            qDebug() << "HookListener: dropping datagram of" << n << "bytes";
+            continue;
+        }
+        processDatagram(QByteArray(buffer, n).trimmed());
+    }
+}
+
+void HookListener::processDatagram(QByteArray const& datagram)
+{
+    qsizetype const sep = datagram.indexOf(' ');
+    if (sep < 0)
+        return;
+    QByteArray const hook = datagram.first(sep);
+    QString const path = QString::fromUtf8(datagram.sliced(sep + 1));
+
+    CheckPhases const phases = phasesOf(hook);
+    if (!phases || QDir::isRelativePath(path))
+        return;
+    // repositories that are not monitored are ignored silently, since the hooks may be installed globally
+    if (Repo* repo = m_repoManager->findRepo(path))
+        repo->requestPartialCheck(phases);
+}
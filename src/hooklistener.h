@@ -0,0 +1,50 @@
+#ifndef HOOKLISTENER_H
+#define HOOKLISTENER_H
+
+#include "repomanager.h"
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+
+/// Receives notifications from git hooks (see contrib/hooks) on a Unix domain datagram socket,
+/// and checks the affected phases of the notified repository right away.
+///
+/// Each datagram is "<hook> <path>", where <hook> is the name of the git hook that ran
+/// and <path> is the directory it ran in (the root of the working tree).
+/// Datagrams are never answered, so the hooks do not have to wait for git-monitor.
+class HookListener : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HookListener(RepoManager* repoManager, QObject* parent = nullptr);
+    ~HookListener();
+
+    /// Start listening on the given socket path. Returns false on failure.
+    bool listen(QString const& socketPath);
+
+    QString errorString() const { return m_errorString; }
+
+    /// $XDG_RUNTIME_DIR/git-monitor/hooks.sock (or the equivalent runtime location on this platform)
+    static QString defaultSocketPath();
+
+    /// The phases that may be affected by the git hook with the given name; empty for unknown hooks.
+    static CheckPhases phasesOf(QByteArray const& hook);
+
+private slots:
+    void on_activated();
+
+private:
+    void processDatagram(QByteArray const& datagram);
+    void close();
+
+private:
+    RepoManager* m_repoManager = nullptr;
+    int m_fd = -1;
+    QSocketNotifier* m_notifier = nullptr;
+    QString m_socketPath;
+    QString m_errorString;
+};
+
+#endif // HOOKLISTENER_H
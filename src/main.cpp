@@ -1,25 +1,182 @@
+#include "batchcheck.h"
+#include "hooklistener.h"
 #include "mainwindow.h"
+#include "metricsexporter.h"
+#include "pushreceiver.h"
+#include "queryserver.h"
 #include "repomanager.h"
 #include "trayicon.h"
 #include "git/git.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QThread>
+#include <cstring>
+#include <memory>
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 #include <fmt/ranges.h>
 #include <fmt/std.h>
 
+namespace {
+
+    /// Headless modes must be detected before the application object is created,
+    /// since we must not create a QApplication on hosts without a display.
+    bool isHeadless(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i) {
+            for (char const* option : {"check-all", "daemon"}) {
+                if (argv[i][0] == '-' && (std::strcmp(argv[i] + 1, option) == 0 || (argv[i][1] == '-' && std::strcmp(argv[i] + 2, option) == 0)))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    int runCheckAll(QCommandLineParser const& parser, QCommandLineOption const& reposFile, QCommandLineOption const& jobs, QCommandLineOption const& quick)
+    {
+        std::optional<QList<RepoSettings>> repos;
+        if (parser.isSet(reposFile)) {
+            repos = BatchCheck::readRepoFile(parser.value(reposFile));
+            if (!repos) {
+                fmt::println(stderr, "Unable to read repository list from {}", parser.value(reposFile).toStdString());
+                return BatchCheck::SomeErrors;
+            }
+        }
+        else
+            repos = RepoManager::readRepoSettings();
+
+        int numJobs = QThread::idealThreadCount();
+        if (parser.isSet(jobs)) {
+            bool ok = false;
+            numJobs = parser.value(jobs).toInt(&ok);
+            if (!ok || numJobs < 1) {
+                fmt::println(stderr, "Invalid number of jobs: {}", parser.value(jobs).toStdString());
+                return BatchCheck::SomeErrors;
+            }
+        }
+
+        // we run unattended, so git-credential must not block waiting for terminal input
+        qputenv("GIT_TERMINAL_PROMPT", "0");
+
+        BatchCheck batch(*std::move(repos), numJobs, parser.isSet(quick));
+        QObject::connect(&batch, &BatchCheck::finished, qApp, &QCoreApplication::exit);
+        batch.start();
+        return qApp->exec();
+    }
+
+    struct MetricsOptions {
+        QCommandLineOption file{"metrics-file", QCoreApplication::translate("main", "Periodically write metrics in Prometheus text format to <file>."), "file"};
+        QCommandLineOption interval{"metrics-interval", QCoreApplication::translate("main", "With --metrics-file: seconds between updates of the metrics file (default: 60)."), "seconds", "60"};
+        QCommandLineOption port{"metrics-port", QCoreApplication::translate("main", "Serve metrics in Prometheus text format on <port> of the loopback interface."), "port"};
+    };
+
+    /// returns false if the metrics export was requested but could not be set up
+    bool setupMetrics(QCommandLineParser const& parser, MetricsOptions const& options, MetricsExporter& exporter)
+    {
+        if (parser.isSet(options.file)) {
+            bool ok = false;
+            int const interval = parser.value(options.interval).toInt(&ok);
+            if (!ok || interval < 1) {
+                fmt::println(stderr, "Invalid metrics interval: {}", parser.value(options.interval).toStdString());
+                return false;
+            }
+            exporter.writePeriodically(parser.value(options.file), std::chrono::seconds(interval));
+        }
+        if (parser.isSet(options.port)) {
+            bool ok = false;
+            quint16 const port = parser.value(options.port).toUShort(&ok);
+            if (!ok) {
+                fmt::println(stderr, "Invalid metrics port: {}", parser.value(options.port).toStdString());
+                return false;
+            }
+            if (!exporter.listen(port)) {
+                fmt::println(stderr, "Unable to serve metrics on port {}: {}", port, exporter.errorString().toStdString());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// notifications from git hooks are optional, so the monitor keeps running without them
+    void setupHookListener(QCommandLineParser const& parser, QCommandLineOption const& hookSocket, HookListener& listener)
+    {
+        QString const socketPath = parser.isSet(hookSocket) ? parser.value(hookSocket) : HookListener::defaultSocketPath();
+        if (listener.listen(socketPath))
+            fmt::println(stderr, "Listening for git hooks on {}", socketPath.toStdString());
+        else
+            fmt::println(stderr, "Unable to listen for git hooks on {}: {}", socketPath.toStdString(), listener.errorString().toStdString());
+    }
+
+    /// returns false if push notifications were requested but the receiver could not be set up
+    bool setupPushReceiver(QCommandLineParser const& parser, QCommandLineOption const& pushPort, PushReceiver& receiver)
+    {
+        if (!parser.isSet(pushPort))
+            return true;
+        bool ok = false;
+        quint16 const port = parser.value(pushPort).toUShort(&ok);
+        if (!ok) {
+            fmt::println(stderr, "Invalid push notification port: {}", parser.value(pushPort).toStdString());
+            return false;
+        }
+        // not an option, since the command line is visible to other users
+        QByteArray const token = qgetenv("GIT_MONITOR_PUSH_TOKEN");
+        if (token.isEmpty()) {
+            fmt::println(stderr, "Set GIT_MONITOR_PUSH_TOKEN to the token that push notifications must carry");
+            return false;
+        }
+        if (!receiver.listen(port, token)) {
+            fmt::println(stderr, "Unable to listen for push notifications on port {}: {}", port, receiver.errorString().toStdString());
+            return false;
+        }
+        fmt::println(stderr, "Listening for push notifications on port {}", port);
+        return true;
+    }
+
+    int runDaemon(QCommandLineParser const& parser, QCommandLineOption const& socket, QCommandLineOption const& hookSocket, QCommandLineOption const& pushPort, MetricsOptions const& metricsOptions)
+    {
+        QString const socketPath = parser.isSet(socket) ? parser.value(socket) : QueryServer::defaultSocketPath();
+
+        RepoManager repoManager;
+        repoManager.readSettings();
+
+        MetricsExporter metricsExporter(&repoManager);
+        if (!setupMetrics(parser, metricsOptions, metricsExporter))
+            return 1;
+
+        QueryServer queryServer(&repoManager);
+        if (!queryServer.listen(socketPath)) {
+            fmt::println(stderr, "Unable to listen on {}: {}", socketPath.toStdString(), queryServer.errorString().toStdString());
+            return 1;
+        }
+        fmt::println(stderr, "Listening for queries on {}", socketPath.toStdString());
+
+        HookListener hookListener(&repoManager);
+        setupHookListener(parser, hookSocket, hookListener);
+
+        PushReceiver pushReceiver(&repoManager);
+        if (!setupPushReceiver(parser, pushPort, pushReceiver))
+            return 1;
+
+        return qApp->exec();
+    }
+
+}
 
 int main(int argc, char* argv[])
 {
-    fmt::println("Git Monitor version {}", GIT_MONITOR_VERSION);
-    fmt::println("libgit2: loaded version {}, compiled against version {}", fmt::streamed(git::libgit2_runtime_version()), fmt::streamed(git::libgit2_compile_version()));
-    fmt::println("Qt: loaded version {}, compiled against version {}", qVersion(), QT_VERSION_STR);
+    fmt::println(stderr, "Git Monitor version {}", GIT_MONITOR_VERSION);
+    fmt::println(stderr, "libgit2: loaded version {}, compiled against version {}", fmt::streamed(git::libgit2_runtime_version()), fmt::streamed(git::libgit2_compile_version()));
+    fmt::println(stderr, "Qt: loaded version {}, compiled against version {}", qVersion(), QT_VERSION_STR);
 
     git::libgit2_init();
 
-    QApplication app(argc, argv);
+    bool const headless = isHeadless(argc, argv);
+    std::unique_ptr<QCoreApplication> app;
+    if (headless)
+        app = std::make_unique<QCoreApplication>(argc, argv);
+    else
+        app = std::make_unique<QApplication>(argc, argv);
 
     QCoreApplication::setOrganizationName("Jakob Rath");
     QCoreApplication::setOrganizationDomain("jakobrath.eu");
@@ -30,9 +187,6 @@ int main(int argc, char* argv[])
 #endif
     QCoreApplication::setApplicationVersion(GIT_MONITOR_VERSION);
 
-    QApplication::setQuitOnLastWindowClosed(false);
-
-
     QCommandLineParser parser;
     parser.setApplicationDescription(QCoreApplication::applicationName());
     parser.addHelpOption();
@@ -41,11 +195,59 @@ int main(int argc, char* argv[])
     QCommandLineOption hide("hide", QCoreApplication::translate("main", "Hide the settings window on startup"));
     parser.addOption(hide);
 
-    parser.process(app);
+    QCommandLineOption checkAll("check-all", QCoreApplication::translate("main", "Check all repositories without GUI, print one JSON object per repository, and exit. The exit code is 0 if all repositories are ok, 1 if some are dirty or outdated, and 2 on errors."));
+    parser.addOption(checkAll);
+
+    QCommandLineOption reposFile("repos-file", QCoreApplication::translate("main", "With --check-all: read repository paths from <file> (one per line, '-' for stdin) instead of the settings."), "file");
+    parser.addOption(reposFile);
+
+    QCommandLineOption jobs({"j", "jobs"}, QCoreApplication::translate("main", "With --check-all: number of repositories to check in parallel."), "n");
+    parser.addOption(jobs);
+
+    QCommandLineOption quick("quick", QCoreApplication::translate("main", "With --check-all: only determine whether there are uncommitted changes (reported as 0 or 1), stopping at the first one."));
+    parser.addOption(quick);
+
+    QCommandLineOption daemon("daemon", QCoreApplication::translate("main", "Monitor repositories without GUI and answer queries on a local socket."));
+    parser.addOption(daemon);
+
+    QCommandLineOption socket("socket", QCoreApplication::translate("main", "With --daemon: path of the query socket."), "path");
+    parser.addOption(socket);
+
+    QCommandLineOption hookSocket("hook-socket", QCoreApplication::translate("main", "Path of the socket for notifications from git hooks (see contrib/hooks)."), "path");
+    parser.addOption(hookSocket);
+
+    QCommandLineOption pushPort("push-port", QCoreApplication::translate("main", "Receive push notifications (e.g., from webhooks of a git server) via HTTP on <port> of the loopback interface. Requires the token in GIT_MONITOR_PUSH_TOKEN."), "port");
+    parser.addOption(pushPort);
+
+    MetricsOptions metricsOptions;
+    parser.addOption(metricsOptions.file);
+    parser.addOption(metricsOptions.interval);
+    parser.addOption(metricsOptions.port);
+
+    parser.process(*app);
+
+    if (parser.isSet(checkAll))
+        return runCheckAll(parser, reposFile, jobs, quick);
+    if (parser.isSet(daemon))
+        return runDaemon(parser, socket, hookSocket, pushPort, metricsOptions);
+    Q_ASSERT(!headless);
+
+    QApplication::setQuitOnLastWindowClosed(false);
 
     RepoManager repoManager;
     repoManager.readSettings();
 
+    MetricsExporter metricsExporter(&repoManager);
+    if (!setupMetrics(parser, metricsOptions, metricsExporter))
+        return 1;
+
+    HookListener hookListener(&repoManager);
+    setupHookListener(parser, hookSocket, hookListener);
+
+    PushReceiver pushReceiver(&repoManager);
+    if (!setupPushReceiver(parser, pushPort, pushReceiver))
+        return 1;
+
     TrayIcon trayIcon;
     trayIcon.setRepoManager(&repoManager);
     trayIcon.show();
@@ -57,7 +259,7 @@ int main(int argc, char* argv[])
     if (!parser.isSet(hide))
         w.show();
 
-    int result = app.exec();
+    int result = app->exec();
     qDebug() << "Exiting:" << result;
 
     // this is optional if the application is exiting anyway
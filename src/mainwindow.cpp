@@ -2,6 +2,7 @@
 #include "ui_mainwindow.h"
 #include "repotablemodel.h"
 #include "settings.h"
+#include <QFileDialog>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -15,6 +16,8 @@ MainWindow::MainWindow(QWidget *parent)
     m_repoTableModel = new RepoTableModel(this);
     m_sortFilterModel = new QSortFilterProxyModel(this);
     m_sortFilterModel->setSourceModel(m_repoTableModel);
+    m_sortFilterModel->setSortRole(RepoTableModel::SortRole);
+    m_sortFilterModel->setSortCaseSensitivity(Qt::CaseInsensitive);
     m_ui->repoTableView->setModel(m_sortFilterModel);
 
     auto* header = m_ui->repoTableView->horizontalHeader();
@@ -33,7 +36,23 @@ MainWindow::~MainWindow()
 
 void MainWindow::setRepoManager(RepoManager* repoManager)
 {
+    if (m_repoManager)
+        disconnect(m_repoManager->discovery(), nullptr, this, nullptr);
+
+    m_repoManager = repoManager;
     m_repoTableModel->setRepoManager(repoManager);
+
+    if (m_repoManager) {
+        RepoDiscovery* discovery = m_repoManager->discovery();
+        connect(discovery, &RepoDiscovery::progress, this, [this](qsizetype directoriesScanned, qsizetype reposFound) {
+            m_ui->statusBar->show();
+            m_ui->statusBar->showMessage(tr("Discovering repositories: scanned %1 directories, found %2 repositories").arg(directoriesScanned).arg(reposFound));
+        });
+        connect(discovery, &RepoDiscovery::finished, this, [this](QList<RepoSettings> const& repos) {
+            m_ui->statusBar->showMessage(tr("Discovery finished: found %1 repositories").arg(repos.size()), 5000);
+            QTimer::singleShot(5000, m_ui->statusBar, &QStatusBar::hide);
+        });
+    }
 }
 
 void MainWindow::closeEvent(QCloseEvent* event)
@@ -68,5 +87,18 @@ void MainWindow::on_addRepoButton_clicked()
         return;  // dialog was cancelled
 
     RepoSettings rs = m_editRepoDialog->values();
-    m_repoTableModel->addRepo(std::move(rs));
+    m_repoTableModel->addRepo(std::move(rs), m_editRepoDialog->takePrefetchedCheck());
+}
+
+void MainWindow::on_discoverReposButton_clicked()
+{
+    Q_ASSERT(m_repoManager);
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Choose Directory to Search for Git Repositories"), QDir::homePath(), QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (dir.isNull())
+        return;  // the user pressed 'Cancel'
+
+    RepoDiscovery* discovery = m_repoManager->discovery();
+    discovery->addRoot(dir);
+    // if a scan is already running, the new root is picked up by the next rescan
+    discovery->start();
 }
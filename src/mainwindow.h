@@ -23,6 +23,7 @@ public:
 
 private slots:
     void on_addRepoButton_clicked();
+    void on_discoverReposButton_clicked();
 
 private:
     void closeEvent(QCloseEvent* event) override;
@@ -33,6 +34,7 @@ private:
 private:
     Ui::MainWindow* m_ui = nullptr;
     EditRepoDialog* m_editRepoDialog = nullptr;
+    RepoManager* m_repoManager = nullptr;
     RepoTableModel* m_repoTableModel = nullptr;
     QSortFilterProxyModel* m_sortFilterModel = nullptr;
 };
@@ -0,0 +1,251 @@
+#include "metricsexporter.h"
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+    QByteArray escapeLabelValue(QString const& value)
+    {
+        QByteArray escaped = value.toUtf8();
+        escaped.replace('\\', "\\\\");
+        escaped.replace('"', "\\\"");
+        escaped.replace('\n', "\\n");
+        return escaped;
+    }
+
+    class MetricsWriter {
+    public:
+        void header(char const* name, char const* type, char const* help)
+        {
+            m_out += "# HELP ";
+            m_out += name;
+            m_out += ' ';
+            m_out += help;
+            m_out += "\n# TYPE ";
+            m_out += name;
+            m_out += ' ';
+            m_out += type;
+            m_out += '\n';
+        }
+
+        template <typename T>
+        void sample(char const* name, QByteArray const& labels, T value)
+        {
+            m_out += name;
+            if (!labels.isEmpty()) {
+                m_out += '{';
+                m_out += labels;
+                m_out += '}';
+            }
+            m_out += ' ';
+            m_out += QByteArray::number(value);
+            m_out += '\n';
+        }
+
+        QByteArray const& data() const { return m_out; }
+
+    private:
+        QByteArray m_out;
+    };
+
+    QByteArray pathLabel(Repo const* repo)
+    {
+        return "path=\"" + escapeLabelValue(repo->settings().path) + '"';
+    }
+
+    inline constexpr RepoStatus k_allStatuses[] = {
+        RepoStatus::Unknown,
+        RepoStatus::Ok,
+        RepoStatus::DirtyOrOutdated,
+        RepoStatus::Error,
+    };
+
+}
+
+MetricsExporter::MetricsExporter(RepoManager* repoManager, QObject* parent)
+    : QObject{parent}
+    , m_repoManager{repoManager}
+{
+    Q_ASSERT(m_repoManager);
+}
+
+void MetricsExporter::writePeriodically(QString const& fileName, std::chrono::seconds interval)
+{
+    m_fileName = fileName;
+    if (!m_writeTimer) {
+        m_writeTimer = new QTimer(this);
+        connect(m_writeTimer, &QTimer::timeout, this, &MetricsExporter::writeFile);
+    }
+    m_writeTimer->start(interval);
+    writeFile();
+}
+
+void MetricsExporter::writeFile()
+{
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "MetricsExporter: unable to open" << m_fileName << ":" << file.errorString();
+        return;
+    }
+    file.write(render());
+    if (!file.commit())
+        qDebug() << "MetricsExporter: unable to write" << m_fileName << ":" << file.errorString();
+}
+
+bool MetricsExporter::listen(quint16 port)
+{
+    if (!m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &MetricsExporter::on_newConnection);
+    }
+    return m_server->listen(QHostAddress::LocalHost, port);
+}
+
+QString MetricsExporter::errorString() const
+{
+    return m_server ? m_server->errorString() : QString();
+}
+
+void MetricsExporter::on_newConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            // we serve the metrics for every request regardless of method and path
+            socket->readAll();
+            QByteArray const body = render();
+            QByteArray response = "HTTP/1.0 200 OK\r\n"
+                                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                                  "Connection: close\r\n"
+                                  "\r\n";
+            response += body;
+            socket->write(response);
+            socket->disconnectFromHost();
+        }, Qt::SingleShotConnection);
+    }
+}
+
+QByteArray MetricsExporter::render() const
+{
+    MetricsWriter w;
+    QList<Repo*> const& repos = m_repoManager->repos();
+
+    w.header("git_monitor_repos", "gauge", "Number of monitored repositories by status.");
+    for (RepoStatus status : k_allStatuses)
+        w.sample("git_monitor_repos", "status=\"" + repoStatusName(status).toUtf8() + '"', m_repoManager->aggregate().repos(status));
+
+    w.header("git_monitor_checks_in_progress", "gauge", "Number of repositories that are currently being checked.");
+    w.sample("git_monitor_checks_in_progress", {}, m_repoManager->checksInProgress());
+
+    // checks that are in progress but do not occupy a thread are waiting in the queue of the thread pool
+    QThreadPool const* pool = QThreadPool::globalInstance();
+    w.header("git_monitor_check_threads_active", "gauge", "Number of threads that are currently performing checks.");
+    w.sample("git_monitor_check_threads_active", {}, pool->activeThreadCount());
+    w.header("git_monitor_check_threads_max", "gauge", "Maximum number of threads used for checks.");
+    w.sample("git_monitor_check_threads_max", {}, pool->maxThreadCount());
+
+    RepoManager::QueryCounters const& queries = m_repoManager->queryCounters();
+    w.header("git_monitor_queries_total", "counter", "Number of answered queries on the query socket by result.");
+    w.sample("git_monitor_queries_total", "result=\"cached\"", queries.cached);
+    w.sample("git_monitor_queries_total", "result=\"refreshed\"", queries.refreshed);
+    w.sample("git_monitor_queries_total", "result=\"failed\"", queries.failed);
+
+    w.header("git_monitor_repo_status", "gauge", "Current status of the repository (1 for the current status, 0 otherwise).");
+    for (Repo const* repo : repos) {
+        for (RepoStatus status : k_allStatuses)
+            w.sample("git_monitor_repo_status", pathLabel(repo) + ",status=\"" + repoStatusName(status).toUtf8() + '"', int(repo->status() == status));
+    }
+
+    w.header("git_monitor_repo_checking", "gauge", "Whether the repository is currently being checked.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_checking", pathLabel(repo), int(repo->activity() == RepoActivity::Checking));
+    w.header("git_monitor_repo_waiting", "gauge", "Whether checking is paused while a git operation modifies the repository.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_waiting", pathLabel(repo), int(repo->activity() == RepoActivity::Waiting));
+
+    w.header("git_monitor_repo_uncommitted_changes", "gauge", "Number of files with uncommitted changes.");
+    for (Repo const* repo : repos) {
+        if (auto const& uncommitted = repo->statistics().uncommitted)
+            w.sample("git_monitor_repo_uncommitted_changes", pathLabel(repo), quint64(*uncommitted));
+    }
+
+    w.header("git_monitor_repo_head_ahead_commits", "gauge", "Number of commits on HEAD that are not on its upstream branch.");
+    for (Repo const* repo : repos) {
+        if (auto const& ab = repo->statistics().head_ahead_behind)
+            w.sample("git_monitor_repo_head_ahead_commits", pathLabel(repo), quint64(ab->ahead));
+    }
+    w.header("git_monitor_repo_head_behind_commits", "gauge", "Number of commits on HEAD's upstream branch that are not on HEAD.");
+    for (Repo const* repo : repos) {
+        if (auto const& ab = repo->statistics().head_ahead_behind)
+            w.sample("git_monitor_repo_head_behind_commits", pathLabel(repo), quint64(ab->behind));
+    }
+    w.header("git_monitor_repo_branches_ahead_commits", "gauge", "Number of unpushed commits summed over all local branches.");
+    for (Repo const* repo : repos) {
+        if (auto const& ab = repo->statistics().total_ahead_behind)
+            w.sample("git_monitor_repo_branches_ahead_commits", pathLabel(repo), quint64(ab->ahead));
+    }
+    w.header("git_monitor_repo_branches_behind_commits", "gauge", "Number of unmerged commits summed over all local branches.");
+    for (Repo const* repo : repos) {
+        if (auto const& ab = repo->statistics().total_ahead_behind)
+            w.sample("git_monitor_repo_branches_behind_commits", pathLabel(repo), quint64(ab->behind));
+    }
+    w.header("git_monitor_repo_branches", "gauge", "Number of local branches.");
+    for (Repo const* repo : repos) {
+        if (auto const& counts = repo->statistics().branch_counts)
+            w.sample("git_monitor_repo_branches", pathLabel(repo), quint64(counts->total));
+    }
+    w.header("git_monitor_repo_branches_monitored", "gauge", "Number of local branches that pass the branch filter of the repository.");
+    for (Repo const* repo : repos) {
+        if (auto const& counts = repo->statistics().branch_counts)
+            w.sample("git_monitor_repo_branches_monitored", pathLabel(repo), quint64(counts->monitored));
+    }
+    w.header("git_monitor_repo_branches_inactive", "gauge", "Number of monitored local branches without recent activity, which are only walked in the periodic full sweep.");
+    for (Repo const* repo : repos) {
+        if (auto const& counts = repo->statistics().branch_counts)
+            w.sample("git_monitor_repo_branches_inactive", pathLabel(repo), quint64(counts->inactive));
+    }
+    w.header("git_monitor_repo_remote_branches_outdated", "gauge", "Number of remote-tracking branches that differ from the remote repository.");
+    for (Repo const* repo : repos) {
+        if (auto const& outdated = repo->statistics().branches_outdated)
+            w.sample("git_monitor_repo_remote_branches_outdated", pathLabel(repo), quint64(*outdated));
+    }
+
+    w.header("git_monitor_repo_last_check_timestamp_seconds", "gauge", "Start time of the last completed check as Unix timestamp.");
+    for (Repo const* repo : repos) {
+        if (repo->checkCount() > 0)
+            w.sample("git_monitor_repo_last_check_timestamp_seconds", pathLabel(repo), repo->statistics().timestamp.toSecsSinceEpoch());
+    }
+    w.header("git_monitor_repo_last_check_duration_seconds", "gauge", "Duration of the last completed check.");
+    for (Repo const* repo : repos) {
+        if (repo->checkCount() > 0)
+            w.sample("git_monitor_repo_last_check_duration_seconds", pathLabel(repo), std::chrono::duration<double>(repo->statistics().duration).count());
+    }
+    w.header("git_monitor_repo_last_status_duration_seconds", "gauge", "Duration of counting the uncommitted changes in the last completed check.");
+    for (Repo const* repo : repos) {
+        if (repo->checkCount() > 0)
+            w.sample("git_monitor_repo_last_status_duration_seconds", pathLabel(repo), std::chrono::duration<double>(repo->statistics().status_duration).count());
+    }
+
+    w.header("git_monitor_repo_checks_total", "counter", "Number of completed checks.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_checks_total", pathLabel(repo), repo->checkCount());
+    w.header("git_monitor_repo_check_failures_total", "counter", "Number of completed checks that reported errors.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_check_failures_total", pathLabel(repo), repo->failedCheckCount());
+    w.header("git_monitor_repo_check_requests_coalesced_total", "counter", "Number of check requests that were merged into an already running check.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_check_requests_coalesced_total", pathLabel(repo), repo->coalescedRequestCount());
+    w.header("git_monitor_repo_remote_updates_total", "counter", "Number of push notifications that updated the remote state.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_remote_updates_total", pathLabel(repo), repo->remoteUpdateCount());
+    w.header("git_monitor_repo_errors", "gauge", "Number of distinct errors reported during the last hour.");
+    for (Repo const* repo : repos)
+        w.sample("git_monitor_repo_errors", pathLabel(repo), repo->errors().size());
+
+    return w.data();
+}
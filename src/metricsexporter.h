@@ -0,0 +1,41 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include "repomanager.h"
+#include <QObject>
+#include <chrono>
+
+class QTcpServer;
+class QTimer;
+
+/// Exports the state of the RepoManager in the Prometheus text exposition format.
+/// The metrics are rendered from the current state only; exporting never triggers a check.
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsExporter(RepoManager* repoManager, QObject* parent = nullptr);
+
+    /// Periodically write the metrics to the given file (e.g., for the textfile collector of node_exporter).
+    /// The file is replaced atomically.
+    void writePeriodically(QString const& fileName, std::chrono::seconds interval);
+
+    /// Serve the metrics via HTTP on the given port of the loopback interface.
+    bool listen(quint16 port);
+
+    QString errorString() const;
+
+    QByteArray render() const;
+
+private slots:
+    void writeFile();
+    void on_newConnection();
+
+private:
+    RepoManager* m_repoManager = nullptr;
+    QString m_fileName;
+    QTimer* m_writeTimer = nullptr;
+    QTcpServer* m_server = nullptr;
+};
+
+#endif // METRICSEXPORTER_H
@@ -0,0 +1,227 @@
+#include "pushreceiver.h"
+#include <QJsonArray>
+#include <QHash>
+#include <QJsonDocument>
+#include <QMessageAuthenticationCode>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <algorithm>
+#include <memory>
+
+namespace {
+    /// webhook payloads include the pushed commits, so they may be fairly large
+    inline constexpr qint64 k_maxRequestLength = 4 * 1024 * 1024;
+    /// connections that have not completed their request by then are closed, so idle or slow clients do not pile up
+    inline constexpr std::chrono::milliseconds k_requestTimeout = std::chrono::seconds(10);
+    /// URL fields of the "repository" object in the webhook payloads of GitHub, Gitea/Forgejo and GitLab
+    inline constexpr char const* k_repositoryUrlFields[] = {"clone_url", "ssh_url", "git_http_url", "git_ssh_url"};
+    /// names of the loopback interface; other Host headers come from web pages whose domain resolves to the loopback interface (DNS rebinding)
+    inline constexpr char const* k_localHosts[] = {"localhost", "127.0.0.1", "[::1]"};
+
+    bool isLocalHost(QByteArray host)
+    {
+        // the port is optional; IPv6 addresses are in brackets, so their colons come before the last ']'
+        if (qsizetype const colon = host.lastIndexOf(':'); colon > host.lastIndexOf(']'))
+            host.truncate(colon);
+        for (char const* local : k_localHosts) {
+            if (host.compare(local, Qt::CaseInsensitive) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    /// comparison whose duration does not depend on where the strings differ, so the token cannot be guessed byte by byte
+    bool constantTimeEquals(QByteArray const& a, QByteArray const& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        unsigned char diff = 0;
+        for (qsizetype i = 0; i < a.size(); ++i)
+            diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+        return diff == 0;
+    }
+}
+
+PushReceiver::PushReceiver(RepoManager* repoManager, QObject* parent)
+    : QObject{parent}
+    , m_repoManager{repoManager}
+{
+    Q_ASSERT(m_repoManager);
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &PushReceiver::on_newConnection);
+}
+
+bool PushReceiver::listen(quint16 port, QByteArray token)
+{
+    if (token.isEmpty()) {
+        m_errorString = QStringLiteral("a token is required");
+        return false;
+    }
+    m_token = std::move(token);
+    m_errorString.clear();
+    return m_server->listen(QHostAddress::LocalHost, port);
+}
+
+QString PushReceiver::errorString() const
+{
+    return m_errorString.isEmpty() ? m_server->errorString() : m_errorString;
+}
+
+QList<RemoteUpdate> PushReceiver::parseNotification(QJsonObject const& obj, QString& errorMessage)
+{
+    QString const ref = obj.value("ref").toString();
+    if (!ref.startsWith("refs/")) {
+        errorMessage = QStringLiteral("expected the full name of the pushed branch in \"ref\"");
+        return {};
+    }
+    std::optional<git::oid> const id = git::oid::from_hex(obj.value("after").toString().toStdString());
+    if (!id) {
+        errorMessage = QStringLiteral("expected the new commit id in \"after\"");
+        return {};
+    }
+
+    QStringList urls;
+    if (QString const url = obj.value("url").toString(); !url.isEmpty())
+        urls.push_back(url);
+    QJsonObject const repository = obj.value("repository").toObject();
+    for (char const* field : k_repositoryUrlFields) {
+        QString const url = repository.value(field).toString();
+        if (!url.isEmpty() && !urls.contains(url))
+            urls.push_back(url);
+    }
+    if (urls.isEmpty()) {
+        errorMessage = QStringLiteral("expected the URL of the remote repository in \"url\"");
+        return {};
+    }
+
+    QList<RemoteUpdate> updates;
+    for (QString const& url : urls)
+        updates.push_back(RemoteUpdate{.url = url, .ref = ref, .id = *id});
+    return updates;
+}
+
+void PushReceiver::on_newConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        // also covers a client that does not read the reply, since the socket waits for it to be written before disconnecting
+        QTimer* deadline = new QTimer(socket);
+        deadline->setSingleShot(true);
+        connect(deadline, &QTimer::timeout, socket, [socket]() {
+            socket->abort();
+            socket->deleteLater();
+        });
+        deadline->start(k_requestTimeout);
+        auto request = std::make_shared<Request>();
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, request]() {
+            if (processRequest(socket, *request))
+                disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+        });
+    }
+}
+
+bool PushReceiver::processRequest(QTcpSocket* socket, Request& request)
+{
+    // only the data received since the last call is searched for the end of the header
+    qsizetype const received = request.data.size();
+    request.data += socket->read(k_maxRequestLength + 1 - received);
+    if (request.headerEnd < 0) {
+        request.headerEnd = request.data.indexOf("\r\n\r\n", std::max<qsizetype>(0, received - 3));
+        if (request.headerEnd < 0) {
+            if (request.data.size() <= k_maxRequestLength)
+                return false;
+            reply(socket, "413 Content Too Large", {{"error", "request too long"}});
+            return true;
+        }
+        if (!acceptHeader(socket, request))
+            return true;
+    }
+    qsizetype const bodyStart = request.headerEnd + 4;
+    if (request.data.size() < bodyStart + request.contentLength)
+        return false;
+    QByteArray const body = request.data.sliced(bodyStart, request.contentLength);
+
+    if (!request.signature.isEmpty()) {
+        QByteArray const expected = QMessageAuthenticationCode::hash(body, m_token, QCryptographicHash::Sha256).toHex();
+        if (!constantTimeEquals(request.signature, expected)) {
+            reply(socket, "401 Unauthorized", {{"error", "the signature in X-Hub-Signature-256 does not match the token"}});
+            return true;
+        }
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument const doc = QJsonDocument::fromJson(body, &parseError);
+    if (!doc.isObject()) {
+        reply(socket, "400 Bad Request", {{"error", parseError.error != QJsonParseError::NoError ? parseError.errorString() : "expected a JSON object"}});
+        return true;
+    }
+    QString errorMessage;
+    QList<RemoteUpdate> const updates = parseNotification(doc.object(), errorMessage);
+    if (updates.isEmpty()) {
+        reply(socket, "400 Bad Request", {{"error", errorMessage}});
+        return true;
+    }
+    for (RemoteUpdate const& update : updates)
+        m_repoManager->applyRemoteUpdate(update);
+    // the repositories are updated in the background
+    reply(socket, "202 Accepted", {{"accepted", true}});
+    return true;
+}
+
+bool PushReceiver::acceptHeader(QTcpSocket* socket, Request& request)
+{
+    QList<QByteArray> const lines = request.data.first(request.headerEnd).split('\n');
+    QList<QByteArray> const requestLine = lines.value(0).trimmed().split(' ');
+    // by lowercase name
+    QHash<QByteArray, QByteArray> headers;
+    for (QByteArray const& line : lines.mid(1)) {
+        qsizetype const sep = line.indexOf(':');
+        if (sep > 0)
+            headers.insert(line.first(sep).trimmed().toLower(), line.sliced(sep + 1).trimmed());
+    }
+    if (requestLine.value(0) != "POST") {
+        reply(socket, "405 Method Not Allowed", {{"error", "expected a POST request"}});
+        return false;
+    }
+    if (!isLocalHost(headers.value("host"))) {
+        reply(socket, "403 Forbidden", {{"error", "expected a local Host"}});
+        return false;
+    }
+    // "Authorization: Bearer <token>", or the secret token of GitLab webhooks
+    QByteArray token = headers.value("x-gitlab-token");
+    if (QByteArray const authorization = headers.value("authorization"); authorization.startsWith("Bearer "))
+        token = authorization.sliced(7).trimmed();
+    // GitHub and Gitea/Forgejo do not send the secret, but sign the body with it; the signature is checked once the body is complete
+    if (QByteArray const signature = headers.value("x-hub-signature-256"); token.isEmpty() && signature.startsWith("sha256="))
+        request.signature = signature.sliced(7).toLower();
+    if (request.signature.isEmpty() && !constantTimeEquals(token, m_token)) {
+        reply(socket, "401 Unauthorized", {{"error", "expected the token in the Authorization header, or a signature in X-Hub-Signature-256"}});
+        return false;
+    }
+    // browsers send cross-origin POST requests without preflight only for form content types
+    QByteArray const contentType = headers.value("content-type");
+    if (contentType.split(';').value(0).trimmed().toLower() != "application/json") {
+        reply(socket, "415 Unsupported Media Type", {{"error", "expected Content-Type: application/json"}});
+        return false;
+    }
+    request.contentLength = headers.value("content-length").toLongLong();
+    if (request.contentLength <= 0 || request.headerEnd + 4 + request.contentLength > k_maxRequestLength) {
+        reply(socket, "400 Bad Request", {{"error", "expected a JSON body of limited size"}});
+        return false;
+    }
+    return true;
+}
+
+void PushReceiver::reply(QTcpSocket* socket, QByteArray const& status, QJsonObject const& obj)
+{
+    QByteArray const body = QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+    QByteArray response = "HTTP/1.0 " + status + "\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n"
+                          "\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
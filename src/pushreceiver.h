@@ -0,0 +1,69 @@
+#ifndef PUSHRECEIVER_H
+#define PUSHRECEIVER_H
+
+#include "repomanager.h"
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class QTcpServer;
+class QTcpSocket;
+
+/// Receives push notifications ("branch <ref> of the remote repository at <url> moved to <oid>") via HTTP on the loopback interface,
+/// e.g., from a webhook of a git server, and applies them to the cached remote state of the matching repositories.
+///
+/// Every POST request carries a JSON object with the fields
+/// - "ref": full name of the branch, e.g., "refs/heads/main"
+/// - "after": the new commit id of the branch (all zeros if the branch was deleted)
+/// - "url": URL of the remote repository, as configured in the monitored repositories.
+///   Alternatively, the URLs of the "repository" object of the webhook payloads of common git servers
+///   ("clone_url", "ssh_url", "git_http_url", "git_ssh_url") are used.
+///
+/// Requests must carry the shared token ("Authorization: Bearer <token>", or "X-Gitlab-Token: <token>")
+/// or be signed with it ("X-Hub-Signature-256: sha256=<HMAC-SHA256 of the body>", as GitHub and Gitea/Forgejo sign webhooks),
+/// and carry "Content-Type: application/json" and a Host of the loopback interface, so web pages cannot send notifications.
+/// A connection that does not complete its request within a few seconds is closed.
+class PushReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PushReceiver(RepoManager* repoManager, QObject* parent = nullptr);
+
+    /// Listen on the given port of the loopback interface, accepting requests that carry the token. Returns false on failure.
+    bool listen(quint16 port, QByteArray token);
+
+    QString errorString() const;
+
+    /// The updates described by a notification; errorMessage is set if it is malformed.
+    static QList<RemoteUpdate> parseNotification(QJsonObject const& obj, QString& errorMessage);
+
+private slots:
+    void on_newConnection();
+
+private:
+    /// a request while it is received
+    struct Request {
+        QByteArray data;
+        /// position of the empty line ending the header, or -1 while it has not been received
+        qsizetype headerEnd = -1;
+        qint64 contentLength = 0;
+        /// hex HMAC-SHA256 of the body, if the request is signed instead of carrying the token
+        QByteArray signature;
+    };
+
+    /// returns false if the request is not complete yet
+    bool processRequest(QTcpSocket* socket, Request& request);
+    /// returns false if the request was rejected (and answered) because of its header
+    bool acceptHeader(QTcpSocket* socket, Request& request);
+    void reply(QTcpSocket* socket, QByteArray const& status, QJsonObject const& obj);
+
+private:
+    RepoManager* m_repoManager = nullptr;
+    QTcpServer* m_server = nullptr;
+    QByteArray m_token;
+    QString m_errorString;
+};
+
+#endif // PUSHRECEIVER_H
@@ -0,0 +1,204 @@
+#include "queryserver.h"
+#include "pushreceiver.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QStandardPaths>
+#include <QTimer>
+#include <memory>
+
+namespace {
+    /// dynamic property of sockets that are waiting for a deferred answer
+    inline constexpr char const* k_waiting = "gitMonitorWaiting";
+    /// limit the size of requests to protect against misbehaving clients
+    inline constexpr qint64 k_maxRequestLength = 64 * 1024;
+    /// a refresh is answered with the cached state if its check takes longer than this, e.g., because a remote does not respond
+    inline constexpr std::chrono::milliseconds k_refreshTimeout = std::chrono::minutes(2);
+}
+
+QueryServer::QueryServer(RepoManager* repoManager, QObject* parent)
+    : QObject{parent}
+    , m_repoManager{repoManager}
+{
+    Q_ASSERT(m_repoManager);
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &QueryServer::on_newConnection);
+}
+
+QString QueryServer::defaultSocketPath()
+{
+    QString const runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    return QDir(runtimeDir).filePath("git-monitor/query.sock");
+}
+
+bool QueryServer::listen(QString const& socketPath)
+{
+    QDir().mkpath(QFileInfo(socketPath).absolutePath());
+    if (m_server->listen(socketPath))
+        return true;
+    if (m_server->serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+
+    // the socket file may be a leftover from a process that did not exit cleanly
+    QLocalSocket probe;
+    probe.connectToServer(socketPath);
+    if (probe.waitForConnected(1000)) {
+        qDebug() << "QueryServer: another instance is already listening on" << socketPath;
+        return false;
+    }
+    QLocalServer::removeServer(socketPath);
+    return m_server->listen(socketPath);
+}
+
+QString QueryServer::errorString() const
+{
+    return m_server->errorString();
+}
+
+void QueryServer::on_newConnection()
+{
+    while (QLocalSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { processRequests(socket); });
+    }
+}
+
+void QueryServer::processRequests(QLocalSocket* socket)
+{
+    while (!socket->property(k_waiting).toBool() && socket->canReadLine()) {
+        QByteArray const request = socket->readLine(k_maxRequestLength).trimmed();
+        if (request.isEmpty())
+            continue;
+        if (!processRequest(socket, request))
+            socket->setProperty(k_waiting, true);
+    }
+    if (!socket->canReadLine() && socket->bytesAvailable() > k_maxRequestLength) {
+        reply(socket, {{"error", "request too long"}});
+        socket->disconnectFromServer();
+    }
+}
+
+bool QueryServer::processRequest(QLocalSocket* socket, QByteArray const& request)
+{
+    qsizetype const sep = request.indexOf(' ');
+    QByteArray const command = request.first(sep < 0 ? request.size() : sep);
+    QString const argument = sep < 0 ? QString() : QString::fromUtf8(request.sliced(sep + 1)).trimmed();
+
+    if (command == "list") {
+        QJsonArray repos;
+        for (Repo const* repo : m_repoManager->repos())
+            repos.push_back(repo->toJsonObject());
+        reply(socket, {{"repos", repos}});
+        m_repoManager->queryCounters().cached += 1;
+        return true;
+    }
+
+    if (command == "push") {
+        // "push <url> <ref> <oid>"; the URL comes first since it is the only argument that may contain spaces
+        QStringList args = argument.split(' ', Qt::SkipEmptyParts);
+        QString errorMessage = QStringLiteral("expected: push <url> <ref> <oid>");
+        QList<RemoteUpdate> updates;
+        if (args.size() >= 3) {
+            QJsonObject notification;
+            notification["after"] = args.takeLast();
+            notification["ref"] = args.takeLast();
+            notification["url"] = args.join(' ');
+            updates = PushReceiver::parseNotification(notification, errorMessage);
+        }
+        if (updates.isEmpty()) {
+            m_repoManager->queryCounters().failed += 1;
+            reply(socket, {{"error", errorMessage}});
+            return true;
+        }
+        for (RemoteUpdate const& update : updates)
+            m_repoManager->applyRemoteUpdate(update);
+        reply(socket, {{"accepted", true}});
+        return true;
+    }
+
+    if (command != "status" && command != "refresh") {
+        m_repoManager->queryCounters().failed += 1;
+        reply(socket, {{"error", QStringLiteral("unknown command: %1").arg(QString::fromUtf8(command))}});
+        return true;
+    }
+
+    if (argument.isEmpty() || QDir::isRelativePath(argument)) {
+        m_repoManager->queryCounters().failed += 1;
+        reply(socket, {{"error", "expected an absolute path"}});
+        return true;
+    }
+
+    Repo* repo = m_repoManager->findRepo(argument);
+    if (!repo) {
+        m_repoManager->queryCounters().failed += 1;
+        reply(socket, {{"error", "not monitored"}, {"path", argument}});
+        return true;
+    }
+
+    if (command == "status" || !repo->isEnabled()) {
+        m_repoManager->queryCounters().cached += 1;
+        reply(socket, repo->toJsonObject());
+        return true;
+    }
+
+    Q_ASSERT(command == "refresh");
+    m_repoManager->queryCounters().refreshed += 1;
+    // the first check that starts after the request; concurrent refresh requests share it
+    quint64 const check = repo->startedCheckCount() + 1;
+    repo->requestRefresh();
+    if (repo->activity() == RepoActivity::Waiting) {
+        reply(socket, refreshReply(repo, "deferred"));
+        return true;
+    }
+
+    // owned by the socket, so the connections go away with the client
+    auto* pending = new QObject(socket);
+    QPointer<QLocalSocket> guard{socket};
+    auto answered = std::make_shared<bool>(false);
+    auto answer = [this, guard, pending, answered](QJsonObject const& obj) {
+        if (*answered || !guard)
+            return;
+        *answered = true;
+        pending->deleteLater();  // disconnects the other signals
+        reply(guard, obj);
+        guard->setProperty(k_waiting, false);
+        processRequests(guard);
+    };
+    connect(repo, &Repo::checkFinished, pending, [repo, check, answer]() {
+        if (repo->lastCompletedCheck() >= check)
+            answer(refreshReply(repo, nullptr));
+    });
+    connect(repo, &Repo::changed, pending, [repo, answer]() {
+        // the next check waits for a git command to finish, which may take arbitrarily long
+        if (repo->activity() == RepoActivity::Waiting)
+            answer(refreshReply(repo, "deferred"));
+    });
+    connect(repo, &Repo::checkCancelled, pending, [repo, answer]() {
+        answer(refreshReply(repo, "cancelled"));
+    });
+    QTimer::singleShot(k_refreshTimeout, pending, [repo, answer]() {
+        answer(refreshReply(repo, "timeout"));
+    });
+    return false;
+}
+
+QJsonObject QueryServer::refreshReply(Repo const* repo, char const* notRefreshedReason)
+{
+    QJsonObject obj = repo->toJsonObject();
+    obj["refreshed"] = !notRefreshedReason;
+    if (notRefreshedReason)
+        obj["reason"] = notRefreshedReason;
+    return obj;
+}
+
+void QueryServer::reply(QLocalSocket* socket, QJsonObject const& obj)
+{
+    QByteArray line = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    line += '\n';
+    socket->write(line);
+}
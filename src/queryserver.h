@@ -0,0 +1,50 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include "repomanager.h"
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+
+/// Answers queries about the monitored repositories on a local (Unix domain) socket.
+///
+/// The protocol is line-based; every request is answered by a single line containing a JSON object:
+/// - "status <path>": the cached state of the repository containing <path> (does not trigger a check)
+/// - "refresh <path>": check the repository containing <path> and answer when a check that started after the request has completed.
+///   The answer has "refreshed": false and a "reason" if the cached state is returned instead: "deferred" while the check waits
+///   for a git command (see RepoActivity::Waiting), "cancelled" if checking was disabled, or "timeout" if the check takes too long.
+/// - "list": the cached state of all monitored repositories
+/// - "push <url> <ref> <oid>": a push notification (see PushReceiver), answered before it is applied
+/// Requests on the same connection are answered in order.
+class QueryServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QueryServer(RepoManager* repoManager, QObject* parent = nullptr);
+
+    /// Start listening on the given socket path. Returns false on failure.
+    bool listen(QString const& socketPath);
+
+    QString errorString() const;
+
+    /// $XDG_RUNTIME_DIR/git-monitor/query.sock (or the equivalent runtime location on this platform)
+    static QString defaultSocketPath();
+
+private slots:
+    void on_newConnection();
+
+private:
+    void processRequests(QLocalSocket* socket);
+    /// returns false if the answer is deferred (e.g., waiting for a check to complete)
+    bool processRequest(QLocalSocket* socket, QByteArray const& request);
+    void reply(QLocalSocket* socket, QJsonObject const& obj);
+    /// state of the repo as answer to a refresh request; notRefreshedReason is null if it was refreshed
+    static QJsonObject refreshReply(Repo const* repo, char const* notRefreshedReason);
+
+private:
+    RepoManager* m_repoManager = nullptr;
+    QLocalServer* m_server = nullptr;
+};
+
+#endif // QUERYSERVER_H
@@ -1,8 +1,102 @@
 #include "repo.h"
-#include <QHash>
+#include "repogroupcache.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QStandardPaths>
 #include <QThread>
 #include <QtConcurrent>
 #include <algorithm>
+#include <fmt/format.h>
+#include <limits>
+
+namespace {
+
+    /// Where the native status engine remembers files whose content matches the index (see git::content_cache).
+    /// There is one file per git directory, since each worktree has its own index.
+    std::string contentCacheFileName(QString const& gitDir)
+    {
+        QDir const dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("content-cache"));
+        if (!dir.mkpath("."))
+            return {};
+        QByteArray const name = QCryptographicHash::hash(gitDir.toUtf8(), QCryptographicHash::Sha1).toHex();
+        return dir.filePath(QString::fromLatin1(name) + ".dat").toStdString();
+    }
+
+    /// the index must not have been modified for this long, so we do not get in the way of the user's git commands
+    inline constexpr qint64 k_indexIdleSecs = 5 * 60;
+    /// while the index does not change, it is refreshed again after this long, since files may have been touched meanwhile
+    inline constexpr qint64 k_indexRefreshIntervalSecs = 60 * 60;
+
+    bool isIndexRefreshDue(QString const& gitDir, QDateTime const& lastRefresh, QDateTime const& now)
+    {
+        QFileInfo const index(QDir(gitDir).filePath("index"));
+        if (!index.exists())
+            return false;
+        QDateTime const modified = index.lastModified();
+        if (modified.secsTo(now) < k_indexIdleSecs)
+            return false;
+        return !lastRefresh.isValid() || modified > lastRefresh || lastRefresh.secsTo(now) >= k_indexRefreshIntervalSecs;
+    }
+
+    /// lock files older than this were left behind by a crashed git command and do not pause checking
+    inline constexpr qint64 k_staleLockSecs = 10 * 60;
+    /// after the git operation has finished, wait for the filesystem to quiesce before checking
+    inline constexpr std::chrono::milliseconds k_gitOperationSettleDelay = std::chrono::seconds(2);
+    /// query interval of remotes that send push notifications; the query only catches missed notifications
+    inline constexpr std::chrono::milliseconds k_pushedRemoteCheckInterval = std::chrono::hours(1);
+    /// a remote that has not sent push notifications for this long is queried at the regular interval again, e.g., since its hook was removed
+    inline constexpr std::chrono::milliseconds k_pushNotificationLifetime = std::chrono::hours(24);
+    /// partial check requests arriving within this delay are merged, since git commands often run several hooks in a row
+    inline constexpr std::chrono::milliseconds k_partialCheckDelay = std::chrono::milliseconds(200);
+
+    /// an operation marker (e.g., rebase-merge) only pauses checking if it or the index changed this recently
+    inline constexpr qint64 k_activeGitOperationSecs = 5;
+    /// while waiting for a git operation, how often to look whether it has finished or stopped for the user
+    inline constexpr std::chrono::milliseconds k_gitOperationPollInterval = std::chrono::seconds(k_activeGitOperationSecs);
+
+    /// Name of a lock file or marker showing that a git command is modifying the repository, or an empty string.
+    /// Checking in the middle of a rebase or large checkout reads half-updated state and competes for disk I/O.
+    /// Markers like rebase-merge or MERGE_HEAD also stay while a rebase or merge stops for the user (e.g., on conflicts),
+    /// which may take arbitrarily long, so they only count while the operation is visibly running: the marker or the
+    /// index has changed within the last few seconds.
+    QString gitOperationInProgress(RepoFingerprint const& fp)
+    {
+        QDir const git(fp.gitDir);
+        QDir const common(fp.commonDir);
+        QDateTime const now = QDateTime::currentDateTime();
+        for (QFileInfo const& lock : {QFileInfo(git.filePath("index.lock")), QFileInfo(git.filePath("HEAD.lock")), QFileInfo(common.filePath("packed-refs.lock"))}) {
+            if (lock.exists() && lock.lastModified().secsTo(now) < k_staleLockSecs)
+                return lock.fileName();
+        }
+        QFileInfo const index(git.filePath("index"));
+        bool const indexActive = index.exists() && index.lastModified().secsTo(now) < k_activeGitOperationSecs;
+        for (char const* name : {"rebase-merge", "rebase-apply", "MERGE_HEAD", "CHERRY_PICK_HEAD", "REVERT_HEAD"}) {
+            // the directory of a rebase changes as its todo list and step files are rewritten
+            QFileInfo const marker(git.filePath(name));
+            if (marker.exists() && (indexActive || marker.lastModified().secsTo(now) < k_activeGitOperationSecs))
+                return marker.fileName();
+        }
+        return QString();
+    }
+
+    QList<QString> toStringList(std::vector<std::string> const& strings)
+    {
+        QList<QString> result;
+        result.reserve(static_cast<qsizetype>(strings.size()));
+        for (std::string const& s : strings)
+            result.push_back(QString::fromStdString(s));
+        return result;
+    }
+
+}
+
+QString RemoteUpdate::normalizedUrl() const
+{
+    return QString::fromStdString(std::string(git::normalized_url(url.toStdString())));
+}
 
 Repo::Repo(size_t index, QObject* parent)
     : QObject{parent}
@@ -10,7 +104,12 @@ Repo::Repo(size_t index, QObject* parent)
 {
     m_recheck_timer = new QTimer(this);
     m_recheck_timer->setInterval(m_recheck_interval);
-    connect(m_recheck_timer, &QTimer::timeout, this, &Repo::startCheck);
+    connect(m_recheck_timer, &QTimer::timeout, this, [this]() { startCheck(); });
+
+    m_partial_check_timer = new QTimer(this);
+    m_partial_check_timer->setSingleShot(true);
+    m_partial_check_timer->setInterval(k_partialCheckDelay);
+    connect(m_partial_check_timer, &QTimer::timeout, this, [this]() { startCheck(m_pending_phases); });
 
     connect(&m_check_watcher, &QFutureWatcher<check_result_t>::finished, this, &Repo::checkCompleted);
 }
@@ -48,6 +147,12 @@ void Repo::reset()
     setActivity(RepoActivity::Idle);
     m_statistics = RepoStatistics{};
     m_errors.clear();
+    m_fingerprint = RepoFingerprint{};
+    m_restored = false;
+    m_pending_phases = {};
+    m_pushed_remotes.clear();
+    m_remote_urls.clear();
+    stopWaitingForGitOperation();
 }
 
 void Repo::enable()
@@ -58,9 +163,10 @@ void Repo::enable()
 
     qDebug() << "Enabling checking for repository " << m_settings.path;
 
-    // initial check should be done immediately
+    // initial check should be done immediately.
+    // for restored states, this check only counts the uncommitted changes unless HEAD, refs or config changed in the meantime.
     // TODO: add random delay to avoid filesystem burst? (maybe index * 0.5 seconds on startup)
-    if (m_status == RepoStatus::Unknown)
+    if (m_status == RepoStatus::Unknown || m_restored)
         m_recheck_timer->setInterval(std::chrono::milliseconds(500));
 
     m_recheck_timer->start();
@@ -86,22 +192,191 @@ void Repo::disable()
     m_enabled = false;
 
     m_recheck_timer->stop();
+    m_partial_check_timer->stop();
     m_check_future.cancel();
     m_check_watcher.cancel();
     reset();
 
     emit changed();
+    emit checkCancelled();
 }
 
-void Repo::startCheck()
+void Repo::requestCheck()
 {
-    if (activity() == RepoActivity::Checking)
+    if (!m_enabled)
+        return;
+    // a running check is not restarted, i.e., duplicate requests are coalesced
+    if (activity() == RepoActivity::Checking) {
+        m_coalesced_request_count += 1;
+        return;
+    }
+    startCheck();
+}
+
+void Repo::requestRefresh()
+{
+    if (!m_enabled)
+        return;
+    // the running check may have read the state before the request; the pending phases are checked once it has completed
+    if (activity() == RepoActivity::Checking) {
+        m_pending_phases = CheckPhase::All;
+        return;
+    }
+    startCheck();
+}
+
+void Repo::requestPartialCheck(CheckPhases phases)
+{
+    if (!m_enabled)
+        return;
+    m_pending_phases |= phases;
+    // a running check may have read the state before the change, so the phases are checked once it has completed.
+    // while waiting for a git operation, the check after it includes all phases anyway.
+    if (activity() != RepoActivity::Idle) {
+        m_coalesced_request_count += 1;
+        return;
+    }
+    // not restarted by further requests, so a long burst of hooks does not postpone the check indefinitely
+    if (!m_partial_check_timer->isActive())
+        m_partial_check_timer->start();
+}
+
+void Repo::applyRemoteUpdate(RemoteUpdate update)
+{
+    if (!m_enabled || !m_settings.warnOnUnfetchedCommits)
+        return;
+    auto* watcher = new QFutureWatcher<std::optional<RemoteUpdateResult>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, url = update.normalizedUrl()]() {
+        watcher->deleteLater();
+        std::optional<RemoteUpdateResult> const result = watcher->result();
+        // the settings may have changed in the meantime
+        if (!result || !m_enabled || !m_settings.warnOnUnfetchedCommits)
+            return;
+        qDebug() << "Applied push notification to repository " << m_settings.path;
+        m_remote_update_count += 1;
+        m_statistics.head_state = result->head_state;
+        m_statistics.branches_outdated = result->branches_outdated;
+        if (m_status == RepoStatus::Ok || m_status == RepoStatus::DirtyOrOutdated)
+            m_status = m_statistics.isOk() ? RepoStatus::Ok : RepoStatus::DirtyOrOutdated;
+        m_pushed_remotes[url].lastPush = QDateTime::currentDateTime();
+        emit changed();
+    });
+    watcher->setFuture(QtConcurrent::run([settings = m_settings, update = std::move(update)]() {
+        return applyRemoteUpdate(settings, update);
+    }));
+}
+
+void Repo::adoptCheck(QFuture<check_result_t> future)
+{
+    // a default-constructed future is canceled
+    if (!m_enabled || future.isCanceled() || activity() == RepoActivity::Checking)
         return;
     setActivity(RepoActivity::Checking);
-    qDebug() << "Starting check for repository " << m_settings.path;
+    qDebug() << "Adopting running check for repository " << m_settings.path;
+
+    // the initial check is not needed anymore
+    m_recheck_timer->stop();
+    m_restored = false;
+    m_started_check_count += 1;
+
+    m_check_future = std::move(future);
+    m_check_watcher.setFuture(m_check_future);
+
+    emit changed();
+}
+
+void Repo::waitForGitOperation(QString marker)
+{
+    bool const was_waiting = !m_waiting_for.isEmpty();
+    m_waiting_for = std::move(marker);
+    setActivity(RepoActivity::Waiting);
+    if (!was_waiting)
+        qDebug() << "Waiting for git operation in repository " << m_settings.path << ":" << m_waiting_for;
+
+    if (!m_watcher) {
+        m_watcher = new QFileSystemWatcher(this);
+        connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &Repo::gitDirChanged);
+    }
+    // the locks are created and removed directly in these directories
+    for (QString const& dir : {m_fingerprint.gitDir, m_fingerprint.commonDir}) {
+        if (!m_watcher->directories().contains(dir) && !m_watcher->addPath(dir))
+            qDebug() << "Unable to watch" << dir;
+    }
 
-    m_check_future = QtConcurrent::run([this]() -> check_result_t {
-        return check();
+    // polling covers what the watch does not notice: a failed watch, a lock becoming stale,
+    // and an operation that stops for the user without changing the git directory
+    m_recheck_timer->setInterval(std::min(m_recheck_interval, k_gitOperationPollInterval));
+    m_recheck_timer->start();
+
+    emit changed();
+}
+
+void Repo::stopWaitingForGitOperation()
+{
+    m_waiting_for.clear();
+    if (m_watcher && !m_watcher->directories().isEmpty())
+        m_watcher->removePaths(m_watcher->directories());
+}
+
+void Repo::gitDirChanged()
+{
+    if (m_waiting_for.isEmpty())
+        return;
+    if (QString marker = gitOperationInProgress(m_fingerprint); !marker.isEmpty()) {
+        m_waiting_for = std::move(marker);
+        return;
+    }
+    qDebug() << "Git operation finished in repository " << m_settings.path;
+    stopWaitingForGitOperation();
+    // stay in the waiting state until the check starts
+    m_recheck_timer->setInterval(k_gitOperationSettleDelay);
+    m_recheck_timer->start();
+    emit changed();
+}
+
+void Repo::startCheck(CheckPhases phases)
+{
+    if (activity() == RepoActivity::Checking)
+        return;
+    // the git directory is known from the previous check
+    if (!m_fingerprint.gitDir.isEmpty()) {
+        if (QString marker = gitOperationInProgress(m_fingerprint); !marker.isEmpty()) {
+            waitForGitOperation(std::move(marker));
+            return;
+        }
+    }
+    stopWaitingForGitOperation();
+    setActivity(RepoActivity::Checking);
+    phases |= m_pending_phases;
+    m_pending_phases = {};
+    m_partial_check_timer->stop();
+    qDebug() << "Starting check for repository " << m_settings.path << "phases:" << phases;
+
+    RepoCheckContext context;
+    context.previous = m_statistics;
+    context.fingerprint = m_fingerprint;
+    context.skipRefsIfUnchanged = m_restored;
+    context.remoteInterval = m_remote_check_interval;
+    // remotes that send push notifications are only queried occasionally, to catch missed notifications
+    QDateTime const now = QDateTime::currentDateTime();
+    m_skipped_remote_urls.clear();
+    for (auto it = m_pushed_remotes.begin(); it != m_pushed_remotes.end();) {
+        if (it->lastPush.msecsTo(now) >= k_pushNotificationLifetime.count()) {
+            it = m_pushed_remotes.erase(it);
+            continue;
+        }
+        if (it->lastQuery.isValid() && it->lastQuery.msecsTo(now) < k_pushedRemoteCheckInterval.count())
+            m_skipped_remote_urls.push_back(it.key());
+        ++it;
+    }
+    context.skipRemoteUrls = m_skipped_remote_urls;
+    context.fullSweepInterval = m_full_sweep_interval;
+    context.phases = phases;
+    m_restored = false;
+    m_started_check_count += 1;
+
+    m_check_future = QtConcurrent::run([settings = m_settings, context = std::move(context)]() -> check_result_t {
+        return check(settings, context);
     });
 
     m_check_watcher.setFuture(m_check_future);
@@ -110,35 +385,124 @@ void Repo::startCheck()
 }
 
 // NOTE: this function runs in a separate thread
-Repo::check_result_t Repo::check()
+Repo::check_result_t Repo::check(RepoSettings const& settings, RepoCheckContext const& context)
 {
-    RepoStatistics stats;
-    QList<QString> errors;
+    check_result_t result;
+    RepoStatistics& stats = result.statistics;
+    QList<QString>& errors = result.errors;
     stats.timestamp = QDateTime::currentDateTime();
-    qDebug() << "Checking repository " << m_settings.path;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    qDebug() << "Checking repository " << settings.path;
+
+    // the remote state is queried at most once per interval, since this requires network access.
+    // we allow some slack since timers may fire slightly early.
+    RepoStatistics const& previous = context.previous;
+    bool const remote_due = !previous.remote_timestamp.isValid()
+        || previous.remote_timestamp.msecsTo(stats.timestamp) >= context.remoteInterval.count() * 9 / 10;
+    bool const check_remote = settings.warnOnUnfetchedCommits && remote_due;
+
+    // if HEAD, refs and config did not change since the previous check, its ahead/behind results are still valid.
+    // the fingerprint does not cover files below the top-level working directory, so the status is always checked.
+    CheckPhases phases = context.phases;
+    bool refs_unchanged = false;
+    if (context.skipRefsIfUnchanged && context.fingerprint.isValid()) {
+        result.fingerprint = context.fingerprint.recompute();
+        refs_unchanged = (result.fingerprint == context.fingerprint);
+        if (refs_unchanged) {
+            qDebug() << "Repository unchanged since previous check, only checking the status:" << settings.path;
+            phases &= CheckPhase::Status;
+        }
+    }
 
     std::optional<git::repository> repo_opt;
     try {
-        repo_opt = git::repository::open(m_settings.path.toStdString().c_str());
+        repo_opt = git::repository::open(settings.path.toStdString().c_str());
     }
     catch (std::exception const& e) {
         errors.push_back(tr("Unable to open repository: %1").arg(e.what()));
-        return {stats, errors};  // there's nothing else we can do in this case
+        stats.duration = std::chrono::milliseconds(elapsed.elapsed());
+        return result;  // there's nothing else we can do in this case
     }
 
     Q_ASSERT(repo_opt.has_value());
     git::repository& repo = *repo_opt;
 
+    // compute the fingerprint before reading the repository state, so that concurrent changes are picked up by the next check.
+    // a partial check keeps the previous fingerprint, since the results it carries over may be outdated.
+    if (!refs_unchanged && phases == CheckPhase::All) {
+        result.fingerprint = RepoFingerprint::compute(
+            QString::fromUtf8(repo.path()),
+            QString::fromUtf8(repo.commondir()),
+            repo.workdir() ? QString::fromUtf8(repo.workdir()) : QString());
+    }
+
+    // branches and remotes are shared by all worktrees of the repository (see RepoGroupCache)
+    QString const commonDir = QString::fromUtf8(repo.commondir());
+    git::branch_filter branch_filter = settings.branchFilter();
+    if (settings.inactiveBranchDays > 0)
+        branch_filter.active_since = stats.timestamp.addDays(-settings.inactiveBranchDays).toSecsSinceEpoch();
+    // with a branch filter, HEAD's branch is always monitored, so worktrees on different branches monitor different sets
+    std::optional<std::string> head_branch;
     try {
-        if (settings().warnOnUncommittedChanges)
-            stats.uncommitted = repo.uncommitted_changes();
+        head_branch = repo.head_branch_name();
+    }
+    catch (std::exception const&) {
+        // only the filter applies, and head_state stays unknown
+    }
+    QString const branch_filter_key = RepoGroupCache::branchFilterKey(settings, head_branch ? QString::fromStdString(*head_branch) : QString());
+    // the periodic full sweeps of inactive branches cover all worktrees with the same patterns, whatever their HEAD is
+    QString const sweep_filter_key = RepoGroupCache::branchFilterKey(settings, QString());
+    bool const pruning = branch_filter.active_since.has_value();
+
+    // a partial check carries over the results of the other phases
+    if (!phases.testFlag(CheckPhase::Status)) {
+        stats.uncommitted = previous.uncommitted;
+        stats.status_duration = previous.status_duration;
+    }
+    if (!phases.testFlag(CheckPhase::Head))
+        stats.head_ahead_behind = previous.head_ahead_behind;
+    if (!phases.testFlag(CheckPhase::Branches)) {
+        stats.total_ahead_behind = previous.total_ahead_behind;
+        stats.inactive_ahead_behind = previous.inactive_ahead_behind;
+        stats.branch_counts = previous.branch_counts;
+        stats.full_sweep_timestamp = previous.full_sweep_timestamp;
+    }
+
+    try {
+        if (settings.warnOnUncommittedChanges && phases.testFlag(CheckPhase::Status)) {
+            QElapsedTimer status_elapsed;
+            status_elapsed.start();
+            std::string const content_cache = contentCacheFileName(QString::fromUtf8(repo.path()));
+            if (context.quick)
+                stats.uncommitted = repo.uncommitted_changes(git::status_engine::native, 1, content_cache);
+            else
+                stats.uncommitted = repo.uncommitted_changes(settings.statusEngine, std::numeric_limits<size_t>::max(), content_cache);
+            stats.status_duration = std::chrono::milliseconds(status_elapsed.elapsed());
+        }
     }
     catch (std::exception const& e) {
         errors.push_back(tr("Unable to check uncommitted changes: %1").arg(e.what()));
     }
 
+    // the checks after a refresh show whether it made the status cheaper
+    stats.index_refresh_timestamp = previous.index_refresh_timestamp;
+    stats.status_duration_before_refresh = previous.status_duration_before_refresh;
+    if (settings.refreshIndexWhenIdle && settings.warnOnUncommittedChanges && !context.quick && phases.testFlag(CheckPhase::Status)
+        && isIndexRefreshDue(QString::fromUtf8(repo.path()), previous.index_refresh_timestamp, stats.timestamp)) {
+        try {
+            if (repo.refresh_index()) {
+                stats.index_refresh_timestamp = QDateTime::currentDateTime();
+                stats.status_duration_before_refresh = stats.status_duration;
+            }
+        }
+        catch (std::exception const& e) {
+            errors.push_back(tr("Unable to refresh the index: %1").arg(e.what()));
+        }
+    }
+
     try {
-        if (settings().warnOnUnpushedCommits || settings().warnOnUnmergedCommits)
+        if ((settings.warnOnUnpushedCommits || settings.warnOnUnmergedCommits) && phases.testFlag(CheckPhase::Head))
             stats.head_ahead_behind = repo.head_ahead_behind();
     }
     catch (std::exception const& e) {
@@ -146,26 +510,121 @@ Repo::check_result_t Repo::check()
     }
 
     try {
-        if (settings().warnOnUnpushedCommits || settings().warnOnUnmergedCommits)
-            stats.total_ahead_behind = repo.total_ahead_behind();
+        if ((settings.warnOnUnpushedCommits || settings.warnOnUnmergedCommits) && phases.testFlag(CheckPhase::Branches)) {
+            // the branches are shared by all worktrees, so another worktree may already have computed this.
+            // the digest is computed before reading the branches, so that concurrent changes are picked up by the next check
+            RepoGroupCache::Lock group = RepoGroupCache::instance().lock(commonDir);
+            QByteArray const refs_digest = RepoFingerprint::refsDigest(commonDir);
+            bool const same_filter = (group->totalBranchFilter == branch_filter_key);
+
+            // With recency pruning, inactive branches are only walked in a periodic full sweep.
+            // In between, each of them contributes its counts from the sweep (see git::repository::total_ahead_behind()).
+            // These are kept in the group cache, which starts empty, so the first check of the process sweeps.
+            bool const sweep = pruning
+                && (!group->fullSweepTimestamp.isValid() || group->fullSweepBranchFilter != sweep_filter_key
+                    || group->fullSweepTimestamp.msecsTo(stats.timestamp) >= context.fullSweepInterval.count());
+
+            if (group->totalAheadBehind && group->refsDigest == refs_digest && same_filter && !sweep) {
+                stats.total_ahead_behind = group->totalAheadBehind;
+                stats.inactive_ahead_behind = group->inactiveAheadBehind;
+                stats.branch_counts = group->branchCounts;
+                stats.full_sweep_timestamp = group->fullSweepTimestamp;
+            }
+            else {
+                git::branch_filter filter = branch_filter;
+                filter.skip_inactive = !sweep;
+                git::branch_counts counts;
+                git::ahead_behind_t inactive_ab;
+                stats.total_ahead_behind = repo.total_ahead_behind(filter, &counts, &inactive_ab, &group->aheadBehindCache);
+                stats.branch_counts = counts;
+                if (sweep) {
+                    group->fullSweepTimestamp = stats.timestamp;
+                    group->fullSweepBranchFilter = sweep_filter_key;
+                }
+                if (pruning) {
+                    stats.inactive_ahead_behind = inactive_ab;
+                    stats.full_sweep_timestamp = group->fullSweepTimestamp;
+                }
+                group->refsDigest = refs_digest;
+                group->totalBranchFilter = branch_filter_key;
+                group->totalAheadBehind = stats.total_ahead_behind;
+                group->inactiveAheadBehind = stats.inactive_ahead_behind;
+                group->branchCounts = stats.branch_counts;
+            }
+        }
     }
     catch (std::exception const& e) {
         errors.push_back(tr("Unable to check total ahead/behind: %1").arg(e.what()));
     }
 
+    if (settings.warnOnUnfetchedCommits && !check_remote) {
+        // carry over the remote state of the previous check
+        stats.head_state = previous.head_state;
+        stats.branches_outdated = previous.branches_outdated;
+        stats.remote_timestamp = previous.remote_timestamp;
+        // the upstreams may have been fetched since, so the states are derived again from the commits the remotes advertised
+        try {
+            RepoGroupCache::Lock group = RepoGroupCache::instance().lock(commonDir);
+            if (group->remoteState && group->remoteBranchFilter == branch_filter_key) {
+                repo.refresh_remote_state(*group->remoteState, branch_filter);
+                stats.head_state = head_branch ? group->remoteState->state_of(*head_branch) : git::branch_state::unknown;
+                stats.branches_outdated = group->remoteState->branches_outdated;
+            }
+        }
+        catch (std::exception const& e) {
+            errors.push_back(tr("Unable to update remote state: %1").arg(e.what()));
+        }
+    }
+
     try {
-        if (settings().warnOnUnfetchedCommits) {
-            auto acquire_credentials = [this, &errors](char const* url, char const* username_from_url) -> std::optional<git::credential> {
-                return this->acquireCredentials(url, errors);
-            };
-            auto remote_state = repo.check_remote_state(std::move(acquire_credentials));
-            stats.head_state = remote_state.head_state;
-            if (remote_state.errors.empty()) {
-                // we only take the value if there were no errors, to avoid showing "OK" when in error state.
-                stats.branches_outdated = remote_state.branches_outdated;
+        if (check_remote) {
+            RepoGroupCache::Lock group = RepoGroupCache::instance().lock(commonDir);
+            // inactive branches are only compared with the remote in a periodic full sweep, like in the ahead/behind computation
+            bool const sweep = pruning
+                && (!group->remoteFullSweepTimestamp.isValid() || group->remoteFullSweepBranchFilter != sweep_filter_key
+                    || group->remoteFullSweepTimestamp.msecsTo(stats.timestamp) >= context.fullSweepInterval.count());
+            // another worktree of the same repository may have queried the remotes recently
+            bool const group_fresh = group->remoteState.has_value()
+                && group->remoteBranchFilter == branch_filter_key
+                && group->remoteTimestamp.msecsTo(stats.timestamp) < context.remoteInterval.count() * 9 / 10
+                && !sweep;
+            if (group_fresh) {
+                repo.refresh_remote_state(*group->remoteState, branch_filter);
+                stats.head_state = head_branch ? group->remoteState->state_of(*head_branch) : git::branch_state::unknown;
+                stats.branches_outdated = group->remoteState->branches_outdated;
+                stats.remote_timestamp = group->remoteTimestamp;
+                result.remoteUrls = toStringList(group->remoteState->urls);
+            }
+            else {
+                git::branch_filter remote_filter = branch_filter;
+                remote_filter.skip_inactive = !sweep;
+                auto acquire_credentials = [&errors](char const* url, char const* username_from_url) -> std::optional<git::credential> {
+                    return acquireCredentials(url, errors);
+                };
+                std::vector<std::string> skip_urls;
+                for (QString const& url : context.skipRemoteUrls)
+                    skip_urls.push_back(url.toStdString());
+                // the commits advertised in the previous query are kept for the remotes and branches that are not queried now
+                git::remote_state_t const* previous_state = group->remoteState ? &*group->remoteState : nullptr;
+                auto remote_state = repo.check_remote_state(std::move(acquire_credentials), remote_filter, previous_state, skip_urls);
+                stats.head_state = remote_state.head_state;
+                if (remote_state.errors.empty()) {
+                    // we only take the value if there were no errors, to avoid showing "OK" when in error state.
+                    stats.branches_outdated = remote_state.branches_outdated;
+                    // on errors, the remote state will be queried again in the next check
+                    stats.remote_timestamp = stats.timestamp;
+                    result.remoteUrls = toStringList(remote_state.urls);
+                    group->remoteTimestamp = stats.timestamp;
+                    group->remoteBranchFilter = branch_filter_key;
+                    group->remoteState = remote_state;
+                    if (sweep) {
+                        group->remoteFullSweepTimestamp = stats.timestamp;
+                        group->remoteFullSweepBranchFilter = sweep_filter_key;
+                    }
+                }
+                for (auto const& error : remote_state.errors)
+                    errors.push_back(tr("Error checking remote state: %1").arg(QString::fromStdString(error)));
             }
-            for (auto const& error : remote_state.errors)
-                errors.push_back(tr("Error checking remote state: %1").arg(QString::fromStdString(error)));
         }
     }
     catch (std::exception const& e) {
@@ -176,7 +635,8 @@ Repo::check_result_t Repo::check()
     QThread::sleep(1);  // sleep for 1 second to simulate a long-running operation
 #endif
 
-    return {stats, errors};
+    stats.duration = std::chrono::milliseconds(elapsed.elapsed());
+    return result;
 }
 
 // TODO: git-credential may show a GUI dialog to ask for credentials. We should avoid that during background checking.
@@ -186,7 +646,7 @@ std::optional<git::credential> Repo::acquireCredentials(char const* url, QList<Q
     qDebug() << "acquireCredentials called with url:" << url;
 
     QProcess git_credential;
-    connect(&git_credential, &QProcess::errorOccurred, this, [this, &errors](QProcess::ProcessError error) {
+    connect(&git_credential, &QProcess::errorOccurred, [&errors](QProcess::ProcessError error) {
         errors.push_back(tr("git-credential process error: %1").arg(error));
     });
     git_credential.setProcessChannelMode(QProcess::ForwardedErrorChannel);
@@ -238,29 +698,133 @@ void Repo::checkCompleted()
         return;  // the canceller should reset the activity to Idle
 
     qDebug() << "Completed check for repository " << m_settings.path;
-    auto [stats, errors] = m_check_watcher.result();
+    check_result_t const result = m_check_watcher.result();
+    m_check_count += 1;
+    // checks run one after the other
+    m_last_completed_check = m_started_check_count;
+
+    auto const& stats = result.statistics;
+    auto const& errors = result.errors;
     m_statistics = stats;
-    dropOldErrors(stats.timestamp);  // use the timestamp of the current check as base
+    m_status = statusOf(result);
+    if (result.fingerprint.isValid())
+        m_fingerprint = result.fingerprint;
+    if (!errors.isEmpty())
+        m_failed_check_count += 1;
+    if (result.remoteUrls) {
+        m_remote_urls = *result.remoteUrls;
+        for (auto it = m_pushed_remotes.begin(); it != m_pushed_remotes.end(); ++it) {
+            if (!m_skipped_remote_urls.contains(it.key()))
+                it->lastQuery = stats.remote_timestamp;
+        }
+    }
+    // drop errors older than 1 hour; use the timestamp of the current check as base
+    m_errors.dropOlderThan(stats.timestamp.addSecs(-3600));
 
     if (!errors.isEmpty()) {
-        m_status = RepoStatus::Error;
         qDebug() << "Errors while checking repository " << m_settings.path << ":";
         for (auto const& error : errors) {
             qDebug() << "Error:" << error;
-            m_errors.push_back({m_statistics.timestamp, error});
+            m_errors.add(error, m_statistics.timestamp);
         }
-        deduplicateErrors();
-    }
-    else {
-        m_status = stats.isOk() ? RepoStatus::Ok : RepoStatus::DirtyOrOutdated;
     }
 
     setActivity(RepoActivity::Idle);
 
     // reset interval until next check
     m_recheck_timer->setInterval(m_recheck_interval);
+    // restart the timer since requestCheck() may have been called in-between timeouts
+    m_recheck_timer->start();
+    if (m_pending_phases)
+        m_partial_check_timer->start();
 
     emit changed();
+    emit checkFinished();
+}
+
+// NOTE: this function runs in a separate thread
+std::optional<RemoteUpdateResult> Repo::applyRemoteUpdate(RepoSettings const& settings, RemoteUpdate const& update)
+{
+    try {
+        git::repository repo = git::repository::open(settings.path.toStdString().c_str());
+        std::optional<std::string> const head_branch = repo.head_branch_name();
+        QString const branch_filter_key = RepoGroupCache::branchFilterKey(settings, head_branch ? QString::fromStdString(*head_branch) : QString());
+        RepoGroupCache::Lock group = RepoGroupCache::instance().lock(QString::fromUtf8(repo.commondir()));
+        // without a previous query, the states of the other branches are unknown; the next check queries the remote anyway
+        if (!group->remoteState || group->remoteBranchFilter != branch_filter_key)
+            return std::nullopt;
+
+        // the same branches as in check()
+        git::branch_filter branch_filter = settings.branchFilter();
+        if (settings.inactiveBranchDays > 0)
+            branch_filter.active_since = QDateTime::currentDateTime().addDays(-settings.inactiveBranchDays).toSecsSinceEpoch();
+        git::remote_state_t state = *group->remoteState;
+        if (!repo.update_remote_state(state, update.url.toStdString(), update.ref.toStdString(), update.id, branch_filter))
+            return std::nullopt;
+        group->remoteState = state;
+
+        RemoteUpdateResult result;
+        if (head_branch)
+            result.head_state = state.state_of(*head_branch);
+        result.branches_outdated = state.branches_outdated;
+        return result;
+    }
+    catch (std::exception const& e) {
+        qDebug() << "Unable to apply push notification to repository " << settings.path << ":" << e.what();
+        return std::nullopt;
+    }
+}
+
+RepoStatus Repo::statusOf(check_result_t const& result)
+{
+    if (!result.errors.isEmpty())
+        return RepoStatus::Error;
+    return result.statistics.isOk() ? RepoStatus::Ok : RepoStatus::DirtyOrOutdated;
+}
+
+RepoCachedState Repo::cachedState() const
+{
+    return RepoCachedState{
+        .status = m_status,
+        .statistics = m_statistics,
+        .errors = m_errors.entries(),
+        .fingerprint = m_fingerprint,
+    };
+}
+
+void Repo::restoreState(RepoCachedState state)
+{
+    Q_ASSERT(!m_enabled);
+    m_status = state.status;
+    m_statistics = std::move(state.statistics);
+    m_errors.clear();
+    for (RepoCheckError& e : state.errors)
+        m_errors.add(std::move(e));
+    m_fingerprint = std::move(state.fingerprint);
+    // only a successful check may be skipped, errors should be retried
+    m_restored = (m_status != RepoStatus::Unknown && m_status != RepoStatus::Error);
+    emit changed();
+}
+
+QString repoActivityName(RepoActivity activity)
+{
+    switch (activity) {
+        case RepoActivity::Idle:     return QStringLiteral("idle");
+        case RepoActivity::Waiting:  return QStringLiteral("waiting");
+        case RepoActivity::Checking: return QStringLiteral("checking");
+    }
+    return QStringLiteral("invalid");
+}
+
+QString repoStatusName(RepoStatus status)
+{
+    switch (status) {
+        case RepoStatus::Unknown:         return QStringLiteral("unknown");
+        case RepoStatus::Ok:              return QStringLiteral("ok");
+        case RepoStatus::DirtyOrOutdated: return QStringLiteral("dirty");
+        case RepoStatus::Error:           return QStringLiteral("error");
+    }
+    return QStringLiteral("invalid");
 }
 
 bool RepoStatistics::isOk() const
@@ -286,31 +850,68 @@ bool RepoStatistics::isOk() const
     return true;
 }
 
-void Repo::dropOldErrors(QDateTime const& now)
+QJsonObject RepoStatistics::toJsonObject() const
 {
-    // drop errors older than 1 hour
-    auto it = std::remove_if(m_errors.begin(), m_errors.end(),
-        [&now](auto const &error) { return error.timestamp.secsTo(now) > 3600; });
-    m_errors.erase(it, m_errors.end());
+    auto ahead_behind_json = [](git::ahead_behind_t const& ab) {
+        return QJsonObject{
+            {"ahead", qint64(ab.ahead)},
+            {"behind", qint64(ab.behind)},
+        };
+    };
+
+    QJsonObject obj;
+    obj["timestamp"] = timestamp.toString(Qt::ISODateWithMs);
+    obj["duration_ms"] = qint64(duration.count());
+    obj["status_duration_ms"] = qint64(status_duration.count());
+    if (index_refresh_timestamp.isValid()) {
+        obj["index_refresh_timestamp"] = index_refresh_timestamp.toString(Qt::ISODateWithMs);
+        obj["status_duration_before_refresh_ms"] = qint64(status_duration_before_refresh.count());
+    }
+    if (uncommitted)
+        obj["uncommitted"] = qint64(*uncommitted);
+    if (head_ahead_behind)
+        obj["head"] = ahead_behind_json(*head_ahead_behind);
+    if (total_ahead_behind)
+        obj["branches"] = ahead_behind_json(*total_ahead_behind);
+    if (inactive_ahead_behind)
+        obj["inactive_branches"] = ahead_behind_json(*inactive_ahead_behind);
+    if (branch_counts) {
+        obj["branches_total"] = qint64(branch_counts->total);
+        obj["branches_monitored"] = qint64(branch_counts->monitored);
+        obj["branches_inactive"] = qint64(branch_counts->inactive);
+    }
+    if (full_sweep_timestamp.isValid())
+        obj["full_sweep_timestamp"] = full_sweep_timestamp.toString(Qt::ISODateWithMs);
+    obj["head_state"] = QString::fromStdString(fmt::format("{}", head_state));
+    if (remote_timestamp.isValid())
+        obj["remote_timestamp"] = remote_timestamp.toString(Qt::ISODateWithMs);
+    if (branches_outdated)
+        obj["branches_outdated"] = qint64(*branches_outdated);
+    return obj;
 }
 
-void Repo::deduplicateErrors()
+QJsonObject Repo::toJsonObject() const
 {
-    // error message -> timestamp of latest occurrence
-    QHash<QString, QDateTime> error_map;
-    for (auto const& e : m_errors) {
-        auto it = error_map.find(e.message);
-        if (it == error_map.end())
-            error_map.insert(e.message, e.timestamp);
-        else if (e.timestamp > it.value())
-            it.value() = e.timestamp;
-    }
-
-    // drop all earlier duplicate messages from the error list
-    auto it = std::remove_if(m_errors.begin(), m_errors.end(),
-        [&error_map](auto const &e) {
-            Q_ASSERT(error_map.contains(e.message));
-            return e.timestamp < error_map.value(e.message);
-        });
-    m_errors.erase(it, m_errors.end());
+    QJsonObject obj;
+    obj["path"] = m_settings.path;
+    obj["enabled"] = m_enabled;
+    obj["status"] = repoStatusName(m_status);
+    obj["activity"] = repoActivityName(m_activity);
+    if (!m_waiting_for.isEmpty())
+        obj["waiting_for"] = m_waiting_for;
+    if (m_statistics.timestamp.isValid())
+        obj["statistics"] = m_statistics.toJsonObject();
+    if (!m_errors.isEmpty()) {
+        QJsonArray errors;
+        for (RepoCheckError const& e : m_errors.entries()) {
+            errors.push_back(QJsonObject{
+                {"timestamp", e.timestamp.toString(Qt::ISODateWithMs)},
+                {"first_timestamp", e.firstTimestamp.toString(Qt::ISODateWithMs)},
+                {"count", qint64(e.count)},
+                {"message", e.message},
+            });
+        }
+        obj["errors"] = errors;
+    }
+    return obj;
 }
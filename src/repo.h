@@ -1,19 +1,22 @@
 #ifndef REPO_H
 #define REPO_H
 
+#include "repoerrorlog.h"
+#include "repofingerprint.h"
 #include "reposettings.h"
 #include "git/repository.h"
 #include <QDateTime>
 #include <QFileSystemWatcher>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QHash>
+#include <QJsonObject>
 #include <QList>
 #include <QObject>
 #include <QString>
 #include <QTimer>
 #include <chrono>
 #include <optional>
-#include <utility>
 
 enum class RepoStatus {
     /// new and not yet checked, or checking disabled for this repo
@@ -30,12 +33,19 @@ enum class RepoStatus {
 enum class RepoActivity {
     /// doing nothing, waiting for timeout before re-checking
     Idle,
-    /// waiting for filesystem updates (via inotify) to quiesce for 2 seconds before re-checking
+    /// waiting for a git operation (e.g., anything holding index.lock, or a running rebase) to finish or stop for the user,
+    /// and then for the filesystem to quiesce for 2 seconds before re-checking
     Waiting,
     /// repo status is being checked
     Checking,
 };
 
+/// short machine-readable name of the status, e.g. for JSON output
+QString repoStatusName(RepoStatus status);
+
+/// short machine-readable name of the activity, e.g. for JSON output
+QString repoActivityName(RepoActivity activity);
+
 struct RepoStatistics {
     /// when the check was started
     QDateTime timestamp;
@@ -44,19 +54,105 @@ struct RepoStatistics {
     /// number of unpushed and unmerged commits on HEAD branch
     /// is empty if HEAD is detached or does not have a remote-tracking branch
     std::optional<git::ahead_behind_t> head_ahead_behind;
-    /// number of unpushed and unmerged commits across all branches
+    /// number of unpushed and unmerged commits across all monitored branches
     std::optional<git::ahead_behind_t> total_ahead_behind;
+    /// Part of total_ahead_behind contributed by inactive branches (see RepoSettings::inactiveBranchDays).
+    /// Inactive branches are walked in a periodic full sweep; in between, each contributes its counts from the sweep.
+    std::optional<git::ahead_behind_t> inactive_ahead_behind;
+    /// number of local branches, and how many of them are monitored (see RepoSettings::includeBranches) or inactive
+    std::optional<git::branch_counts> branch_counts;
+    /// when inactive branches were last included in the ahead/behind computation
+    QDateTime full_sweep_timestamp;
     /// whether HEAD's remote-tracking branch differs from the commit advertised by the remote repository
     git::branch_state head_state = git::branch_state::unknown;
     /// number of remote-tracking branches that differ from their remote repository
     std::optional<size_t> branches_outdated;
+    /// when the remote state (head_state, branches_outdated) was queried.
+    /// may be older than timestamp since the remote state is not queried in every check.
+    QDateTime remote_timestamp;
+    /// how long the check took
+    std::chrono::milliseconds duration{0};
+    /// how long counting the uncommitted changes took
+    std::chrono::milliseconds status_duration{0};
+    /// when the index was last refreshed (see RepoSettings::refreshIndexWhenIdle)
+    QDateTime index_refresh_timestamp;
+    /// status_duration of the check that refreshed the index, to compare with the checks after it
+    std::chrono::milliseconds status_duration_before_refresh{0};
 
     bool isOk() const;
+
+    QJsonObject toJsonObject() const;
 };
 
-struct RepoCheckError {
-    QDateTime timestamp;
-    QString message;
+struct RepoCheckResult {
+    RepoStatistics statistics;
+    /// check was successful if this is empty
+    QList<QString> errors;
+    RepoFingerprint fingerprint;
+    /// normalized fetch URLs of the remotes (see git::normalized_url()), if the remote state was queried
+    std::optional<QList<QString>> remoteUrls;
+};
+
+/// Parts of a check that look at different state of the repository.
+/// A check limited to some phases carries over the results of the others from the previous check.
+enum class CheckPhase {
+    /// uncommitted changes (working directory and index)
+    Status = 1 << 0,
+    /// ahead/behind of the HEAD branch
+    Head = 1 << 1,
+    /// total ahead/behind across all monitored branches
+    Branches = 1 << 2,
+    All = Status | Head | Branches,
+};
+Q_DECLARE_FLAGS(CheckPhases, CheckPhase)
+Q_DECLARE_OPERATORS_FOR_FLAGS(CheckPhases)
+
+/// information about the previous check that allows to skip some work
+struct RepoCheckContext {
+    RepoStatistics previous;
+    RepoFingerprint fingerprint;
+    /// if the fingerprint did not change, only check the status and carry over the ahead/behind results.
+    /// The fingerprint only covers the top-level working directory, so it cannot tell whether the status changed.
+    bool skipRefsIfUnchanged = false;
+    /// the remote state of the previous check is reused unless it is older than this
+    std::chrono::milliseconds remoteInterval{0};
+    /// normalized fetch URLs of remotes that send push notifications;
+    /// they are not queried as long as the commits they advertise are known from a previous query
+    QList<QString> skipRemoteUrls;
+    /// inactive branches are skipped unless the last full sweep is older than this
+    std::chrono::milliseconds fullSweepInterval{0};
+    /// only determine whether there are uncommitted changes (statistics.uncommitted is 0 or 1),
+    /// which allows the native status engine to stop at the first change
+    bool quick = false;
+    /// the phases to perform; the remote state is queried independently of this, whenever it is due
+    CheckPhases phases = CheckPhase::All;
+};
+
+/// notification that a branch of a remote repository moved (see PushReceiver)
+struct RemoteUpdate {
+    /// URL of the remote repository, compared with the URLs of the remotes of the monitored repositories
+    QString url;
+    /// full name of the branch in the remote repository, e.g., "refs/heads/main"
+    QString ref;
+    /// new commit of the branch; zero if the branch was deleted
+    git::oid id;
+
+    /// url normalized like the URLs of the remotes (see git::normalized_url())
+    QString normalizedUrl() const;
+};
+
+/// remote state of a repository after applying a RemoteUpdate
+struct RemoteUpdateResult {
+    git::branch_state head_state = git::branch_state::unknown;
+    size_t branches_outdated = 0;
+};
+
+/// last known state of a repository, persisted across restarts (see RepoStateCache)
+struct RepoCachedState {
+    RepoStatus status = RepoStatus::Unknown;
+    RepoStatistics statistics;
+    QList<RepoCheckError> errors;
+    RepoFingerprint fingerprint;
 };
 
 class Repo : public QObject
@@ -65,6 +161,8 @@ class Repo : public QObject
 public:
     explicit Repo(size_t index, QObject* parent = nullptr);
 
+    using check_result_t = RepoCheckResult;
+
     RepoSettings const& settings() const;
     void updateSettings(RepoSettings new_settings);
 
@@ -80,31 +178,95 @@ public:
 
     RepoStatus status() const { return m_status; }
     RepoActivity activity() const { return m_activity; }
+    /// lock file or marker of the git operation the next check waits for (see RepoActivity::Waiting), or empty
+    QString const& waitingFor() const { return m_waiting_for; }
     RepoStatistics const& statistics() const { return m_statistics; }
-    QList<RepoCheckError> const& errors() const { return m_errors; }
+    /// errors reported during the last hour
+    RepoErrorLog const& errors() const { return m_errors; }
 
-private:
-    void reset();
-    void startCheck();
+    /// number of completed checks since the repo was created
+    quint64 checkCount() const { return m_check_count; }
+    /// number of completed checks that reported errors
+    quint64 failedCheckCount() const { return m_failed_check_count; }
+    /// number of checks started so far; the next check that starts is number startedCheckCount() + 1
+    quint64 startedCheckCount() const { return m_started_check_count; }
+    /// number of the last check that completed (see startedCheckCount()), or 0
+    quint64 lastCompletedCheck() const { return m_last_completed_check; }
+    /// number of check requests that were merged into an already running check
+    quint64 coalescedRequestCount() const { return m_coalesced_request_count; }
+    /// number of push notifications that updated the remote state
+    quint64 remoteUpdateCount() const { return m_remote_update_count; }
+    /// normalized fetch URLs of the remotes, known once the remote state was queried (see RepoCheckResult::remoteUrls)
+    QList<QString> const& remoteUrls() const { return m_remote_urls; }
+
+    /// Check the repository as soon as possible.
+    /// If a check is already running, no new check is started; checkFinished() is emitted when the running check completes.
+    void requestCheck();
+
+    /// Check the repository as soon as possible, with a check that starts after this call:
+    /// if a check is already running, another one starts after it has completed.
+    void requestRefresh();
+
+    /// Check the given phases of the repository soon, e.g., because a git hook reported a change (see HookListener).
+    /// Requests arriving within a short delay, or while a check is running, are merged into a single check afterwards.
+    void requestPartialCheck(CheckPhases phases);
+
+    /// Apply a push notification to the cached remote state in a background thread, without querying the remote.
+    /// Notifications for other repositories are ignored. Once a notification applied,
+    /// the remote it came from is queried much less often, as a consistency check only,
+    /// until it has not sent notifications for a while.
+    void applyRemoteUpdate(RemoteUpdate update);
+
+    /// Use a check of this repository that was started elsewhere (e.g., while validating its settings) as the next check,
+    /// instead of starting a new one. Ignored if the repo is disabled, already checking, or the future is empty.
+    void adoptCheck(QFuture<check_result_t> future);
+
+    /// current state of the repository (settings, status, statistics, errors)
+    QJsonObject toJsonObject() const;
+
+    /// state to persist across restarts
+    RepoCachedState cachedState() const;
 
-    /// check was successful if the second element of the pair is empty
-    using check_result_t = std::pair<RepoStatistics, QList<QString>>;
-    /// NOTE: do not call this directly, use startCheck() instead to perform the check in a background thread
-    check_result_t check();
+    /// Restore the state from a previous run; must be called while the repo is disabled.
+    /// The first check afterwards is skipped if the repository did not change on disk.
+    void restoreState(RepoCachedState state);
 
-    void dropOldErrors(QDateTime const& now);
-    void deduplicateErrors();
+    /// Check the repository with the given settings synchronously.
+    /// NOTE: this blocks for a long time (possibly network access), so Repo objects use startCheck() to perform the check in a background thread.
+    ///       It is safe to call this concurrently from multiple threads.
+    static check_result_t check(RepoSettings const& settings, RepoCheckContext const& context = {});
+
+    /// status corresponding to the result of a check
+    static RepoStatus statusOf(check_result_t const& result);
+
+    /// Update the remote state shared by the worktrees of the repository (see RepoGroupCache) synchronously.
+    /// Returns std::nullopt if the update does not concern the repository, or its remote state was not queried yet.
+    /// It is safe to call this concurrently from multiple threads.
+    static std::optional<RemoteUpdateResult> applyRemoteUpdate(RepoSettings const& settings, RemoteUpdate const& update);
+
+private:
+    void reset();
+    void startCheck(CheckPhases phases = CheckPhase::All);
 
     void setActivity(RepoActivity activity);
 
-    std::optional<git::credential> acquireCredentials(char const* url, QList<QString>& errors);
+    /// defer checking until the git operation has finished or stopped, watching the git directory and polling its marker
+    void waitForGitOperation(QString marker);
+    void stopWaitingForGitOperation();
+
+    static std::optional<git::credential> acquireCredentials(char const* url, QList<QString>& errors);
 
 private slots:
     void checkCompleted();
+    void gitDirChanged();
 
 signals:
     // void activityChanged();
     void changed();
+    /// emitted after a check has completed and the results have been stored
+    void checkFinished();
+    /// emitted when checking is disabled (e.g., to apply new settings); a running or requested check does not complete then
+    void checkCancelled();
 
 private:
     size_t m_index;  //< index in the RepoManager
@@ -113,15 +275,44 @@ private:
     RepoStatus m_status = RepoStatus::Unknown;
     RepoActivity m_activity = RepoActivity::Idle;
     RepoStatistics m_statistics;
+    RepoFingerprint m_fingerprint;
+    /// state was restored and has not been checked yet
+    bool m_restored = false;
 
     bool m_enabled = false;
 
     std::chrono::milliseconds m_recheck_interval = std::chrono::minutes(5);
+    std::chrono::milliseconds m_remote_check_interval = std::chrono::minutes(5);
+    std::chrono::milliseconds m_full_sweep_interval = std::chrono::hours(24);
     QTimer* m_recheck_timer = nullptr;
+    /// phases requested by requestPartialCheck() that have not been checked yet
+    CheckPhases m_pending_phases;
+    QTimer* m_partial_check_timer = nullptr;
 
+    /// watches the git directory while waiting for a git operation; created on first use
     QFileSystemWatcher* m_watcher = nullptr;
+    QString m_waiting_for;
+
+    RepoErrorLog m_errors;
+
+    quint64 m_check_count = 0;
+    quint64 m_started_check_count = 0;
+    quint64 m_last_completed_check = 0;
+    quint64 m_failed_check_count = 0;
+    quint64 m_coalesced_request_count = 0;
+    quint64 m_remote_update_count = 0;
 
-    QList<RepoCheckError> m_errors;
+    /// a remote that sent push notifications
+    struct PushedRemote {
+        QDateTime lastPush;
+        /// when the remote was last queried nevertheless
+        QDateTime lastQuery;
+    };
+    /// by normalized URL
+    QHash<QString, PushedRemote> m_pushed_remotes;
+    /// the remotes the running check does not query (see RepoCheckContext::skipRemoteUrls)
+    QList<QString> m_skipped_remote_urls;
+    QList<QString> m_remote_urls;
 
     QFuture<check_result_t> m_check_future;
     QFutureWatcher<check_result_t> m_check_watcher;
@@ -0,0 +1,265 @@
+#include "repodiscovery.h"
+#include "settings.h"
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScopeGuard>
+#include <QThread>
+#include <atomic>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct RepoDiscovery::State {
+    std::atomic<bool> cancelled = false;
+    /// number of directories that are queued or being scanned
+    std::atomic<qsizetype> pending = 0;
+    std::atomic<qsizetype> directoriesScanned = 0;
+
+    QMutex mutex;
+    QList<RepoSettings> repos;  // protected by mutex
+
+    /// snapshot of the configuration, so that the workers do not access the RepoDiscovery object
+    QSet<QString> ignoredNames;
+    int maxDepth = 0;
+};
+
+namespace {
+
+    enum class EntryKind {
+        other,
+        directory,
+        git,  // .git directory or file (the latter for linked worktrees and submodules)
+    };
+
+    /// build output and dependencies, which may contain clones that are not worth monitoring
+    inline QStringList const k_defaultIgnoredNames = {"node_modules", "__pycache__", ".cache", ".venv", "venv", ".tox", "target", "_build", "build", "dist", "vendor"};
+
+    EntryKind entryKind(int dir_fd, dirent const* entry)
+    {
+        bool const is_git = (std::strcmp(entry->d_name, ".git") == 0);
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            // some file systems do not report the type
+            struct stat st;
+            if (fstatat(dir_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                return EntryKind::other;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+        }
+        if (is_git && (type == DT_DIR || type == DT_REG))
+            return EntryKind::git;
+        if (type == DT_DIR)
+            return EntryKind::directory;
+        return EntryKind::other;
+    }
+
+    /// heuristic for bare repositories: HEAD file, objects and refs directories
+    bool looksLikeBareRepository(int dir_fd)
+    {
+        struct stat st;
+        return fstatat(dir_fd, "HEAD", &st, 0) == 0 && S_ISREG(st.st_mode)
+            && fstatat(dir_fd, "objects", &st, 0) == 0 && S_ISDIR(st.st_mode)
+            && fstatat(dir_fd, "refs", &st, 0) == 0 && S_ISDIR(st.st_mode);
+    }
+
+}
+
+RepoDiscovery::RepoDiscovery(QObject* parent)
+    : QObject{parent}
+{
+    // scanning is dominated by I/O latency rather than CPU, so we use more threads than cores
+    m_pool.setMaxThreadCount(std::max(4, 2 * QThread::idealThreadCount()));
+
+    m_rescanTimer = new QTimer(this);
+    connect(m_rescanTimer, &QTimer::timeout, this, &RepoDiscovery::start);
+
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(std::chrono::milliseconds(250));
+    connect(m_progressTimer, &QTimer::timeout, this, [this]() {
+        if (!m_state)
+            return;
+        qsizetype found = 0;
+        {
+            QMutexLocker lock(&m_state->mutex);
+            found = m_state->repos.size();
+        }
+        emit progress(m_state->directoriesScanned.load(), found);
+    });
+
+    // addRoot() writes the settings, which must not replace the stored ones with defaults
+    loadSettings();
+}
+
+RepoDiscovery::~RepoDiscovery()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void RepoDiscovery::setRoots(QList<QString> roots)
+{
+    m_roots = std::move(roots);
+}
+
+void RepoDiscovery::addRoot(QString const& root)
+{
+    QString const path = QDir::cleanPath(QDir(root).absolutePath());
+    if (m_roots.contains(path))
+        return;
+    m_roots.push_back(path);
+    writeSettings();
+}
+
+void RepoDiscovery::setRescanInterval(std::chrono::minutes interval)
+{
+    m_rescanInterval = interval;
+    if (interval.count() <= 0) {
+        m_rescanTimer->stop();
+        return;
+    }
+    m_rescanTimer->start(interval);
+}
+
+void RepoDiscovery::loadSettings()
+{
+    QSettings settings;
+    m_roots = settings.value(Settings::Discovery::Roots).toStringList();
+    QStringList const ignoredNames = settings.value(Settings::Discovery::IgnoredNames, k_defaultIgnoredNames).toStringList();
+    m_ignoredNames = QSet<QString>(ignoredNames.begin(), ignoredNames.end());
+    m_rescanInterval = std::chrono::minutes(settings.value(Settings::Discovery::RescanIntervalMinutes, 60).toInt());
+}
+
+void RepoDiscovery::readSettings()
+{
+    loadSettings();
+    setRescanInterval(m_rescanInterval);
+}
+
+void RepoDiscovery::writeSettings() const
+{
+    QSettings settings;
+    settings.setValue(Settings::Discovery::Roots, QStringList(m_roots));
+    settings.setValue(Settings::Discovery::RescanIntervalMinutes, int(m_rescanInterval.count()));
+    // the ignored names are only edited in the settings file, so the default applies until they are set there
+}
+
+void RepoDiscovery::start()
+{
+    if (m_state || m_roots.isEmpty())
+        return;
+
+    qDebug() << "RepoDiscovery: scanning" << m_roots;
+    auto state = std::make_shared<State>();
+    state->ignoredNames = m_ignoredNames;
+    state->maxDepth = m_maxDepth;
+    m_state = state;
+    m_progressTimer->start();
+
+    state->pending += 1;  // guards against finishing before all roots are queued
+    for (QString const& root : m_roots) {
+        QByteArray const path = QFile::encodeName(root);
+        struct stat st;
+        if (::stat(path.constData(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            qDebug() << "RepoDiscovery: skipping invalid root" << root;
+            continue;
+        }
+        state->pending += 1;
+        m_pool.start([this, state, path, root_dev = st.st_dev]() { scanDirectory(state, path, root_dev, 0); });
+    }
+    if (--state->pending == 0)
+        onScanFinished(state);
+}
+
+void RepoDiscovery::cancel()
+{
+    if (m_state)
+        m_state->cancelled = true;
+}
+
+// NOTE: this function runs in a worker thread
+void RepoDiscovery::scanDirectory(std::shared_ptr<State> const& state, QByteArray path, dev_t root_dev, int depth)
+{
+    auto done = qScopeGuard([this, &state]() {
+        if (--state->pending == 0) {
+            QMetaObject::invokeMethod(this, [this, state]() { onScanFinished(state); }, Qt::QueuedConnection);
+        }
+    });
+
+    if (state->cancelled)
+        return;
+    state->directoriesScanned += 1;
+
+    int const dir_fd = ::open(path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0)
+        return;
+    DIR* dir = fdopendir(dir_fd);
+    if (!dir) {
+        ::close(dir_fd);
+        return;
+    }
+    auto closeDir = qScopeGuard([dir]() { closedir(dir); });
+
+    QList<QByteArray> subdirs;
+    bool is_repo = false;
+    while (dirent const* entry = readdir(dir)) {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+        EntryKind const kind = entryKind(dir_fd, entry);
+        if (kind == EntryKind::git) {
+            is_repo = true;
+            break;
+        }
+        if (kind != EntryKind::directory)
+            continue;
+        if (depth >= state->maxDepth)
+            continue;
+        if (state->ignoredNames.contains(QString::fromUtf8(entry->d_name)))
+            continue;
+        struct stat st;
+        if (fstatat(dir_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            continue;
+        if (st.st_dev != root_dev)
+            continue;  // mount point
+        subdirs.push_back(path + '/' + entry->d_name);
+    }
+
+    if (is_repo || looksLikeBareRepository(dir_fd)) {
+        RepoSettings rs;
+        rs.path = QFile::decodeName(path);
+        QList<QString> const errors = rs.validate();
+        if (errors.isEmpty()) {
+            QMutexLocker lock(&state->mutex);
+            state->repos.push_back(std::move(rs));
+        }
+        else
+            qDebug() << "RepoDiscovery: ignoring" << rs.path << ":" << errors;
+        return;  // do not descend into repositories
+    }
+
+    state->pending += subdirs.size();
+    for (QByteArray& subdir : subdirs) {
+        m_pool.start([this, state, subdir = std::move(subdir), root_dev, depth]() mutable {
+            scanDirectory(state, std::move(subdir), root_dev, depth + 1);
+        });
+    }
+}
+
+void RepoDiscovery::onScanFinished(std::shared_ptr<State> const& state)
+{
+    if (m_state != state)
+        return;
+    m_state.reset();
+    m_progressTimer->stop();
+
+    if (state->cancelled) {
+        qDebug() << "RepoDiscovery: cancelled";
+        return;
+    }
+
+    qDebug() << "RepoDiscovery: scanned" << state->directoriesScanned.load() << "directories and found" << state->repos.size() << "repositories";
+    emit progress(state->directoriesScanned.load(), state->repos.size());
+    emit finished(state->repos);
+}
@@ -0,0 +1,79 @@
+#ifndef REPODISCOVERY_H
+#define REPODISCOVERY_H
+
+#include "reposettings.h"
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <chrono>
+#include <memory>
+#include <sys/types.h>
+
+/// Finds git repositories below a set of root directories.
+///
+/// Directories are scanned in parallel; the scan does not descend into repositories (i.e., it stops at .git boundaries),
+/// ignored directories (see ignoredNames()), symbolic links, and other file systems (mount points).
+/// Candidates are validated in the worker threads as soon as they are found.
+class RepoDiscovery : public QObject
+{
+    Q_OBJECT
+public:
+    /// the roots, ignored names and rescan interval are read from the settings
+    explicit RepoDiscovery(QObject* parent = nullptr);
+    ~RepoDiscovery();
+
+    QList<QString> const& roots() const { return m_roots; }
+    void setRoots(QList<QString> roots);
+    /// Adds the root (if not yet present) and stores the list of roots in the settings.
+    void addRoot(QString const& root);
+
+    /// Directory names that are never scanned, e.g., build output and dependencies that may contain clones of other repositories.
+    /// Stored in the settings (Settings::Discovery::IgnoredNames); the default is used if they are not set.
+    QSet<QString> const& ignoredNames() const { return m_ignoredNames; }
+    void setIgnoredNames(QSet<QString> names) { m_ignoredNames = std::move(names); }
+
+    /// Rescan the roots periodically to pick up new clones (zero disables periodic rescans).
+    void setRescanInterval(std::chrono::minutes interval);
+
+    /// Read the roots, ignored names and rescan interval again, and start the periodic rescans.
+    void readSettings();
+    /// store the roots and rescan interval
+    void writeSettings() const;
+
+    bool isRunning() const { return static_cast<bool>(m_state); }
+
+public slots:
+    /// Scan all roots. Does nothing if a scan is already running.
+    void start();
+    void cancel();
+
+signals:
+    /// emitted when a scan completes with the valid repositories that have been found
+    void finished(QList<RepoSettings> repos);
+    /// emitted periodically during a scan
+    void progress(qsizetype directoriesScanned, qsizetype reposFound);
+
+private:
+    void loadSettings();
+
+    struct State;
+    /// root_dev is the device of the root directory of this scan, used to detect mount points
+    void scanDirectory(std::shared_ptr<State> const& state, QByteArray path, dev_t root_dev, int depth);
+    void onScanFinished(std::shared_ptr<State> const& state);
+
+private:
+    QList<QString> m_roots;
+    QSet<QString> m_ignoredNames;
+    int m_maxDepth = 8;
+    std::chrono::minutes m_rescanInterval{0};
+
+    QThreadPool m_pool;
+    std::shared_ptr<State> m_state;
+    QTimer* m_rescanTimer = nullptr;
+    QTimer* m_progressTimer = nullptr;
+};
+
+#endif // REPODISCOVERY_H
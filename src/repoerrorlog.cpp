@@ -0,0 +1,142 @@
+#include "repoerrorlog.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <utility>
+
+namespace {
+
+    struct MessagePool {
+        QMutex mutex;
+        QSet<QString> messages;
+        /// size of the pool after the last purge
+        qsizetype purgedSize = 0;
+    };
+
+    MessagePool& messagePool()
+    {
+        static MessagePool pool;
+        return pool;
+    }
+
+    /// number of new messages after which the pool is purged of messages that are no longer used
+    inline constexpr qsizetype k_purgeThreshold = 256;
+
+}
+
+QString RepoErrorLog::intern(QString const& message)
+{
+    MessagePool& pool = messagePool();
+    QMutexLocker locker(&pool.mutex);
+
+    auto it = pool.messages.constFind(message);
+    if (it != pool.messages.cend())
+        return *it;
+
+    if (pool.messages.size() >= pool.purgedSize + k_purgeThreshold) {
+        // messages that are only referenced by the pool itself are not used by any log
+        pool.messages.removeIf([](QString const& m) { return m.isDetached(); });
+        pool.purgedSize = pool.messages.size();
+    }
+    return *pool.messages.insert(message);
+}
+
+void RepoErrorLog::add(QString const& message, QDateTime const& timestamp)
+{
+    RepoCheckError error;
+    auto it = m_index.constFind(message);
+    if (it != m_index.cend()) {
+        // mark the previous entry as dead, and move it to the front
+        RepoCheckError& previous = m_slots[it.value()];
+        error = std::exchange(previous, RepoCheckError{.count = 0});
+        error.count += 1;
+        m_index.erase(it);
+    }
+    else {
+        error.message = intern(message);
+        error.firstTimestamp = timestamp;
+    }
+    error.timestamp = timestamp;
+    push(std::move(error));
+}
+
+void RepoErrorLog::add(RepoCheckError error)
+{
+    if (error.count == 0)
+        return;
+    auto it = m_index.constFind(error.message);
+    if (it != m_index.cend()) {
+        m_slots[it.value()] = RepoCheckError{.count = 0};
+        m_index.erase(it);
+    }
+    error.message = intern(error.message);
+    push(std::move(error));
+}
+
+void RepoErrorLog::push(RepoCheckError error)
+{
+    while (m_used > 0 && isDead(m_slots[m_tail]))
+        dropTail();
+    // a live entry is only dropped if there are no dead slots left
+    if (m_used == Capacity && m_index.size() < Capacity)
+        compact();
+    if (m_used == Capacity)
+        dropTail();
+    qsizetype const s = slot(m_used);
+    m_index.insert(error.message, s);
+    m_slots[s] = std::move(error);
+    m_used += 1;
+}
+
+void RepoErrorLog::dropTail()
+{
+    Q_ASSERT(m_used > 0);
+    RepoCheckError& entry = m_slots[m_tail];
+    if (!isDead(entry))
+        m_index.remove(entry.message);
+    entry = RepoCheckError{.count = 0};
+    m_tail = slot(1);
+    m_used -= 1;
+}
+
+void RepoErrorLog::compact()
+{
+    qsizetype kept = 0;
+    for (qsizetype i = 0; i < m_used; ++i) {
+        qsizetype const from = slot(i);
+        if (isDead(m_slots[from]))
+            continue;
+        qsizetype const to = slot(kept);
+        if (to != from) {
+            m_slots[to] = std::exchange(m_slots[from], RepoCheckError{.count = 0});
+            m_index[m_slots[to].message] = to;
+        }
+        kept += 1;
+    }
+    m_used = kept;
+}
+
+void RepoErrorLog::dropOlderThan(QDateTime const& limit)
+{
+    while (m_used > 0 && (isDead(m_slots[m_tail]) || m_slots[m_tail].timestamp < limit))
+        dropTail();
+}
+
+void RepoErrorLog::clear()
+{
+    while (m_used > 0)
+        dropTail();
+    m_tail = 0;
+}
+
+QList<RepoCheckError> RepoErrorLog::entries() const
+{
+    QList<RepoCheckError> result;
+    result.reserve(m_index.size());
+    for (qsizetype i = 0; i < m_used; ++i) {
+        RepoCheckError const& entry = m_slots[slot(i)];
+        if (!isDead(entry))
+            result.push_back(entry);
+    }
+    return result;
+}
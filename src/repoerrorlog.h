@@ -0,0 +1,73 @@
+#ifndef REPOERRORLOG_H
+#define REPOERRORLOG_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <array>
+
+struct RepoCheckError {
+    /// last occurrence
+    QDateTime timestamp;
+    QString message;
+    /// first occurrence
+    QDateTime firstTimestamp;
+    /// number of occurrences
+    quint32 count = 1;
+};
+
+/// Recent errors of a repository, with repeated messages merged into a single entry.
+///
+/// The entries are kept in a ring of fixed capacity ordered by their last occurrence,
+/// so that adding an error and dropping old errors does not depend on the length of the history.
+/// Messages are interned, i.e., repos that fail with the same message share a single copy of it.
+class RepoErrorLog
+{
+public:
+    inline static constexpr qsizetype Capacity = 16;
+
+    /// Record an occurrence of the message.
+    /// If the log is full, the entry with the oldest last occurrence is dropped.
+    void add(QString const& message, QDateTime const& timestamp);
+
+    /// Insert an entry as is, e.g., when restoring the log from the state cache.
+    /// Entries must be added in the order of their last occurrence.
+    void add(RepoCheckError error);
+
+    /// drop entries whose last occurrence is before the limit
+    void dropOlderThan(QDateTime const& limit);
+
+    void clear();
+
+    /// number of distinct messages
+    qsizetype size() const { return m_index.size(); }
+    bool isEmpty() const { return m_index.isEmpty(); }
+
+    /// the entries, from oldest to newest last occurrence
+    QList<RepoCheckError> entries() const;
+
+    /// shared copy of the message
+    static QString intern(QString const& message);
+
+private:
+    qsizetype slot(qsizetype position) const { return (m_tail + position) % Capacity; }
+    static bool isDead(RepoCheckError const& entry) { return entry.count == 0; }
+    void dropTail();
+    /// move the live entries together at the tail, keeping their order, so the dead slots are free again
+    void compact();
+    void push(RepoCheckError error);
+
+private:
+    /// Slots of entries that occurred again are not moved but marked as dead (count == 0);
+    /// they are reclaimed when they reach the tail, or by compacting when the ring is full.
+    std::array<RepoCheckError, Capacity> m_slots;
+    /// slot of the oldest entry
+    qsizetype m_tail = 0;
+    /// number of slots in use (including dead slots)
+    qsizetype m_used = 0;
+    /// message -> slot of its live entry
+    QHash<QString, qsizetype> m_index;
+};
+
+#endif // REPOERRORLOG_H
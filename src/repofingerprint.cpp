@@ -0,0 +1,91 @@
+#include "repofingerprint.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+
+namespace {
+
+    void addFileInfo(QCryptographicHash& hash, QString const& path)
+    {
+        QFileInfo const fi(path);
+        // the path is part of the digest so that the digest changes if a file appears or disappears
+        hash.addData(path.toUtf8());
+        if (!fi.exists()) {
+            hash.addData(QByteArrayView("\0-", 2));
+            return;
+        }
+        qint64 const data[] = {
+            fi.lastModified(QTimeZone::UTC).toMSecsSinceEpoch(),
+            fi.size(),
+        };
+        hash.addData(QByteArrayView(reinterpret_cast<char const*>(data), sizeof(data)));
+    }
+
+    /// Loose refs are updated by renaming a lock file, which updates the modification time of the containing directory.
+    void addRefDirectories(QCryptographicHash& hash, QString const& path)
+    {
+        addFileInfo(hash, path);
+        QDirIterator it(path, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            addFileInfo(hash, it.next());
+    }
+
+}
+
+RepoFingerprint RepoFingerprint::compute(QString gitDir, QString commonDir, QString workDir)
+{
+    QDir const git(gitDir);
+    QDir const common(commonDir);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    addFileInfo(hash, git.filePath("HEAD"));
+    addFileInfo(hash, git.filePath("index"));
+    addFileInfo(hash, git.filePath("logs/HEAD"));
+    addFileInfo(hash, git.filePath("config.worktree"));
+    addFileInfo(hash, common.filePath("config"));
+    addFileInfo(hash, common.filePath("packed-refs"));
+    addRefDirectories(hash, common.filePath("refs/heads"));
+    addRefDirectories(hash, common.filePath("refs/remotes"));
+    addRefDirectories(hash, common.filePath("logs/refs"));
+    // catches untracked files at the top level; changes to tracked files usually show up in the index only after `git add`
+    if (!workDir.isEmpty())
+        addFileInfo(hash, workDir);
+
+    RepoFingerprint fp;
+    fp.gitDir = std::move(gitDir);
+    fp.commonDir = std::move(commonDir);
+    fp.workDir = std::move(workDir);
+    fp.digest = hash.result();
+    return fp;
+}
+
+QByteArray RepoFingerprint::refsDigest(QString const& commonDir)
+{
+    QDir const common(commonDir);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    addFileInfo(hash, common.filePath("config"));
+    addFileInfo(hash, common.filePath("packed-refs"));
+    addRefDirectories(hash, common.filePath("refs/heads"));
+    addRefDirectories(hash, common.filePath("refs/remotes"));
+    return hash.result();
+}
+
+bool RepoFingerprint::operator==(RepoFingerprint const& other) const
+{
+    return digest == other.digest
+        && gitDir == other.gitDir
+        && commonDir == other.commonDir
+        && workDir == other.workDir;
+}
+
+QDataStream& operator<<(QDataStream& out, RepoFingerprint const& fp)
+{
+    return out << fp.gitDir << fp.commonDir << fp.workDir << fp.digest;
+}
+
+QDataStream& operator>>(QDataStream& in, RepoFingerprint& fp)
+{
+    return in >> fp.gitDir >> fp.commonDir >> fp.workDir >> fp.digest;
+}
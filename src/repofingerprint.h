@@ -0,0 +1,42 @@
+#ifndef REPOFINGERPRINT_H
+#define REPOFINGERPRINT_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QString>
+
+/// Cheap summary of the on-disk state of a repository (HEAD, index, refs, config, top-level working directory).
+/// If the fingerprint did not change, the results of the previous check are assumed to be still valid.
+///
+/// The fingerprint is computed from file metadata only (no file contents are read),
+/// so it can be computed without opening the repository.
+struct RepoFingerprint
+{
+    /// the .git folder of the worktree
+    QString gitDir;
+    /// the .git folder of the main worktree (equal to gitDir unless this is a linked worktree)
+    QString commonDir;
+    /// the working directory (empty for bare repositories)
+    QString workDir;
+    /// digest over the metadata of the relevant files
+    QByteArray digest;
+
+    bool isValid() const { return !digest.isEmpty(); }
+
+    /// Recompute the digest for the same paths.
+    RepoFingerprint recompute() const { return compute(gitDir, commonDir, workDir); }
+
+    [[nodiscard]] static RepoFingerprint compute(QString gitDir, QString commonDir, QString workDir);
+
+    /// Digest over the metadata of the branches, remote-tracking branches and config of a common directory,
+    /// i.e., the state that is shared by all worktrees.
+    [[nodiscard]] static QByteArray refsDigest(QString const& commonDir);
+
+    bool operator==(RepoFingerprint const& other) const;
+    bool operator!=(RepoFingerprint const& other) const { return !(*this == other); }
+};
+
+QDataStream& operator<<(QDataStream& out, RepoFingerprint const& fp);
+QDataStream& operator>>(QDataStream& in, RepoFingerprint& fp);
+
+#endif // REPOFINGERPRINT_H
@@ -0,0 +1,33 @@
+#include "repogroupcache.h"
+#include <QDir>
+
+RepoGroupCache& RepoGroupCache::instance()
+{
+    static RepoGroupCache cache;
+    return cache;
+}
+
+RepoGroupCache::Lock RepoGroupCache::lock(QString const& commonDir)
+{
+    Group* group = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        std::unique_ptr<Group>& g = m_groups[QDir::cleanPath(commonDir)];
+        if (!g)
+            g = std::make_unique<Group>();
+        // groups are never removed, so the pointer stays valid
+        group = g.get();
+    }
+    return Lock(group);
+}
+
+QString RepoGroupCache::branchFilterKey(RepoSettings const& settings, QString const& headBranch)
+{
+    // patterns cannot contain newlines
+    QString key = settings.includeBranches.join('\n') + QStringLiteral("\n\n") + settings.excludeBranches.join('\n')
+        + QStringLiteral("\n\n%1").arg(settings.inactiveBranchDays);
+    // otherwise all branches are monitored anyway, and the results can be shared by all worktrees
+    if (!settings.includeBranches.isEmpty() || !settings.excludeBranches.isEmpty() || settings.inactiveBranchDays > 0)
+        key += QStringLiteral("\n\n") + headBranch;
+    return key;
+}
@@ -0,0 +1,82 @@
+#ifndef REPOGROUPCACHE_H
+#define REPOGROUPCACHE_H
+
+#include "reposettings.h"
+#include "git/repository.h"
+#include <QByteArray>
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+#include <map>
+#include <memory>
+#include <optional>
+
+/// State shared by all worktrees of a repository (i.e., repos with the same common directory).
+///
+/// Linked worktrees share their branches and remotes, so the total ahead/behind counts and the remote state
+/// only have to be computed once for all of them. Only HEAD and the status of the working directory are checked per worktree.
+/// The cache is process-wide and may be used concurrently by checks in different threads.
+class RepoGroupCache
+{
+public:
+    struct GroupState {
+        /// digest over the refs and config of the common directory when totalAheadBehind was computed
+        QByteArray refsDigest;
+        /// branch filter that was applied to totalAheadBehind and branchCounts (see branchFilterKey())
+        QString totalBranchFilter;
+        std::optional<git::ahead_behind_t> totalAheadBehind;
+        std::optional<git::ahead_behind_t> inactiveAheadBehind;
+        std::optional<git::branch_counts> branchCounts;
+        /// when inactive branches were last walked, and the branch filter (without HEAD) they were selected by
+        QDateTime fullSweepTimestamp;
+        QString fullSweepBranchFilter;
+        /// per-branch ahead/behind counts, so only the branches that moved are walked when the refs changed
+        git::ahead_behind_cache aheadBehindCache;
+
+        /// when remoteState was queried; only successful queries are stored
+        QDateTime remoteTimestamp;
+        /// branch filter that was applied to remoteState
+        QString remoteBranchFilter;
+        std::optional<git::remote_state_t> remoteState;
+        /// when inactive branches were last compared with the remote, and the branch filter (without HEAD) they were selected by
+        QDateTime remoteFullSweepTimestamp;
+        QString remoteFullSweepBranchFilter;
+    };
+
+    /// Worktrees may use different branch filters; results are only shared between worktrees with the same filter.
+    /// The branch HEAD points to is always monitored (see git::repository::local_branches()),
+    /// so with patterns or recency pruning, it is part of the key.
+    static QString branchFilterKey(RepoSettings const& settings, QString const& headBranch);
+
+private:
+    struct Group {
+        QMutex mutex;
+        GroupState state;
+    };
+
+public:
+    /// Exclusive access to the state of a group.
+    /// Checks of other worktrees of the same group wait until the lock is released,
+    /// so that they can use the results instead of computing them again.
+    class Lock {
+    public:
+        explicit Lock(Group* group) : m_locker(&group->mutex), m_group(group) { }
+        GroupState& operator*() { return m_group->state; }
+        GroupState* operator->() { return &m_group->state; }
+
+    private:
+        QMutexLocker<QMutex> m_locker;
+        Group* m_group;
+    };
+
+    static RepoGroupCache& instance();
+
+    /// lock the group of the given common directory (see git::repository::commondir())
+    Lock lock(QString const& commonDir);
+
+private:
+    QMutex m_mutex;
+    std::map<QString, std::unique_ptr<Group>> m_groups;
+};
+
+#endif // REPOGROUPCACHE_H
@@ -1,70 +1,263 @@
 #include "repomanager.h"
-#include "settings.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+    /// number of repos loaded per iteration of the event loop in readSettings()
+    inline constexpr qsizetype k_loadChunkSize = 64;
+}
 
 RepoManager::RepoManager(QObject* parent)
     : QObject{parent}
 {
-    // Make sure that QList<QVariantMap> is registered.
-    // Otherwise, readSettings will fail due to "unknown user type with name QList<QVariantMap>".
-    QVariant::fromValue<QList<QVariantMap>>({});
+    m_saveStateCacheTimer = new QTimer(this);
+    m_saveStateCacheTimer->setSingleShot(true);
+    m_saveStateCacheTimer->setInterval(std::chrono::seconds(10));
+    connect(m_saveStateCacheTimer, &QTimer::timeout, this, &RepoManager::saveStateCache);
+
+    m_discovery = new RepoDiscovery(this);
+    connect(m_discovery, &RepoDiscovery::finished, this, [this](QList<RepoSettings> repos) {
+        qsizetype const added = addNewRepos(std::move(repos));
+        qDebug() << "RepoManager: added" << added << "discovered repositories";
+    });
+}
+
+RepoManager::~RepoManager()
+{
+    if (m_saveStateCacheTimer->isActive())
+        saveStateCache();
 }
 
 void RepoManager::readSettings()
 {
-    if (!m_repos.isEmpty()) {
+    if (!m_repos.isEmpty() || isLoading()) {
         qDebug() << "RepoManager::readSettings: refusing to read settings multiple times";
         return;  // already read; we do not want to set up the Repo objects multiple times
     }
 
-    QSettings settings;
+    m_store.migrateLegacySettings();
+    m_stateCache.load(RepoStateCache::defaultFileName());
 
-    auto const allRepoSettingsVariant = settings.value(Settings::RepoManager::Repos);
-    qDebug() << "got value" << allRepoSettingsVariant;
-    if (allRepoSettingsVariant.isValid() && !allRepoSettingsVariant.canConvert<QList<QVariantMap>>()) {
-        qDebug() << "RepoManager::readSettings: unable to deserialize repo settings";
-        return;
+    m_pendingStoreKeys = m_store.keys();
+    qDebug() << "RepoManager::readSettings: found" << m_pendingStoreKeys.size() << "repositories";
+    loadPendingRepos();
+}
+
+void RepoManager::loadPendingRepos()
+{
+    qsizetype const count = std::min(k_loadChunkSize, m_pendingStoreKeys.size());
+    QList<RepoSettings> chunk;
+    for (QString const& key : m_pendingStoreKeys.first(count)) {
+        if (auto settings = m_store.load(key))
+            chunk.push_back(*std::move(settings));
+    }
+    m_pendingStoreKeys.remove(0, count);
+
+    if (!chunk.isEmpty()) {
+        qsizetype const first = m_repos.size();
+        qsizetype const last = first + chunk.size() - 1;
+        emit reposAboutToBeAdded(first, last);
+        for (RepoSettings& settings : chunk)
+            addRepo(std::move(settings));
+        emit reposAdded(first, last);
     }
 
-    auto const allRepoSettings = allRepoSettingsVariant.value<QList<QVariantMap>>();
-    for (auto const& repoSettingsMap : allRepoSettings)
-        addRepo(RepoSettings::fromVariantMap(repoSettingsMap));
+    if (isLoading()) {
+        QTimer::singleShot(0, this, &RepoManager::loadPendingRepos);
+        return;
+    }
 
     qDebug() << "RepoManager::readSettings: loaded" << m_repos.size() << "repositories";
-}
 
-void RepoManager::writeSettings()
-{
-    QSettings settings;
+    // forget about repositories that have been removed in the meantime
+    QList<QString> paths;
+    for (Repo const* repo : m_repos)
+        paths.push_back(repo->settings().path);
+    m_stateCache.retainOnly(paths);
 
-    QList<QVariantMap> allRepoSettings;
-    for (Repo const* repo : m_repos) {
-        qDebug() << "RepoManager::writeSettings: saving repository" << repo->settings().path;
-        allRepoSettings.push_back(repo->settings().toVariantMap());
-    }
+    emit loadingFinished();
 
-    settings.setValue(Settings::RepoManager::Repos, QVariant::fromValue<QList<QVariantMap>>(allRepoSettings));
-    qDebug() << "RepoManager::writeSettings: saved" << allRepoSettings.size() << "repositories";
+    // look for new clones only after all known repos have been loaded
+    m_discovery->readSettings();
+    m_discovery->start();
 }
 
-Repo const* RepoManager::addRepo(RepoSettings settings)
+QList<RepoSettings> RepoManager::readRepoSettings()
+{
+    // the legacy settings are only migrated by readSettings(), so that a batch check does not modify the configuration
+    return RepoStore().loadAll(true);
+}
+
+Repo* RepoManager::addRepo(RepoSettings settings)
 {
     qDebug() << "Adding repository:" << settings.path;
     Repo* repo = new Repo(m_repos.size(), this);
     m_repos.push_back(repo);
+    m_contributions.push_back(Contribution());
+    m_aggregate.reposByStatus[size_t(RepoStatus::Unknown)] += 1;
     Q_ASSERT(m_repos.at(repo->index()) == repo);
     repo->updateSettings(std::move(settings));
+    if (auto state = m_stateCache.find(repo->settings().path))
+        repo->restoreState(*std::move(state));
     repo->enable();
 
+    QString const path = normalizedPath(repo->settings().path);
+    m_repoByPath.insert(path, repo);
+    // also register the canonical path, so lookups of paths that are reported by git succeed even if symlinks are involved
+    QString const canonicalPath = QFileInfo(path).canonicalFilePath();
+    if (!canonicalPath.isEmpty() && canonicalPath != path)
+        m_repoByPath.insert(canonicalPath, repo);
+
     connect(repo, &Repo::changed, this, [this, repo]() {
+        updateAggregate(repo);
         emit repoChanged(repo);
     });
+    connect(repo, &Repo::checkFinished, this, [this, repo]() {
+        on_repo_checkFinished(repo);
+    });
+    // the restored state is not announced by a signal
+    updateAggregate(repo);
 
     return repo;
 }
 
-Repo const* RepoManager::addNewRepo(RepoSettings settings)
+Repo const* RepoManager::addNewRepo(RepoSettings settings, QFuture<Repo::check_result_t> prefetchedCheck)
 {
-    Repo const* repo = addRepo(std::move(settings));
-    writeSettings();
+    // only the new entry is written
+    if (m_store.insert(settings).isEmpty())
+        qDebug() << "RepoManager::addNewRepo: unable to store repository" << settings.path;
+
+    qsizetype const index = m_repos.size();
+    emit reposAboutToBeAdded(index, index);
+    Repo* repo = addRepo(std::move(settings));
+    repo->adoptCheck(std::move(prefetchedCheck));
+    emit reposAdded(index, index);
     return repo;
 }
+
+qsizetype RepoManager::addNewRepos(QList<RepoSettings> settings)
+{
+    if (isLoading()) {
+        // we cannot tell which repos are new until all known repos have been loaded
+        connect(this, &RepoManager::loadingFinished, this, [this, settings = std::move(settings)]() mutable {
+            addNewRepos(std::move(settings));
+        }, Qt::SingleShotConnection);
+        return 0;
+    }
+
+    QList<RepoSettings> newRepos;
+    QSet<QString> newPaths;
+    for (RepoSettings& rs : settings) {
+        QString const path = normalizedPath(rs.path);
+        if (containsRepo(path) || newPaths.contains(path))
+            continue;
+        newPaths.insert(path);
+        newRepos.push_back(std::move(rs));
+    }
+    if (newRepos.isEmpty())
+        return 0;
+
+    QList<QString> const keys = m_store.insert(newRepos);
+    for (qsizetype i = 0; i < keys.size(); ++i) {
+        if (keys[i].isEmpty())
+            qDebug() << "RepoManager::addNewRepos: unable to store repository" << newRepos[i].path;
+    }
+
+    qsizetype const first = m_repos.size();
+    qsizetype const last = first + newRepos.size() - 1;
+    emit reposAboutToBeAdded(first, last);
+    for (qsizetype i = 0; i < newRepos.size(); ++i)
+        addRepo(std::move(newRepos[i]));
+    emit reposAdded(first, last);
+
+    return newRepos.size();
+}
+
+bool RepoManager::containsRepo(QString const& path) const
+{
+    return m_repoByPath.contains(normalizedPath(path));
+}
+
+QString RepoManager::normalizedPath(QString const& path)
+{
+    return QDir::cleanPath(QDir(path).absolutePath());
+}
+
+Repo* RepoManager::findRepo(QString const& path) const
+{
+    // walk up the directory hierarchy; this only involves hash lookups and no filesystem access
+    QString p = normalizedPath(path);
+    while (true) {
+        if (Repo* repo = m_repoByPath.value(p, nullptr))
+            return repo;
+        qsizetype const sep = p.lastIndexOf('/');
+        if (sep <= 0)
+            break;
+        p.truncate(sep);
+    }
+    return m_repoByPath.value(QStringLiteral("/"), nullptr);
+}
+
+void RepoManager::applyRemoteUpdate(RemoteUpdate const& update)
+{
+    // only the repositories with a remote at the URL, as known from their last query of the remote state;
+    // without such a query, the update could not be applied anyway
+    QString const url = update.normalizedUrl();
+    for (Repo* repo : m_repos) {
+        if (repo->remoteUrls().contains(url))
+            repo->applyRemoteUpdate(update);
+    }
+}
+
+qsizetype RepoManager::checksInProgress() const
+{
+    return std::count_if(m_repos.cbegin(), m_repos.cend(), [](Repo const* repo) {
+        return repo->activity() == RepoActivity::Checking;
+    });
+}
+
+RepoManager::Contribution RepoManager::Contribution::of(Repo const* repo)
+{
+    RepoStatistics const& stats = repo->statistics();
+    Contribution c;
+    c.status = repo->status();
+    c.uncommitted = stats.uncommitted.value_or(0);
+    if (stats.total_ahead_behind) {
+        c.ahead = stats.total_ahead_behind->ahead;
+        c.behind = stats.total_ahead_behind->behind;
+    }
+    return c;
+}
+
+void RepoManager::updateAggregate(Repo const* repo)
+{
+    Contribution& old = m_contributions[repo->index()];
+    Contribution const current = Contribution::of(repo);
+    if (current.status == old.status && current.uncommitted == old.uncommitted && current.ahead == old.ahead && current.behind == old.behind)
+        return;
+
+    m_aggregate.reposByStatus[size_t(old.status)] -= 1;
+    m_aggregate.reposByStatus[size_t(current.status)] += 1;
+    m_aggregate.uncommitted += current.uncommitted - old.uncommitted;
+    m_aggregate.ahead += current.ahead - old.ahead;
+    m_aggregate.behind += current.behind - old.behind;
+    old = current;
+
+    emit aggregateChanged();
+}
+
+void RepoManager::on_repo_checkFinished(Repo* repo)
+{
+    m_stateCache.insert(repo->settings().path, repo->cachedState());
+    if (!m_saveStateCacheTimer->isActive())
+        m_saveStateCacheTimer->start();
+}
+
+void RepoManager::saveStateCache()
+{
+    m_saveStateCacheTimer->stop();
+    if (!m_stateCache.save(RepoStateCache::defaultFileName()))
+        qDebug() << "RepoManager: unable to save state cache";
+}
@@ -2,30 +2,136 @@
 #define REPOMANAGER_H
 
 #include "repo.h"
+#include "repodiscovery.h"
+#include "repostatecache.h"
+#include "repostore.h"
+#include <QHash>
 #include <QObject>
 #include <QList>
+#include <array>
 
 class RepoManager : public QObject
 {
     Q_OBJECT
 
-    Repo const* addRepo(RepoSettings settings);
+    Repo* addRepo(RepoSettings settings);
 
 public:
     explicit RepoManager(QObject* parent = nullptr);
+    ~RepoManager();
 
+    /// Set up the configured repositories.
+    /// The first few repositories are loaded immediately, the remaining ones in the following iterations of the event loop,
+    /// so that startup is not delayed by a long list (see isLoading()).
     void readSettings();
-    void writeSettings();
 
-    Repo const* addNewRepo(RepoSettings settings);
+    /// whether readSettings() is still loading repositories
+    bool isLoading() const { return !m_pendingStoreKeys.isEmpty(); }
+
+    /// Read the list of configured repositories without setting up Repo objects.
+    /// Unlike readSettings(), this does not migrate the legacy settings, so nothing is written.
+    static QList<RepoSettings> readRepoSettings();
+
+    /// Add a new repository and store it.
+    /// If a check of the repository is already running (see EditRepoDialog::takePrefetchedCheck()),
+    /// its result is used for the first check.
+    Repo const* addNewRepo(RepoSettings settings, QFuture<Repo::check_result_t> prefetchedCheck = {});
+
+    /// Add and store multiple new repositories at once. Repositories that are already monitored are skipped.
+    /// Returns the number of added repositories.
+    qsizetype addNewRepos(QList<RepoSettings> settings);
+
+    /// whether a repository with exactly this path is monitored
+    bool containsRepo(QString const& path) const;
+
+    /// Discovery of new repositories; discovered repositories are added automatically.
+    RepoDiscovery* discovery() const { return m_discovery; }
 
     QList<Repo*> const& repos() const { return m_repos; }
 
+    /// Find the monitored repository containing the given absolute path.
+    /// The path may point to a subdirectory of the repository's working directory.
+    Repo* findRepo(QString const& path) const;
+
+    /// Apply a push notification to all repositories with a matching remote (see Repo::applyRemoteUpdate()).
+    void applyRemoteUpdate(RemoteUpdate const& update);
+
+    /// number of repositories that are currently being checked
+    qsizetype checksInProgress() const;
+
+    /// query statistics of the query server (see QueryServer)
+    struct QueryCounters {
+        /// answered from the cached state
+        quint64 cached = 0;
+        /// answered after refreshing the repository
+        quint64 refreshed = 0;
+        /// not answered with a repository state (unknown command, repository not monitored, ...)
+        quint64 failed = 0;
+    };
+    QueryCounters const& queryCounters() const { return m_queryCounters; }
+    QueryCounters& queryCounters() { return m_queryCounters; }
+
+    /// Summary of all repos. It is updated incrementally whenever a repo changes, so reading it is cheap.
+    struct Aggregate {
+        /// number of repos, indexed by RepoStatus
+        std::array<qsizetype, 4> reposByStatus{};
+        /// uncommitted changes across all repos
+        quint64 uncommitted = 0;
+        /// unpushed and unmerged commits across all branches of all repos
+        quint64 ahead = 0;
+        quint64 behind = 0;
+
+        qsizetype repos(RepoStatus status) const { return reposByStatus.at(size_t(status)); }
+    };
+    Aggregate const& aggregate() const { return m_aggregate; }
+
 signals:
     void repoChanged(Repo* repo);
+    /// emitted before repos with indices first to last (inclusive) are added
+    void reposAboutToBeAdded(qsizetype first, qsizetype last);
+    /// emitted after repos with indices first to last (inclusive) have been added
+    void reposAdded(qsizetype first, qsizetype last);
+    /// emitted when readSettings() has loaded all repositories
+    void loadingFinished();
+    /// emitted when aggregate() changed
+    void aggregateChanged();
+
+private:
+    static QString normalizedPath(QString const& path);
+
+    void loadPendingRepos();
+
+    /// what a repo currently contributes to the aggregate
+    struct Contribution {
+        RepoStatus status = RepoStatus::Unknown;
+        quint64 uncommitted = 0;
+        quint64 ahead = 0;
+        quint64 behind = 0;
+
+        static Contribution of(Repo const* repo);
+    };
+    /// replace the repo's previous contribution to the aggregate by its current one
+    void updateAggregate(Repo const* repo);
+
+    void on_repo_checkFinished(Repo* repo);
+    void saveStateCache();
 
 private:
     QList<Repo*> m_repos;
+    RepoStore m_store;
+    /// keys of repos that still need to be loaded by readSettings()
+    QList<QString> m_pendingStoreKeys;
+    /// normalized path -> repo
+    QHash<QString, Repo*> m_repoByPath;
+    QueryCounters m_queryCounters;
+    Aggregate m_aggregate;
+    /// indexed like m_repos
+    QList<Contribution> m_contributions;
+    RepoDiscovery* m_discovery = nullptr;
+
+    RepoStateCache m_stateCache;
+    /// delays writing the state cache, so that a burst of completed checks results in a single write
+    QTimer* m_saveStateCacheTimer = nullptr;
 };
 
 #endif // REPOMANAGER_H
@@ -9,6 +9,12 @@ namespace {
     inline constexpr char const* k_warnOnUnpushedCommits    = "warnOnUnpushedCommits";
     inline constexpr char const* k_warnOnUnmergedCommits    = "warnOnUnmergedCommits";
     inline constexpr char const* k_warnOnUnfetchedCommits   = "warnOnUnfetchedCommits";
+    inline constexpr char const* k_includeBranches = "includeBranches";
+    inline constexpr char const* k_excludeBranches = "excludeBranches";
+    inline constexpr char const* k_inactiveBranchDays = "inactiveBranchDays";
+    inline constexpr char const* k_statusEngine = "statusEngine";
+    inline constexpr char const* k_statusEngineNative = "native";
+    inline constexpr char const* k_refreshIndexWhenIdle = "refreshIndexWhenIdle";
 }
 
 QVariantMap RepoSettings::toVariantMap() const
@@ -19,6 +25,16 @@ QVariantMap RepoSettings::toVariantMap() const
     map[k_warnOnUnpushedCommits   ] = warnOnUnpushedCommits;
     map[k_warnOnUnmergedCommits   ] = warnOnUnmergedCommits;
     map[k_warnOnUnfetchedCommits  ] = warnOnUnfetchedCommits;
+    if (!includeBranches.isEmpty())
+        map[k_includeBranches] = QStringList(includeBranches);
+    if (!excludeBranches.isEmpty())
+        map[k_excludeBranches] = QStringList(excludeBranches);
+    if (inactiveBranchDays > 0)
+        map[k_inactiveBranchDays] = inactiveBranchDays;
+    if (statusEngine == git::status_engine::native)
+        map[k_statusEngine] = k_statusEngineNative;
+    if (refreshIndexWhenIdle)
+        map[k_refreshIndexWhenIdle] = true;
     return map;
 }
 
@@ -30,9 +46,25 @@ RepoSettings RepoSettings::fromVariantMap(QVariantMap const& map)
     rs.warnOnUnpushedCommits    = map[k_warnOnUnpushedCommits   ].toBool();
     rs.warnOnUnmergedCommits    = map[k_warnOnUnmergedCommits   ].toBool();
     rs.warnOnUnfetchedCommits   = map[k_warnOnUnfetchedCommits  ].toBool();
+    rs.includeBranches = map.value(k_includeBranches).toStringList();
+    rs.excludeBranches = map.value(k_excludeBranches).toStringList();
+    rs.inactiveBranchDays = map.value(k_inactiveBranchDays, 0).toInt();
+    if (map.value(k_statusEngine).toString() == k_statusEngineNative)
+        rs.statusEngine = git::status_engine::native;
+    rs.refreshIndexWhenIdle = map.value(k_refreshIndexWhenIdle, false).toBool();
     return rs;
 }
 
+git::branch_filter RepoSettings::branchFilter() const
+{
+    git::branch_filter filter;
+    for (QString const& pattern : includeBranches)
+        filter.include.push_back(pattern.toStdString());
+    for (QString const& pattern : excludeBranches)
+        filter.exclude.push_back(pattern.toStdString());
+    return filter;
+}
+
 QList<QString> RepoSettings::validate() const
 {
     QList<QString> errors;
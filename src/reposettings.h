@@ -1,6 +1,8 @@
 #ifndef REPOSETTINGS_H
 #define REPOSETTINGS_H
 
+#include "git/branch_filter.h"
+#include "git/repository.h"
 #include <QList>
 #include <QString>
 #include <QVariantMap>
@@ -13,7 +15,25 @@ struct RepoSettings
     bool warnOnUnmergedCommits = true;
     bool warnOnUnfetchedCommits = true;
 
-    // TODO: maybe we want to add a setting to select a subset of branches to monitor?
+    /// Glob patterns selecting the monitored branches (see git::branch_filter).
+    /// If includeBranches is empty, all branches not matching excludeBranches are monitored.
+    QList<QString> includeBranches;
+    QList<QString> excludeBranches;
+
+    /// Branches without commits or reflog entries for this many days are skipped, except in a daily full sweep.
+    /// 0 disables the pruning.
+    int inactiveBranchDays = 0;
+
+    /// How uncommitted changes are counted; the native engine is faster for large working directories.
+    git::status_engine statusEngine = git::status_engine::libgit2;
+
+    /// When the index has not been modified for a while, refresh its stat data like `git status` does,
+    /// so files that were touched but not changed do not have to be compared by content in every check.
+    /// This writes to the repository's index, so it is opt-in.
+    bool refreshIndexWhenIdle = false;
+
+    /// filter by the branch patterns; the recency pruning depends on the time of the check
+    git::branch_filter branchFilter() const;
 
     QVariantMap toVariantMap() const;
     [[nodiscard]] static RepoSettings fromVariantMap(QVariantMap const& map);
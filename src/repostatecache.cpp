@@ -0,0 +1,211 @@
+#include "repostatecache.h"
+#include "git/util.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+namespace {
+
+    inline constexpr quint32 k_magic = 0x474d5343;  // "GMSC"
+    /// increment when the format changes; old caches are discarded
+    inline constexpr quint32 k_formatVersion = 5;
+
+    template <typename T>
+    void writeOptional(QDataStream& out, std::optional<T> const& value)
+    {
+        out << value.has_value();
+        if (value)
+            out << quint64(*value);
+    }
+
+    template <typename T>
+    void readOptional(QDataStream& in, std::optional<T>& value)
+    {
+        bool has_value = false;
+        in >> has_value;
+        value.reset();
+        if (has_value) {
+            quint64 v = 0;
+            in >> v;
+            value = T(v);
+        }
+    }
+
+    void writeAheadBehind(QDataStream& out, std::optional<git::ahead_behind_t> const& ab)
+    {
+        out << ab.has_value();
+        if (ab)
+            out << quint64(ab->ahead) << quint64(ab->behind);
+    }
+
+    void readAheadBehind(QDataStream& in, std::optional<git::ahead_behind_t>& ab)
+    {
+        bool has_value = false;
+        in >> has_value;
+        ab.reset();
+        if (has_value) {
+            quint64 ahead = 0, behind = 0;
+            in >> ahead >> behind;
+            ab = git::ahead_behind_t{.ahead = size_t(ahead), .behind = size_t(behind)};
+        }
+    }
+
+    void writeState(QDataStream& out, RepoCachedState const& state)
+    {
+        RepoStatistics const& stats = state.statistics;
+        out << qint32(git::to_underlying(state.status));
+        out << stats.timestamp;
+        writeOptional(out, stats.uncommitted);
+        writeAheadBehind(out, stats.head_ahead_behind);
+        writeAheadBehind(out, stats.total_ahead_behind);
+        writeAheadBehind(out, stats.inactive_ahead_behind);
+        out << stats.branch_counts.has_value();
+        if (stats.branch_counts)
+            out << quint64(stats.branch_counts->total) << quint64(stats.branch_counts->monitored) << quint64(stats.branch_counts->inactive);
+        out << stats.full_sweep_timestamp;
+        out << qint32(git::to_underlying(stats.head_state));
+        writeOptional(out, stats.branches_outdated);
+        out << stats.remote_timestamp;
+        out << qint64(stats.duration.count());
+        out << qint64(stats.status_duration.count());
+        out << stats.index_refresh_timestamp;
+        out << qint64(stats.status_duration_before_refresh.count());
+        out << qint32(state.errors.size());
+        for (RepoCheckError const& e : state.errors)
+            out << e.timestamp << e.message << e.firstTimestamp << e.count;
+        out << state.fingerprint;
+    }
+
+    void readState(QDataStream& in, RepoCachedState& state)
+    {
+        RepoStatistics& stats = state.statistics;
+        qint32 status = 0;
+        in >> status;
+        state.status = static_cast<RepoStatus>(status);
+        in >> stats.timestamp;
+        readOptional(in, stats.uncommitted);
+        readAheadBehind(in, stats.head_ahead_behind);
+        readAheadBehind(in, stats.total_ahead_behind);
+        readAheadBehind(in, stats.inactive_ahead_behind);
+        bool has_branch_counts = false;
+        in >> has_branch_counts;
+        stats.branch_counts.reset();
+        if (has_branch_counts) {
+            quint64 total = 0, monitored = 0, inactive = 0;
+            in >> total >> monitored >> inactive;
+            stats.branch_counts = git::branch_counts{.total = total, .monitored = monitored, .inactive = inactive};
+        }
+        in >> stats.full_sweep_timestamp;
+        qint32 head_state = 0;
+        in >> head_state;
+        stats.head_state = static_cast<git::branch_state>(head_state);
+        readOptional(in, stats.branches_outdated);
+        in >> stats.remote_timestamp;
+        qint64 duration = 0;
+        in >> duration;
+        stats.duration = std::chrono::milliseconds(duration);
+        qint64 status_duration = 0, status_duration_before_refresh = 0;
+        in >> status_duration;
+        stats.status_duration = std::chrono::milliseconds(status_duration);
+        in >> stats.index_refresh_timestamp;
+        in >> status_duration_before_refresh;
+        stats.status_duration_before_refresh = std::chrono::milliseconds(status_duration_before_refresh);
+        qint32 num_errors = 0;
+        in >> num_errors;
+        state.errors.clear();
+        for (qint32 i = 0; i < num_errors && in.status() == QDataStream::Ok; ++i) {
+            RepoCheckError e;
+            in >> e.timestamp >> e.message >> e.firstTimestamp >> e.count;
+            state.errors.push_back(std::move(e));
+        }
+        in >> state.fingerprint;
+    }
+
+}
+
+QString RepoStateCache::defaultFileName()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("repo-state.dat");
+}
+
+bool RepoStateCache::load(QString const& fileName)
+{
+    m_states.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_5);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != k_magic || version != k_formatVersion) {
+        qDebug() << "RepoStateCache::load: ignoring cache with unknown format in" << fileName;
+        return false;
+    }
+
+    qint32 count = 0;
+    in >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        RepoCachedState state;
+        in >> path;
+        readState(in, state);
+        m_states.insert(path, std::move(state));
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "RepoStateCache::load: corrupt cache file" << fileName;
+        m_states.clear();
+        return false;
+    }
+    qDebug() << "RepoStateCache::load: loaded" << m_states.size() << "entries";
+    return true;
+}
+
+bool RepoStateCache::save(QString const& fileName) const
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_5);
+    out << k_magic << k_formatVersion;
+    out << qint32(m_states.size());
+    for (auto it = m_states.cbegin(); it != m_states.cend(); ++it) {
+        out << it.key();
+        writeState(out, it.value());
+    }
+    return file.commit();
+}
+
+std::optional<RepoCachedState> RepoStateCache::find(QString const& path) const
+{
+    auto it = m_states.constFind(path);
+    if (it == m_states.cend())
+        return std::nullopt;
+    return it.value();
+}
+
+void RepoStateCache::insert(QString const& path, RepoCachedState state)
+{
+    m_states.insert(path, std::move(state));
+}
+
+void RepoStateCache::remove(QString const& path)
+{
+    m_states.remove(path);
+}
+
+void RepoStateCache::retainOnly(QList<QString> const& paths)
+{
+    QSet<QString> const keep(paths.cbegin(), paths.cend());
+    m_states.removeIf([&keep](auto const& it) { return !keep.contains(it.key()); });
+}
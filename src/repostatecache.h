@@ -0,0 +1,37 @@
+#ifndef REPOSTATECACHE_H
+#define REPOSTATECACHE_H
+
+#include "repo.h"
+#include <QHash>
+#include <QString>
+#include <optional>
+
+/// On-disk cache of the last known state of each repository, keyed by the repository path.
+/// This allows to show the state immediately after startup, and to skip the ahead/behind computation for unchanged repositories.
+class RepoStateCache
+{
+public:
+    /// default location in the cache directory of the application
+    static QString defaultFileName();
+
+    /// Replace the contents by the contents of the given file.
+    /// Returns false if the file does not exist or cannot be parsed, in which case the cache is empty.
+    bool load(QString const& fileName);
+
+    /// Write the contents to the given file, atomically replacing it.
+    bool save(QString const& fileName) const;
+
+    std::optional<RepoCachedState> find(QString const& path) const;
+    void insert(QString const& path, RepoCachedState state);
+    void remove(QString const& path);
+
+    /// remove all entries whose path is not in the given list
+    void retainOnly(QList<QString> const& paths);
+
+    qsizetype size() const { return m_states.size(); }
+
+private:
+    QHash<QString, RepoCachedState> m_states;
+};
+
+#endif // REPOSTATECACHE_H
@@ -0,0 +1,165 @@
+#include "repostore.h"
+#include "settings.h"
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+namespace {
+    inline constexpr char const* k_suffix = ".json";
+    /// width of the zero-padded sequence number; keys sort by creation order
+    inline constexpr int k_keyWidth = 8;
+}
+
+RepoStore::RepoStore(QString directory)
+    : m_directory{std::move(directory)}
+{ }
+
+QString RepoStore::defaultDirectory()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)).filePath("repos");
+}
+
+QString RepoStore::fileName(QString const& key) const
+{
+    return QDir(m_directory).filePath(key + k_suffix);
+}
+
+QList<QString> RepoStore::keys() const
+{
+    QDir const dir(m_directory);
+    QList<QString> result;
+    for (QString const& name : dir.entryList({QStringLiteral("*.json")}, QDir::Files, QDir::Name))
+        result.push_back(name.chopped(qstrlen(k_suffix)));
+    return result;
+}
+
+std::optional<RepoSettings> RepoStore::load(QString const& key) const
+{
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "RepoStore::load: unable to open" << file.fileName() << ":" << file.errorString();
+        return std::nullopt;
+    }
+    QJsonParseError error;
+    QJsonDocument const doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!doc.isObject()) {
+        qDebug() << "RepoStore::load: unable to parse" << file.fileName() << ":" << error.errorString();
+        return std::nullopt;
+    }
+    return RepoSettings::fromVariantMap(doc.object().toVariantMap());
+}
+
+QString RepoStore::nextKey()
+{
+    if (m_lastSequence == 0) {
+        for (QString const& key : keys())
+            m_lastSequence = std::max(m_lastSequence, key.toULongLong());
+    }
+    m_lastSequence += 1;
+    return QStringLiteral("%1").arg(m_lastSequence, k_keyWidth, 10, QChar('0'));
+}
+
+bool RepoStore::write(QString const& key, RepoSettings const& settings)
+{
+    QDir().mkpath(m_directory);
+    QSaveFile file(fileName(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "RepoStore::write: unable to open" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject::fromVariantMap(settings.toVariantMap())).toJson());
+    if (!file.commit()) {
+        qDebug() << "RepoStore::write: unable to write" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString RepoStore::insert(RepoSettings const& settings)
+{
+    QString key = nextKey();
+    if (!write(key, settings))
+        return QString();
+    return key;
+}
+
+QList<QString> RepoStore::insert(QList<RepoSettings> const& settings)
+{
+    QList<QString> result;
+    result.reserve(settings.size());
+    for (RepoSettings const& rs : settings)
+        result.push_back(insert(rs));
+    return result;
+}
+
+std::optional<QList<RepoSettings>> RepoStore::readLegacySettings()
+{
+    QSettings settings;
+    if (!settings.contains(Settings::RepoManager::Repos))
+        return std::nullopt;
+
+    // Make sure that QList<QVariantMap> is registered.
+    // Otherwise, deserialization will fail due to "unknown user type with name QList<QVariantMap>".
+    QVariant::fromValue<QList<QVariantMap>>({});
+
+    auto const allRepoSettingsVariant = settings.value(Settings::RepoManager::Repos);
+    if (!allRepoSettingsVariant.canConvert<QList<QVariantMap>>()) {
+        qDebug() << "RepoStore::readLegacySettings: unable to deserialize repo settings";
+        return std::nullopt;
+    }
+
+    QList<RepoSettings> result;
+    for (auto const& repoSettingsMap : allRepoSettingsVariant.value<QList<QVariantMap>>())
+        result.push_back(RepoSettings::fromVariantMap(repoSettingsMap));
+    return result;
+}
+
+QList<RepoSettings> RepoStore::loadAll(bool includeLegacy) const
+{
+    QList<RepoSettings> result;
+    QSet<QString> paths;
+    for (QString const& key : keys()) {
+        if (auto rs = load(key)) {
+            paths.insert(rs->path);
+            result.push_back(*std::move(rs));
+        }
+    }
+    if (includeLegacy) {
+        // same result as after migrateLegacySettings(), without writing anything
+        for (RepoSettings& rs : readLegacySettings().value_or(QList<RepoSettings>())) {
+            if (!paths.contains(rs.path))
+                result.push_back(std::move(rs));
+        }
+    }
+    return result;
+}
+
+void RepoStore::migrateLegacySettings()
+{
+    std::optional<QList<RepoSettings>> const allRepoSettings = readLegacySettings();
+    if (!allRepoSettings)
+        return;
+
+    // if a previous migration was interrupted, some of the entries may already be stored
+    QSet<QString> existingPaths;
+    for (QString const& key : keys()) {
+        if (auto rs = load(key))
+            existingPaths.insert(rs->path);
+    }
+
+    for (RepoSettings const& rs : *allRepoSettings) {
+        if (existingPaths.contains(rs.path))
+            continue;
+        if (insert(rs).isEmpty()) {
+            qDebug() << "RepoStore::migrateLegacySettings: unable to store" << rs.path << "; keeping legacy settings";
+            return;
+        }
+    }
+
+    QSettings().remove(Settings::RepoManager::Repos);
+    qDebug() << "RepoStore::migrateLegacySettings: migrated" << allRepoSettings->size() << "repositories";
+}
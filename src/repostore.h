@@ -0,0 +1,56 @@
+#ifndef REPOSTORE_H
+#define REPOSTORE_H
+
+#include "reposettings.h"
+#include <QList>
+#include <QString>
+#include <optional>
+#include <utility>
+
+/// Persistent storage of the repository configuration.
+///
+/// Every repository is stored in its own small file, so adding or changing a single repository
+/// only writes that file, and entries can be loaded one at a time.
+/// Keys are ordered by creation, so repositories are loaded in the order in which they were added.
+class RepoStore
+{
+public:
+    explicit RepoStore(QString directory = defaultDirectory());
+
+    /// default location in the config directory of the application
+    static QString defaultDirectory();
+
+    /// Move repositories from the legacy "Repos" settings key (one array of all repositories) to the store.
+    /// Does nothing if the key does not exist.
+    void migrateLegacySettings();
+
+    /// Load all stored repositories. With includeLegacy, repositories that have not been migrated yet
+    /// (see migrateLegacySettings()) are included, but neither the store nor the settings are modified.
+    QList<RepoSettings> loadAll(bool includeLegacy) const;
+
+    /// keys of all stored repositories, ordered by creation
+    QList<QString> keys() const;
+
+    std::optional<RepoSettings> load(QString const& key) const;
+
+    /// Store a new repository. Returns the new key, or an empty string on failure.
+    QString insert(RepoSettings const& settings);
+
+    /// Store multiple new repositories. Returns the new keys (empty strings for failed entries).
+    QList<QString> insert(QList<RepoSettings> const& settings);
+
+private:
+    /// entries of the legacy "Repos" settings key; std::nullopt if the key does not exist or cannot be read
+    static std::optional<QList<RepoSettings>> readLegacySettings();
+
+    QString fileName(QString const& key) const;
+    QString nextKey();
+    bool write(QString const& key, RepoSettings const& settings);
+
+private:
+    QString m_directory;
+    /// sequence number of the most recently created key (0 if not yet determined)
+    quint64 m_lastSequence = 0;
+};
+
+#endif // REPOSTORE_H
@@ -1,28 +1,66 @@
 #include "repotablemodel.h"
+#include <QLocale>
 #include <QSize>
+#include <algorithm>
+
+namespace {
+    inline constexpr std::chrono::milliseconds k_flushInterval{16};
+}
 
 RepoTableModel::RepoTableModel(QObject* parent)
     : QAbstractTableModel(parent)
-{}
+    , m_flushTimer(new QTimer(this))
+{
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(k_flushInterval);
+    connect(m_flushTimer, &QTimer::timeout, this, &RepoTableModel::flushChanges);
+}
 
 void RepoTableModel::setRepoManager(RepoManager* newRepoManager)
 {
-    if (m_repoManager)
+    if (m_repoManager) {
         disconnect(m_repoManager, &RepoManager::repoChanged, this, &RepoTableModel::on_repo_changed);
+        disconnect(m_repoManager, &RepoManager::reposAboutToBeAdded, this, &RepoTableModel::on_reposAboutToBeAdded);
+        disconnect(m_repoManager, &RepoManager::reposAdded, this, &RepoTableModel::on_reposAdded);
+    }
 
     beginResetModel();
     m_repoManager = newRepoManager;
+    m_rows.clear();
+    m_dirtyRows.clear();
+    m_flushTimer->stop();
+    if (m_repoManager) {
+        m_rows.reserve(m_repoManager->repos().size());
+        for (Repo const* repo : m_repoManager->repos())
+            m_rows.append(makeRow(repo));
+    }
     endResetModel();
 
-    if (m_repoManager)
+    if (m_repoManager) {
         connect(m_repoManager, &RepoManager::repoChanged, this, &RepoTableModel::on_repo_changed);
+        connect(m_repoManager, &RepoManager::reposAboutToBeAdded, this, &RepoTableModel::on_reposAboutToBeAdded);
+        connect(m_repoManager, &RepoManager::reposAdded, this, &RepoTableModel::on_reposAdded);
+    }
 }
 
-void RepoTableModel::addRepo(RepoSettings settings)
+void RepoTableModel::addRepo(RepoSettings settings, QFuture<Repo::check_result_t> prefetchedCheck)
 {
     Q_ASSERT(m_repoManager);
-    beginInsertRows(QModelIndex(), rowCount(), rowCount());
-    m_repoManager->addNewRepo(std::move(settings));
+    // rows are inserted via the reposAboutToBeAdded/reposAdded signals
+    m_repoManager->addNewRepo(std::move(settings), std::move(prefetchedCheck));
+}
+
+void RepoTableModel::on_reposAboutToBeAdded(qsizetype first, qsizetype last)
+{
+    beginInsertRows(QModelIndex(), int(first), int(last));
+}
+
+void RepoTableModel::on_reposAdded(qsizetype first, qsizetype last)
+{
+    Q_ASSERT(first == m_rows.size());
+    QList<Repo*> const& repos = m_repoManager->repos();
+    for (qsizetype i = first; i <= last; ++i)
+        m_rows.append(makeRow(repos.at(i)));
     endInsertRows();
 }
 
@@ -45,6 +83,8 @@ QVariant RepoTableModel::headerData(int section, Qt::Orientation orientation, in
             return tr("All Branches");
         case Column::Remote:
             return tr("Remote Branches");
+        case Column::LastCheck:
+            return tr("Last Check");
         }
     }
 
@@ -67,7 +107,7 @@ int RepoTableModel::rowCount(QModelIndex const& parent) const
         return 0;
     if (parent.isValid())
         return 0;
-    return m_repoManager->repos().size();
+    return m_rows.size();
 }
 
 QVariant RepoTableModel::data(QModelIndex const& index, int role) const
@@ -77,30 +117,61 @@ QVariant RepoTableModel::data(QModelIndex const& index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    if (role == Qt::DisplayRole) {
-        Repo const* repo = m_repoManager->repos().at(index.row());
-
-        switch (index.column()) {
-        case Column::Path:
-            return getPathData(repo);
-        case Column::Status:
-            return getStatusData(repo, role);
-        case Column::Uncommitted:
-            return getUncommittedData(repo);
-        case Column::HEAD:
-            return getHEADData(repo);
-        case Column::Branches:
-            return getBranchesData(repo);
-        case Column::Remote:
-            return getRemoteData(repo);
-        }
-    }
+    if (role == Qt::DisplayRole)
+        return m_rows.at(index.row()).display.at(index.column());
+    if (role == SortRole)
+        return m_rows.at(index.row()).sortKey.at(index.column());
 
     // TODO: implement Qt::ToolTipRole with more detailed messages
 
     return QVariant();
 }
 
+RepoTableModel::Row RepoTableModel::makeRow(Repo const* repo) const
+{
+    Row row;
+    row.display[Column::Path] = getPathData(repo);
+    row.display[Column::Status] = getStatusData(repo, Qt::DisplayRole);
+    row.display[Column::Uncommitted] = getUncommittedData(repo);
+    row.display[Column::HEAD] = getHEADData(repo);
+    row.display[Column::Branches] = getBranchesData(repo);
+    row.display[Column::Remote] = getRemoteData(repo);
+    row.display[Column::LastCheck] = getLastCheckData(repo);
+
+    // unknown values sort before all known values
+    auto const count = [](auto const& value) -> qlonglong {
+        return value ? qlonglong(*value) : -1;
+    };
+    auto const sum = [](std::optional<git::ahead_behind_t> const& ab) -> qlonglong {
+        return ab ? qlonglong(ab->ahead + ab->behind) : -1;
+    };
+    RepoStatistics const& stats = repo->statistics();
+    row.sortKey[Column::Path] = repo->settings().path;
+    row.sortKey[Column::Status] = statusSortKey(repo);
+    row.sortKey[Column::Uncommitted] = count(stats.uncommitted);
+    row.sortKey[Column::HEAD] = sum(stats.head_ahead_behind);
+    row.sortKey[Column::Branches] = sum(stats.total_ahead_behind);
+    row.sortKey[Column::Remote] = count(stats.branches_outdated);
+    row.sortKey[Column::LastCheck] = stats.timestamp;
+    return row;
+}
+
+QVariant RepoTableModel::statusSortKey(Repo const* repo)
+{
+    // by severity
+    switch (repo->status()) {
+        case RepoStatus::Ok:
+            return 0;
+        case RepoStatus::Unknown:
+            return 1;
+        case RepoStatus::DirtyOrOutdated:
+            return 2;
+        case RepoStatus::Error:
+            return 3;
+    }
+    return QVariant();
+}
+
 QVariant RepoTableModel::getPathData(Repo const* repo) const
 {
     return repo->settings().path;
@@ -113,6 +184,8 @@ QVariant RepoTableModel::getStatusData(Repo const* repo, int role) const
         return QVariant();
     if (repo->activity() == RepoActivity::Checking)
         return tr("Checking...");
+    if (repo->activity() == RepoActivity::Waiting)
+        return tr("Waiting for git...");
     switch (repo->status()) {
         case RepoStatus::Ok:
             return tr("OK");
@@ -175,7 +248,13 @@ QVariant RepoTableModel::getBranchesData(Repo const* repo) const
         result += tr("%1 behind").arg(total_ab->behind);
     }
     if (result.isEmpty())
-        return tr("OK");
+        result = tr("OK");
+    // show the effect of the branch filter and the recency pruning
+    auto const& counts = repo->statistics().branch_counts;
+    if (counts && counts->monitored < counts->total)
+        result += " " + tr("(%1 of %2 branches)").arg(counts->monitored).arg(counts->total);
+    if (counts && counts->inactive > 0)
+        result += " " + tr("(%1 inactive)").arg(counts->inactive);
     return result;
 }
 
@@ -189,12 +268,88 @@ QVariant RepoTableModel::getRemoteData(Repo const* repo) const
     return tr("%1 outdated").arg(*branches_outdated);
 }
 
+QVariant RepoTableModel::getLastCheckData(Repo const* repo) const
+{
+    QDateTime const& timestamp = repo->statistics().timestamp;
+    if (!timestamp.isValid())
+        return QVariant();
+    return QLocale().toString(timestamp.toLocalTime(), QLocale::ShortFormat);
+}
+
 void RepoTableModel::on_repo_changed(Repo* repo)
 {
     if (sender() != m_repoManager)
         return;
-    auto const row = repo->index();
-    auto const topLeft = index(row, Column::MIN);
-    auto const bottomRight = index(row, Column::MAX);
-    emit dataChanged(topLeft, bottomRight);
+    int const row = int(repo->index());
+    // repos emit changes while they are added, before their row is inserted
+    if (row >= m_rows.size())
+        return;
+    m_dirtyRows.insert(row);
+    if (!m_flushTimer->isActive())
+        m_flushTimer->start();
+}
+
+void RepoTableModel::RowChanges::merge(RowChanges const& other)
+{
+    firstColumn = std::min(firstColumn, other.firstColumn);
+    lastColumn = std::max(lastColumn, other.lastColumn);
+    for (int role : other.roles)
+        if (!roles.contains(role))
+            roles.append(role);
+}
+
+RepoTableModel::RowChanges RepoTableModel::updateRow(int row)
+{
+    Row newRow = makeRow(m_repoManager->repos().at(row));
+    Row& oldRow = m_rows[row];
+
+    RowChanges changes;
+    for (int column = Column::MIN; column <= Column::MAX; ++column) {
+        bool const displayChanged = newRow.display[column] != oldRow.display[column];
+        bool const sortKeyChanged = newRow.sortKey[column] != oldRow.sortKey[column];
+        if (!displayChanged && !sortKeyChanged)
+            continue;
+        changes.firstColumn = std::min(changes.firstColumn, column);
+        changes.lastColumn = std::max(changes.lastColumn, column);
+        if (displayChanged && !changes.roles.contains(Qt::DisplayRole))
+            changes.roles.append(Qt::DisplayRole);
+        if (sortKeyChanged && !changes.roles.contains(SortRole))
+            changes.roles.append(SortRole);
+    }
+    oldRow = std::move(newRow);
+    return changes;
+}
+
+void RepoTableModel::flushChanges()
+{
+    QList<int> rows = m_dirtyRows.values();
+    m_dirtyRows.clear();
+    std::sort(rows.begin(), rows.end());
+
+    // Only announce the cells and roles that actually changed; repos that changed back and forth
+    // (e.g., a check that found nothing new) are not announced at all.
+    // In particular, a sorting proxy model only moves rows whose sort key in the sort column changed.
+    // Adjacent changed rows are announced as one range.
+    int rangeFirst = -1;
+    int rangeLast = -1;
+    RowChanges rangeChanges;
+    auto const emitRange = [&]() {
+        if (rangeFirst < 0)
+            return;
+        emit dataChanged(index(rangeFirst, rangeChanges.firstColumn), index(rangeLast, rangeChanges.lastColumn), rangeChanges.roles);
+        rangeFirst = -1;
+        rangeChanges = RowChanges();
+    };
+    for (int row : rows) {
+        RowChanges const changes = updateRow(row);
+        if (changes.isEmpty())
+            continue;
+        if (row != rangeLast + 1)
+            emitRange();
+        if (rangeFirst < 0)
+            rangeFirst = row;
+        rangeLast = row;
+        rangeChanges.merge(changes);
+    }
+    emitRange();
 }
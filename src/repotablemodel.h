@@ -3,6 +3,9 @@
 
 #include "repomanager.h"
 #include <QAbstractTableModel>
+#include <QSet>
+#include <QTimer>
+#include <array>
 
 class RepoTableModel : public QAbstractTableModel
 {
@@ -14,7 +17,7 @@ public:
     // RepoManager* repoManager() const { return m_repoManager; }
     void setRepoManager(RepoManager* repoManager);
 
-    void addRepo(RepoSettings settings);
+    void addRepo(RepoSettings settings, QFuture<Repo::check_result_t> prefetchedCheck = {});
 
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
@@ -31,25 +34,64 @@ public:
             HEAD,
             Branches,
             Remote,
+            LastCheck,
             COUNT,
         };
         inline static constexpr int MIN = 0;
         inline static constexpr int MAX = COUNT - 1;
     };
 
+    /// Role of the typed sort keys (numbers, timestamps) of all columns; use it as sort role of a proxy model.
+    /// The sort keys do not depend on the repo's activity, so rows are not moved while they are being checked.
+    inline static constexpr int SortRole = Qt::UserRole;
+
 private:
+    /// Cells of one row, formatted when the repo changes so that data() does not have to do any work.
+    struct Row {
+        std::array<QVariant, Column::COUNT> display;
+        std::array<QVariant, Column::COUNT> sortKey;
+    };
+
+    Row makeRow(Repo const* repo) const;
+
+    /// Changed columns and roles of a range of rows.
+    struct RowChanges {
+        int firstColumn = Column::COUNT;
+        int lastColumn = -1;
+        QList<int> roles;
+
+        bool isEmpty() const { return lastColumn < firstColumn; }
+        void merge(RowChanges const& other);
+    };
+
+    /// Recompute the cached row; returns what changed.
+    RowChanges updateRow(int row);
+
     QVariant getPathData(Repo const* repo) const;
     QVariant getStatusData(Repo const* repo, int role) const;
     QVariant getUncommittedData(Repo const* repo) const;
     QVariant getHEADData(Repo const* repo) const;
     QVariant getBranchesData(Repo const* repo) const;
     QVariant getRemoteData(Repo const* repo) const;
+    QVariant getLastCheckData(Repo const* repo) const;
+
+    static QVariant statusSortKey(Repo const* repo);
 
 private slots:
     void on_repo_changed(Repo* repo);
+    void on_reposAboutToBeAdded(qsizetype first, qsizetype last);
+    void on_reposAdded(qsizetype first, qsizetype last);
+    void flushChanges();
 
 private:
     RepoManager* m_repoManager = nullptr;
+    /// indexed like RepoManager::repos()
+    QList<Row> m_rows;
+    /// rows whose repo changed since the last flushChanges()
+    QSet<int> m_dirtyRows;
+    /// Repos may change very often (e.g., when many checks start and finish in a burst),
+    /// so the changes are collected and announced at most once per frame.
+    QTimer* m_flushTimer = nullptr;
 };
 
 #endif // REPOTABLEMODEL_H
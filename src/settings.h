@@ -11,8 +11,18 @@ namespace Settings {
 
     }
 
+    namespace Discovery {
+
+        inline constexpr char const* Roots = "Discovery/Roots";
+        inline constexpr char const* RescanIntervalMinutes = "Discovery/RescanIntervalMinutes";
+        /// names of directories that are never scanned (see RepoDiscovery::ignoredNames())
+        inline constexpr char const* IgnoredNames = "Discovery/IgnoredNames";
+
+    }
+
     namespace RepoManager {
 
+        /// legacy storage of the repository list; migrated to RepoStore on startup
         inline constexpr char const* Repos = "Repos";
 
     }
@@ -1,6 +1,21 @@
 #include "trayicon.h"
 #include <QApplication>
 #include <QMenu>
+#include <QPainter>
+#include <algorithm>
+
+namespace {
+    /// counts above this are shown as "99+"
+    inline constexpr qsizetype k_maxBadgeCount = 99;
+    /// the badge cache is cleared when it grows larger than this
+    inline constexpr qsizetype k_maxBadgeIcons = 64;
+    inline constexpr int k_iconSize = 64;
+
+    quint64 badgeKey(RepoStatus worst, qsizetype count)
+    {
+        return (quint64(worst) << 32) | quint64(std::min(count, k_maxBadgeCount + 1));
+    }
+}
 
 TrayIcon::TrayIcon(QObject* parent)
     : QObject{parent}
@@ -8,8 +23,8 @@ TrayIcon::TrayIcon(QObject* parent)
     m_systemTrayIcon = new QSystemTrayIcon(this);
     connect(m_systemTrayIcon, &QSystemTrayIcon::activated, this, &TrayIcon::on_systemTrayIcon_activated);
 
-    QIcon icon(":/images/Git-Icon-Black.png");
-    m_systemTrayIcon->setIcon(icon);
+    m_baseIcon = QIcon(":/images/Git-Icon-Black.png");
+    m_systemTrayIcon->setIcon(m_baseIcon);
 
     m_systemTrayIcon->setToolTip(tr("Git Monitor: all repositories are ok"));
 
@@ -33,12 +48,14 @@ TrayIcon::TrayIcon(QObject* parent)
 void TrayIcon::setRepoManager(RepoManager* newRepoManager)
 {
     if (m_repoManager)
-        disconnect(m_repoManager, &RepoManager::repoChanged, this, &TrayIcon::on_repo_changed);
+        disconnect(m_repoManager, &RepoManager::aggregateChanged, this, &TrayIcon::on_aggregateChanged);
 
     m_repoManager = newRepoManager;
 
-    if (m_repoManager)
-        connect(m_repoManager, &RepoManager::repoChanged, this, &TrayIcon::on_repo_changed);
+    if (m_repoManager) {
+        connect(m_repoManager, &RepoManager::aggregateChanged, this, &TrayIcon::on_aggregateChanged);
+        on_aggregateChanged();
+    }
 }
 
 void TrayIcon::hide()
@@ -60,7 +77,67 @@ void TrayIcon::on_systemTrayIcon_activated(QSystemTrayIcon::ActivationReason rea
     }
 }
 
-void TrayIcon::on_repo_changed(Repo* repo)
+void TrayIcon::on_aggregateChanged()
+{
+    if (!m_repoManager)
+        return;
+    RepoManager::Aggregate const& aggregate = m_repoManager->aggregate();
+    qsizetype const errors = aggregate.repos(RepoStatus::Error);
+    qsizetype const dirty = aggregate.repos(RepoStatus::DirtyOrOutdated);
+    qsizetype const unknown = aggregate.repos(RepoStatus::Unknown);
+
+    QString toolTip;
+    if (errors == 0 && dirty == 0 && unknown == 0)
+        toolTip = tr("Git Monitor: all repositories are ok");
+    else {
+        QStringList parts;
+        if (errors > 0)
+            parts += tr("%n with errors", nullptr, int(errors));
+        if (dirty > 0)
+            parts += tr("%n dirty or outdated", nullptr, int(dirty));
+        if (unknown > 0)
+            parts += tr("%n not yet checked", nullptr, int(unknown));
+        toolTip = tr("Git Monitor: %1").arg(parts.join(", "));
+    }
+    if (aggregate.uncommitted > 0 || aggregate.ahead > 0 || aggregate.behind > 0)
+        toolTip += "\n" + tr("%1 uncommitted changes, %2 commits ahead, %3 commits behind").arg(aggregate.uncommitted).arg(aggregate.ahead).arg(aggregate.behind);
+    if (m_systemTrayIcon->toolTip() != toolTip)
+        m_systemTrayIcon->setToolTip(toolTip);
+
+    RepoStatus const worst = errors > 0 ? RepoStatus::Error : dirty > 0 ? RepoStatus::DirtyOrOutdated : RepoStatus::Ok;
+    qsizetype const count = errors + dirty;
+    quint64 const key = badgeKey(worst, count);
+    if (key == m_currentBadge)
+        return;
+    m_currentBadge = key;
+    m_systemTrayIcon->setIcon(worst == RepoStatus::Ok ? m_baseIcon : badgeIcon(worst, count));
+}
+
+QIcon const& TrayIcon::badgeIcon(RepoStatus worst, qsizetype count)
 {
-    // TODO
+    quint64 const key = badgeKey(worst, count);
+    auto it = m_badgeIcons.constFind(key);
+    if (it != m_badgeIcons.cend())
+        return *it;
+
+    if (m_badgeIcons.size() >= k_maxBadgeIcons)
+        m_badgeIcons.clear();
+
+    QPixmap pixmap = m_baseIcon.pixmap(k_iconSize, k_iconSize);
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QRectF const badge(k_iconSize * 0.4, k_iconSize * 0.4, k_iconSize * 0.6, k_iconSize * 0.6);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(worst == RepoStatus::Error ? QColor(Qt::red) : QColor(255, 140, 0));
+    painter.drawEllipse(badge);
+
+    QFont font = painter.font();
+    font.setBold(true);
+    font.setPixelSize(count > k_maxBadgeCount ? k_iconSize / 5 : k_iconSize / 3);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    painter.drawText(badge, Qt::AlignCenter, count > k_maxBadgeCount ? QStringLiteral("%1+").arg(k_maxBadgeCount) : QString::number(count));
+    painter.end();
+
+    return *m_badgeIcons.insert(key, QIcon(pixmap));
 }
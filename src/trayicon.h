@@ -2,6 +2,8 @@
 #define TRAYICON_H
 
 #include "repomanager.h"
+#include <QHash>
+#include <QIcon>
 #include <QObject>
 #include <QSystemTrayIcon>
 
@@ -19,14 +21,23 @@ public slots:
 
 private slots:
     void on_systemTrayIcon_activated(QSystemTrayIcon::ActivationReason reason);
-    void on_repo_changed(Repo* repo);
+    void on_aggregateChanged();
 
 signals:
     void showSettings();
 
+private:
+    /// icon with a badge showing the number of problematic repos, colored by the worst status
+    QIcon const& badgeIcon(RepoStatus worst, qsizetype count);
+
 private:
     RepoManager* m_repoManager = nullptr;
     QSystemTrayIcon* m_systemTrayIcon = nullptr;
+    QIcon m_baseIcon;
+    /// rendered badge icons by badge key (worst status and count), so that icons are not repainted on every change
+    QHash<quint64, QIcon> m_badgeIcons;
+    /// badge key of the icon that is currently shown
+    quint64 m_currentBadge = 0;
 };
 
 #endif // TRAYICON_H
@@ -0,0 +1,205 @@
+#include "git/ignore.h"
+#include "test_util.h"
+#include <map>
+
+using namespace git;
+
+namespace {
+
+    void test_wildmatch()
+    {
+        struct wildmatch_case {
+            char const* pattern;
+            char const* text;
+            bool match;
+        };
+        // expectations from git's t3070-wildmatch.sh (with WM_PATHNAME)
+        wildmatch_case const cases[] = {
+            {"foo", "foo", true},
+            {"*", "foo", true},
+            {"*", "foo/bar", false},
+            {"*/bar", "foo/bar", true},
+            {"foo*bar", "foo/bar", false},
+            {"foo?bar", "foo/bar", false},
+            {"?", "/", false},
+            {"**/foo", "foo", true},
+            {"**/foo", "a/b/foo", true},
+            {"**/foo", "a/bfoo", false},
+            {"foo/**", "foo/a/b", true},
+            {"foo/**", "foo", false},
+            {"a/**/b", "a/b", true},
+            {"a/**/b", "a/x/y/b", true},
+            {"a/**b", "a/x/b", false},
+            {"[abc]", "b", true},
+            {"[!abc]", "d", true},
+            {"[!abc]", "a", false},
+            {"[^abc]", "d", true},
+            {"[a-c]x", "bx", true},
+            {"[]]", "]", true},
+            {"[[:digit:]]", "5", true},
+            {"[[:digit:]]", "x", false},
+            {"[[:upper:][:digit:]]", "Q", true},
+            {"[/]", "/", false},
+            {"\\*", "*", true},
+            {"\\*", "x", false},
+            {"*.o", "a.o", true},
+            {"*.o", "dir/a.o", false},
+        };
+        for (wildmatch_case const& c : cases) {
+            if (wildmatch(c.pattern, c.text) != c.match) {
+                fmt::println(stderr, "wildmatch(\"{}\", \"{}\") should be {}", c.pattern, c.text, c.match);
+                test::failures() += 1;
+            }
+        }
+    }
+
+    struct path_case {
+        char const* path;
+        bool is_dir;
+    };
+
+    char const* const k_root_gitignore =
+        "# comment\n"
+        "*.o\n"
+        "!keep.o\n"
+        "/root-only.txt\n"
+        "build/\n"
+        "doc/*.html\n"
+        "**/logs\n"
+        "temp?\n"
+        "[Bb]in/\n"
+        "a/**/z\n"
+        "sub/deep/\n"
+        "\\#hash\n"
+        "trailing-space\\ \n"
+        "\n";
+
+    char const* const k_sub_gitignore =
+        "!*.o\n"
+        "*.tmp\n"
+        "/anchored\n"
+        "nested/*.txt\n";
+
+    path_case const k_paths[] = {
+        {"a.o", false},
+        {"keep.o", false},
+        {"x/b.o", false},
+        {"x/keep.o", false},
+        {"root-only.txt", false},
+        {"x/root-only.txt", false},
+        {"build", true},
+        {"build/out", false},
+        {"x/build", true},
+        {"doc/index.html", false},
+        {"doc/api/index.html", false},
+        {"x/doc/index.html", false},
+        {"logs", true},
+        {"x/y/logs", false},
+        {"temp1", false},
+        {"temp12", false},
+        {"bin", true},
+        {"Bin", true},
+        {"cin", true},
+        {"a/z", false},
+        {"a/b/c/z", false},
+        {"b/a/z", false},
+        {"sub/deep", true},
+        {"sub/deep/file", false},
+        {"sub/a.o", false},
+        {"sub/x.tmp", false},
+        {"sub/anchored", false},
+        {"sub/x/anchored", false},
+        {"sub/nested/n.txt", false},
+        {"sub/x/nested/n.txt", false},
+        {"x.tmp", false},
+        {"#hash", false},
+        {"trailing-space ", false},
+        {"plain.txt", false},
+    };
+
+    /// the deeper ignore list takes precedence, and the contents of ignored directories are ignored
+    bool is_ignored(std::map<std::string, ignore_list> const& lists, std::string const& path, bool is_dir)
+    {
+        auto const match = [&](std::string const& p, bool dir) {
+            std::optional<bool> result;
+            for (auto const& [base, list] : lists) {
+                // lists are ordered by base, so deeper lists come later and override
+                if (p.compare(0, base.size(), base) != 0)
+                    continue;
+                if (std::optional<bool> m = list.match(p, dir))
+                    result = m;
+            }
+            return result.value_or(false);
+        };
+        for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+            if (match(path.substr(0, slash), true))
+                return true;
+        }
+        return match(path, is_dir);
+    }
+
+    void test_ignore_list()
+    {
+        test::temp_dir tmp;
+        test::isolate_git(tmp.path());
+        std::filesystem::path const repo = tmp.path() / "repo";
+        std::filesystem::create_directories(repo);
+        test::run(repo, "git init -q .");
+        test::write_file(repo / ".gitignore", k_root_gitignore);
+        test::write_file(repo / "sub/.gitignore", k_sub_gitignore);
+
+        // git determines whether a path is a directory from the working tree
+        std::string input;
+        for (path_case const& c : k_paths) {
+            if (c.is_dir)
+                std::filesystem::create_directories(repo / c.path);
+            else
+                test::write_file(repo / c.path, "");
+            input += c.path;
+            input += '\0';
+        }
+        test::write_file(tmp.path() / "paths", input);
+
+        // one line per path: <source>:<line>:<pattern> TAB <path>, with empty fields if no pattern matches
+        std::string const output = test::run(repo, fmt::format("git check-ignore --no-index -v -n -z --stdin < {}", test::shell_quote((tmp.path() / "paths").string())));
+        std::vector<std::string> fields;
+        for (size_t pos = 0; pos < output.size();) {
+            size_t const end = output.find('\0', pos);
+            fields.push_back(output.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        CHECK_EQ(fields.size(), 4 * std::size(k_paths));
+
+        std::map<std::string, ignore_list> lists;
+        lists.emplace("", ignore_list::parse(k_root_gitignore));
+        lists.emplace("sub/", ignore_list::parse(k_sub_gitignore, "sub/"));
+
+        for (size_t i = 0; i + 3 < fields.size(); i += 4) {
+            std::string const& pattern = fields[i + 2];
+            std::string const& path = fields[i + 3];
+            bool const git_ignored = !pattern.empty() && pattern[0] != '!';
+            path_case const& c = k_paths[i / 4];
+            CHECK_EQ(path, c.path);
+            bool const ignored = is_ignored(lists, c.path, c.is_dir);
+            if (ignored != git_ignored) {
+                fmt::println(stderr, "{}{}: ignored {}, git says {} (pattern '{}' from {}:{})", c.path, c.is_dir ? "/" : "", ignored, git_ignored,
+                             pattern, fields[i], fields[i + 1]);
+                test::failures() += 1;
+            }
+        }
+    }
+
+}
+
+int main()
+{
+    try {
+        test_wildmatch();
+        test_ignore_list();
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "error: {}", e.what());
+        return 1;
+    }
+    return test::finish();
+}
@@ -0,0 +1,164 @@
+#include "git/fsmonitor.h"
+#include "git/index_file.h"
+#include "test_util.h"
+#include <sys/stat.h>
+
+using namespace git;
+
+namespace {
+
+    std::string to_hex(std::array<unsigned char, 20> const& oid)
+    {
+        std::string hex;
+        for (unsigned char c : oid)
+            hex += fmt::format("{:02x}", c);
+        return hex;
+    }
+
+    /// Compare the entries read natively with `git ls-files -s` ("<mode> <oid> <stage>\t<path>").
+    void check_entries(std::filesystem::path const& repo, index_file const& index)
+    {
+        std::string const output = test::run(repo, "git ls-files -s -z");
+        std::vector<std::string> expected;
+        for (size_t pos = 0; pos < output.size();) {
+            size_t const end = output.find('\0', pos);
+            expected.push_back(output.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        std::vector<std::string> actual;
+        for (index_entry const& e : index.entries())
+            actual.push_back(fmt::format("{:06o} {} {}\t{}", e.mode, to_hex(e.oid), e.stage(), e.path));
+
+        CHECK_EQ(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size() && i < expected.size(); ++i)
+            CHECK_EQ(actual[i], expected[i]);
+    }
+
+    index_entry const* find_entry(index_file const& index, std::string_view path)
+    {
+        for (index_entry const& e : index.entries())
+            if (e.path == path)
+                return &e;
+        return nullptr;
+    }
+
+    void test_versions(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = test::init_repo(root / "versions", {
+            {"a.txt", "a\n"},
+            {"dir/b.txt", "b\n"},
+            {"dir/sub/c.txt", "c\n"},
+            {"dir/sub/d-with-a-longer-name.txt", "d\n"},
+            {"e.sh", "#!/bin/sh\n"},
+        });
+        test::run(repo, "chmod +x e.sh && git add e.sh && ln -s a.txt link && git add link");
+        std::string const index_path = (repo / ".git/index").string();
+
+        for (int version : {2, 4}) {
+            test::run(repo, fmt::format("git update-index --index-version {}", version));
+            index_file const index = index_file::read(index_path);
+            CHECK_EQ(index.version(), static_cast<uint32_t>(version));
+            check_entries(repo, index);
+            index_entry const* link = find_entry(index, "link");
+            CHECK(link && link->is_symlink());
+        }
+
+        // extended flags need version 3
+        test::run(repo, "git update-index --index-version 2 && git update-index --skip-worktree dir/b.txt");
+        test::write_file(repo / "new.txt", "new\n");
+        test::run(repo, "git add -N new.txt");
+        index_file const index = index_file::read(index_path);
+        CHECK_EQ(index.version(), 3u);
+        check_entries(repo, index);
+        index_entry const* skipped = find_entry(index, "dir/b.txt");
+        CHECK(skipped && skipped->is_skip_worktree());
+        index_entry const* added = find_entry(index, "new.txt");
+        CHECK(added && added->is_intent_to_add());
+        index_entry const* plain = find_entry(index, "a.txt");
+        CHECK(plain && !plain->is_skip_worktree() && !plain->is_intent_to_add());
+
+        CHECK(index_file::read((repo / ".git/missing-index").string()).entries().empty());
+    }
+
+    void test_split_index(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = test::init_repo(root / "split", {
+            {"a.txt", "a\n"},
+            {"b.txt", "b\n"},
+            {"c.txt", "c\n"},
+            {"dir/d.txt", "d\n"},
+        });
+        // keep the changes below in the split index instead of writing a new shared index
+        test::run(repo, "git config splitIndex.maxPercentChange 100 && git update-index --split-index");
+        test::write_file(repo / "a.txt", "modified\n");
+        test::write_file(repo / "dir/new.txt", "new\n");
+        test::run(repo, "git add a.txt dir/new.txt && git rm -q --cached c.txt");
+
+        index_file const index = index_file::read((repo / ".git/index").string());
+        CHECK(index.is_split());
+        check_entries(repo, index);
+        CHECK(find_entry(index, "c.txt") == nullptr);
+    }
+
+    void test_fsmonitor(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = test::init_repo(root / "fsmonitor", {
+            {"a.txt", "a\n"},
+            {"dir/b.txt", "b\n"},
+        });
+        // stand-in for a file system watcher: always returns the token "t1" and the paths in the changes file
+        std::filesystem::path const changes = root / "fsmonitor-changes";
+        std::filesystem::path const hook = root / "fsmonitor-hook";
+        test::write_file(changes, "");
+        test::write_file(hook, fmt::format("#!/bin/sh\nprintf 't1\\0'\ncat {}\n", test::shell_quote(changes.string())));
+        std::filesystem::permissions(hook, std::filesystem::perms::owner_all);
+        test::run(repo, fmt::format("git config core.fsmonitor {} && git config core.fsmonitorHookVersion 2", test::shell_quote(hook.string())));
+        test::run(repo, "git update-index --fsmonitor && git status --porcelain");
+
+        index_file const index = index_file::read((repo / ".git/index").string());
+        check_entries(repo, index);
+        std::optional<std::string_view> const data = index.extension("FSMN");
+        CHECK(data.has_value());
+        if (!data)
+            return;
+        fsmonitor_extension const ext = fsmonitor_extension::parse(*data);
+        CHECK_EQ(ext.version, 2u);
+        CHECK_EQ(ext.last_update, "t1");
+
+        test::write_file(changes, std::string("dir/b.txt\0dir/new/\0", 19));
+        for (int version : {2, 0}) {
+            std::optional<fsmonitor_changes> const reported = fsmonitor_changes::query(hook.string(), version, ext.last_update, repo.string());
+            CHECK(reported.has_value());
+            if (!reported)
+                continue;
+            CHECK(reported->is_path_changed("dir/b.txt"));
+            CHECK(!reported->is_path_changed("a.txt"));
+            CHECK(reported->is_dir_changed("dir/"));
+            CHECK(!reported->is_dir_changed(""));
+            // a reported directory covers everything below it
+            CHECK(reported->is_path_changed("dir/new/x/y.txt"));
+            CHECK(reported->is_dir_changed("dir/new/x/"));
+        }
+
+        // the hook cannot tell what changed
+        test::write_file(changes, std::string("/\0", 2));
+        CHECK(!fsmonitor_changes::query(hook.string(), 2, ext.last_update, repo.string()).has_value());
+    }
+
+}
+
+int main()
+{
+    try {
+        test::temp_dir tmp;
+        test::isolate_git(tmp.path());
+        test_versions(tmp.path());
+        test_split_index(tmp.path());
+        test_fsmonitor(tmp.path());
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "error: {}", e.what());
+        return 1;
+    }
+    return test::finish();
+}
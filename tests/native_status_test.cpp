@@ -0,0 +1,165 @@
+#include "git/git.h"
+#include "git/status_scanner.h"
+#include "test_util.h"
+
+using namespace git;
+
+namespace {
+
+    struct scenario {
+        char const* name;
+        /// shell commands run in the repository after the initial commit
+        char const* setup;
+        bool changed;
+    };
+
+    scenario const k_scenarios[] = {
+        {"clean", "true", false},
+        {"modified", "echo modified >> a.txt", true},
+        {"modified, same size", "printf 'A\\n' > a.txt", true},
+        {"deleted", "rm dir/b.txt", true},
+        {"untracked", "echo new > new.txt", true},
+        {"untracked directory", "mkdir -p newdir/sub && echo new > newdir/sub/x.txt", true},
+        {"empty untracked directory", "mkdir empty", false},
+        {"ignored", "mkdir -p logs && echo log > debug.log && echo log > logs/x.txt && echo log > dir/y.log", false},
+        {"staged", "echo staged >> a.txt && git add a.txt", true},
+        {"staged new file", "echo new > new.txt && git add new.txt", true},
+        {"staged deletion", "git rm -q --cached dir/b.txt", true},
+        {"staged directory deletion", "git rm -q -r --cached dir", true},
+        {"staged mode change", "git update-index --chmod=+x c.txt", true},
+        {"staged file replaced by a directory", "git rm -q c.txt && mkdir c.txt && echo x > c.txt/x && git add c.txt/x", true},
+        {"staged and reverted", "echo staged >> dir/sub/d.txt && git add dir/sub/d.txt && git checkout -q HEAD -- dir/sub/d.txt", false},
+        {"cache tree", "git read-tree HEAD && git update-index --refresh > /dev/null", false},
+        {"cache tree, staged", "echo staged >> dir/sub/d.txt && git add dir/sub/d.txt && git write-tree > /dev/null", true},
+        {"touched", "sleep 1 && touch a.txt dir/b.txt", false},
+        {"touched and refreshed", "sleep 1 && touch a.txt && git update-index --refresh", false},
+        {"mode change", "chmod +x a.txt", true},
+        {"mode change ignored", "chmod +x a.txt && git config core.filemode false", false},
+        {"symlink changed", "rm link && ln -s dir/b.txt link", true},
+        {"index v4", "git update-index --index-version 4 && echo new > dir/new.txt", true},
+        {"index v4 clean", "git update-index --index-version 4", false},
+        {"split index", "git config splitIndex.maxPercentChange 100 && git update-index --split-index && echo x > c.txt && git add c.txt", true},
+        {"split index clean", "git update-index --split-index && git status --porcelain > /dev/null", false},
+        {"untracked cache",
+         "git config core.untrackedCache true && git update-index --untracked-cache && git status --porcelain > /dev/null && echo new > dir/new.txt",
+         true},
+        {"untracked cache clean", "git config core.untrackedCache true && git update-index --untracked-cache && git status --porcelain > /dev/null", false},
+        {"untracked cache, new directory",
+         "git config core.untrackedCache true && git update-index --untracked-cache && git status --porcelain > /dev/null && mkdir -p dir/new && echo x > dir/new/x",
+         true},
+        {"untracked cache, ignored",
+         "git config core.untrackedCache true && git update-index --untracked-cache && git status --porcelain > /dev/null && echo x > dir/z.log",
+         false},
+    };
+
+    char const* const k_gitignore = "*.log\nlogs/\n";
+
+    size_t native_changes(std::filesystem::path const& path, std::string const& content_cache_file = {})
+    {
+        repository repo = repository::open(path.c_str());
+        return status_scanner(repo, content_cache_file).uncommitted_changes();
+    }
+
+    size_t libgit2_changes(std::filesystem::path const& path)
+    {
+        repository repo = repository::open(path.c_str());
+        return repo.uncommitted_changes(status_engine::libgit2);
+    }
+
+    std::filesystem::path init_fixture(std::filesystem::path const& path)
+    {
+        std::filesystem::path const repo = test::init_repo(path, {
+            {".gitignore", k_gitignore},
+            {"a.txt", "a\n"},
+            {"c.txt", "c\n"},
+            {"dir/b.txt", "b\n"},
+            {"dir/sub/d.txt", "d\n"},
+        });
+        test::run(repo, "ln -s a.txt link && git add link && git commit -q -m link");
+        return repo;
+    }
+
+    void check_scenario(std::filesystem::path const& repo, std::string_view name, bool changed, std::filesystem::path const& content_cache_file)
+    {
+        size_t const expected = libgit2_changes(repo);
+        if ((expected > 0) != changed) {
+            fmt::println(stderr, "{}: libgit2 reports {} changes", name, expected);
+            test::failures() += 1;
+        }
+        try {
+            size_t const native = native_changes(repo);
+            if (native != expected) {
+                fmt::println(stderr, "{}: native scan reports {} changes, libgit2 {}", name, native, expected);
+                test::failures() += 1;
+            }
+            // the second scan uses the content cache written by the first one
+            for (int i = 0; i < 2; ++i) {
+                size_t const cached = native_changes(repo, content_cache_file.string());
+                if (cached != expected) {
+                    fmt::println(stderr, "{}: native scan with content cache reports {} changes, libgit2 {}", name, cached, expected);
+                    test::failures() += 1;
+                }
+            }
+            repository r = repository::open(repo.c_str());
+            CHECK_EQ(status_scanner(r).uncommitted_changes(1), std::min<size_t>(expected, 1));
+        }
+        catch (std::exception const& e) {
+            fmt::println(stderr, "{}: native scan failed: {}", name, e.what());
+            test::failures() += 1;
+        }
+    }
+
+    void test_scenarios(std::filesystem::path const& root)
+    {
+        int n = 0;
+        for (scenario const& s : k_scenarios) {
+            std::filesystem::path const dir = root / fmt::format("scenario-{}", n++);
+            std::filesystem::path const repo = init_fixture(dir / "repo");
+            test::run(repo, s.setup);
+            check_scenario(repo, s.name, s.changed, dir / "content-cache");
+        }
+    }
+
+    void test_fsmonitor(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = init_fixture(root / "fsmonitor" / "repo");
+        // stand-in for a file system watcher: always returns the token "t1" and the paths in the changes file
+        std::filesystem::path const changes = root / "fsmonitor" / "changes";
+        std::filesystem::path const hook = root / "fsmonitor" / "hook";
+        test::write_file(changes, "");
+        test::write_file(hook, fmt::format("#!/bin/sh\nprintf 't1\\0'\ncat {}\n", test::shell_quote(changes.string())));
+        std::filesystem::permissions(hook, std::filesystem::perms::owner_all);
+        test::run(repo, fmt::format("git config core.fsmonitor {} && git config core.fsmonitorHookVersion 2", test::shell_quote(hook.string())));
+        test::run(repo, "git config core.untrackedCache true && git update-index --untracked-cache --fsmonitor && git status --porcelain > /dev/null");
+        check_scenario(repo, "fsmonitor clean", false, root / "fsmonitor" / "content-cache");
+
+        // the hook reports exactly the paths that changed
+        test::write_file(repo / "dir/b.txt", "modified\n");
+        test::write_file(repo / "dir/sub/new.txt", "new\n");
+        test::write_file(repo / "dir/z.log", "ignored\n");
+        test::write_file(changes, std::string("dir/b.txt\0dir/sub/new.txt\0dir/z.log\0", 36));
+        check_scenario(repo, "fsmonitor", true, root / "fsmonitor" / "content-cache");
+
+        // the hook cannot tell what changed
+        test::write_file(changes, std::string("/\0", 2));
+        check_scenario(repo, "fsmonitor, everything changed", true, root / "fsmonitor" / "content-cache");
+    }
+
+}
+
+int main()
+{
+    try {
+        test::temp_dir tmp;
+        // before libgit2 is initialized, since it looks up the global config once
+        test::isolate_git(tmp.path());
+        libgit2_init();
+        test_scenarios(tmp.path());
+        test_fsmonitor(tmp.path());
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "error: {}", e.what());
+        return 1;
+    }
+    return test::finish();
+}
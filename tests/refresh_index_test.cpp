@@ -0,0 +1,90 @@
+#include "git/git.h"
+#include "test_util.h"
+#include <ctime>
+
+using namespace git;
+
+namespace {
+
+    /// A same-size change in the second the index was written is only visible to git through the racy-git check.
+    /// The refreshed index must keep the changed entry racy (or smudge it), or the change is hidden from git for good.
+    void test_racily_clean_change(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = root / "racy";
+        std::filesystem::create_directories(repo);
+        test::run(repo, "git init -q -b main . && git config core.trustctime false");
+        test::write_file(repo / "a.txt", "a\n");
+        test::write_file(repo / "c.txt", "c\n");
+        // whole seconds, like git compares them unless it is built with USE_NSEC
+        int64_t const t = static_cast<int64_t>(std::time(nullptr)) - 100;
+        test::set_mtime(repo / "a.txt", t);
+        test::set_mtime(repo / "c.txt", t);
+        test::run(repo, "git add -A && git commit -q -m initial");
+        test::set_mtime(repo / ".git/index", t);
+
+        // same size, same mtime as the index entry: the stat data matches
+        test::write_file(repo / "a.txt", "b\n");
+        test::set_mtime(repo / "a.txt", t);
+        // stale stat data with unchanged content, so the refresh writes the index
+        test::set_mtime(repo / "c.txt", t + 10);
+
+        CHECK_EQ(test::run(repo, "git --no-optional-locks status --porcelain"), " M a.txt\n");
+
+        {
+            repository r = repository::open(repo.c_str());
+            CHECK(r.refresh_index());
+        }
+        CHECK_EQ(test::run(repo, "git --no-optional-locks status --porcelain"), " M a.txt\n");
+        repository r = repository::open(repo.c_str());
+        CHECK_EQ(r.uncommitted_changes(status_engine::libgit2), 1u);
+        CHECK_EQ(r.uncommitted_changes(status_engine::native), 1u);
+    }
+
+    void test_unchanged(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = test::init_repo(root / "unchanged", {
+            {"a.txt", "a\n"},
+            {"dir/b.txt", "b\n"},
+        });
+        test::run(repo, "sleep 1 && touch a.txt dir/b.txt");
+        {
+            repository r = repository::open(repo.c_str());
+            CHECK(r.refresh_index());
+        }
+        CHECK_EQ(test::run(repo, "git --no-optional-locks status --porcelain"), "");
+        // the index is not left locked, and no copy is left behind
+        CHECK(!std::filesystem::exists(repo / ".git/index.lock"));
+        for (auto const& entry : std::filesystem::directory_iterator(repo / ".git"))
+            CHECK(entry.path().filename().string().rfind("index.git-monitor-", 0) != 0);
+    }
+
+    void test_locked(std::filesystem::path const& root)
+    {
+        std::filesystem::path const repo = test::init_repo(root / "locked", {
+            {"a.txt", "a\n"},
+        });
+        test::run(repo, "sleep 1 && touch a.txt && touch .git/index.lock");
+        repository r = repository::open(repo.c_str());
+        CHECK(!r.refresh_index());
+        CHECK(std::filesystem::exists(repo / ".git/index.lock"));
+    }
+
+}
+
+int main()
+{
+    try {
+        test::temp_dir tmp;
+        // before libgit2 is initialized, since it looks up the global config once
+        test::isolate_git(tmp.path());
+        libgit2_init();
+        test_racily_clean_change(tmp.path());
+        test_unchanged(tmp.path());
+        test_locked(tmp.path());
+    }
+    catch (std::exception const& e) {
+        fmt::println(stderr, "error: {}", e.what());
+        return 1;
+    }
+    return test::finish();
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/// Minimal test support: checks count their failures instead of aborting, so a run reports all of them.
+namespace test {
+
+    inline int& failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    inline void check(bool ok, char const* expr, char const* file, int line)
+    {
+        if (ok)
+            return;
+        fmt::println(stderr, "{}:{}: check failed: {}", file, line, expr);
+        failures() += 1;
+    }
+
+    template <typename A, typename B>
+    void check_eq(A const& a, B const& b, char const* expr, char const* file, int line)
+    {
+        if (a == b)
+            return;
+        fmt::println(stderr, "{}:{}: check failed: {}\n    left:  {}\n    right: {}", file, line, expr, a, b);
+        failures() += 1;
+    }
+
+    /// result of the test executable
+    inline int finish()
+    {
+        if (failures() == 0)
+            return 0;
+        fmt::println(stderr, "{} checks failed", failures());
+        return 1;
+    }
+
+    /// Temporary directory that is removed with its contents at the end of the test.
+    class temp_dir {
+        std::filesystem::path m_path;
+
+    public:
+        temp_dir()
+        {
+            std::string pattern = (std::filesystem::temp_directory_path() / "git-monitor-test-XXXXXX").string();
+            if (!::mkdtemp(pattern.data()))
+                throw std::runtime_error("unable to create temporary directory");
+            // git reports symlinked paths resolved, e.g., on macOS where /tmp is a link
+            m_path = std::filesystem::canonical(pattern);
+        }
+        ~temp_dir() noexcept
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(m_path, ec);
+        }
+        temp_dir(temp_dir const&) = delete;
+        temp_dir& operator=(temp_dir const&) = delete;
+
+        std::filesystem::path const& path() const { return m_path; }
+    };
+
+    inline std::string shell_quote(std::string_view s)
+    {
+        std::string result = "'";
+        for (char c : s) {
+            if (c == '\'')
+                result += "'\\''";
+            else
+                result += c;
+        }
+        result += '\'';
+        return result;
+    }
+
+    /// Run a shell command in the directory and return its output; throws if the command fails.
+    inline std::string run(std::filesystem::path const& dir, std::string const& command)
+    {
+        std::string const full = fmt::format("cd {} && {}", shell_quote(dir.string()), command);
+        FILE* pipe = ::popen(full.c_str(), "r");
+        if (!pipe)
+            throw std::runtime_error(fmt::format("unable to run: {}", command));
+        std::string output;
+        char buffer[4096];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+            output.append(buffer, n);
+        int const status = ::pclose(pipe);
+        if (status != 0)
+            throw std::runtime_error(fmt::format("command failed with status {}: {}", status, command));
+        return output;
+    }
+
+    /// Exit code of a shell command run in the directory, for commands that report a result through it.
+    inline int exit_code(std::filesystem::path const& dir, std::string const& command)
+    {
+        std::string const full = fmt::format("cd {} && {} >/dev/null 2>&1", shell_quote(dir.string()), command);
+        int const status = std::system(full.c_str());
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    /// Write the file, creating its parent directories.
+    inline void write_file(std::filesystem::path const& path, std::string_view content)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!out)
+            throw std::runtime_error(fmt::format("unable to write {}", path.string()));
+    }
+
+    /// Set the access and modification time of the file to the given Unix time (whole seconds).
+    inline void set_mtime(std::filesystem::path const& path, int64_t sec)
+    {
+        struct timespec const times[2] = {{static_cast<time_t>(sec), 0}, {static_cast<time_t>(sec), 0}};
+        if (::utimensat(AT_FDCWD, path.c_str(), times, 0) != 0)
+            throw std::runtime_error(fmt::format("unable to set the mtime of {}", path.string()));
+    }
+
+    /// Make git (and libgit2) independent of the configuration of the user running the tests.
+    inline void isolate_git(std::filesystem::path const& home)
+    {
+        ::setenv("HOME", home.c_str(), 1);
+        ::setenv("XDG_CONFIG_HOME", (home / ".config").c_str(), 1);
+        ::setenv("GIT_CONFIG_NOSYSTEM", "1", 1);
+        ::setenv("GIT_AUTHOR_NAME", "Test", 1);
+        ::setenv("GIT_AUTHOR_EMAIL", "test@example.com", 1);
+        ::setenv("GIT_COMMITTER_NAME", "Test", 1);
+        ::setenv("GIT_COMMITTER_EMAIL", "test@example.com", 1);
+        ::unsetenv("GIT_DIR");
+        ::unsetenv("GIT_WORK_TREE");
+        ::unsetenv("GIT_INDEX_FILE");
+    }
+
+    /// Create a repository with the given files, committed on the initial branch.
+    inline std::filesystem::path init_repo(std::filesystem::path const& path, std::initializer_list<std::pair<char const*, char const*>> files)
+    {
+        std::filesystem::create_directories(path);
+        run(path, "git init -q -b main .");
+        for (auto const& [name, content] : files)
+            write_file(path / name, content);
+        run(path, "git add -A && git commit -q -m initial");
+        return path;
+    }
+
+}
+
+#define CHECK(cond) ::test::check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) ::test::check_eq((a), (b), #a " == " #b, __FILE__, __LINE__)